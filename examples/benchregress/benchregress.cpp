@@ -0,0 +1,698 @@
+/*
+ *  benchregress.cpp
+ *  Throughput regression tracking across library revisions
+ *
+ *  Runs a fixed matrix of benchmarks several times: the kernel microbenchmarks
+ *  of kernelbench, and any recorded workloads replayed by workloadreplay in
+ *  double precision, single precision and with threading. The throughput of
+ *  every kernel or call in every configuration is stored per revision in a
+ *  local JSON file, and compared with the samples of a baseline revision by a
+ *  one-sided Welch t-test. Slowdowns that are both larger than the threshold
+ *  and significant are reported as regressions, and the exit status is 1 if
+ *  there are any, so that an upgrade of the library can be gated on it.
+ */
+#include <cctype>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "libhmsbeagle/beagle.h"
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+#define STORE_VERSION   1   // increment whenever the layout of the store changes
+
+struct RegressOptions {
+    std::string storeFile;
+    std::string revision;
+    std::string baseline;           // empty for the latest other revision in the store
+    std::string kernelbench;
+    std::string workloadreplay;
+    std::string kernelArgs;
+    std::vector<std::string> workloads;
+    int samples;
+    int replayReps;
+    double threshold;               // smallest relative slowdown reported
+    double alpha;                   // significance level
+    bool run;
+};
+
+// throughput samples of one kernel or call in one configuration
+struct Result {
+    std::string workload;
+    std::string configuration;
+    std::string kernel;
+    std::string unit;
+    std::vector<double> samples;
+};
+
+typedef std::map<std::string, Result> ResultMap;   // by workload, configuration and kernel
+
+struct Run {
+    std::string revision;
+    std::string date;
+    std::string version;
+    ResultMap results;
+};
+
+// ------------------------------------------------------------------------
+// A minimal JSON reader, for the store and the output of the benchmarks
+
+struct JsonValue {
+    enum Type {NONE, NUMBER, STRING, BOOLEAN, ARRAY, OBJECT} type;
+    double number;
+    std::string string;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue> > members;
+
+    JsonValue() : type(NONE), number(0.0) {}
+
+    const JsonValue* get(const char* key) const {
+        for (size_t i = 0; i < members.size(); i++)
+            if (members[i].first == key)
+                return &members[i].second;
+        return NULL;
+    }
+
+    double getNumber(const char* key) const {
+        const JsonValue* value = get(key);
+        return (value != NULL && value->type == NUMBER ? value->number : 0.0);
+    }
+
+    std::string getString(const char* key) const {
+        const JsonValue* value = get(key);
+        return (value != NULL && value->type == STRING ? value->string : std::string());
+    }
+};
+
+class JsonParser {
+public:
+    JsonParser(const std::string& inText) : text(inText), position(0) {}
+
+    bool parse(JsonValue* outValue) {
+        return parseValue(outValue) && (skipSpace(), position == text.size());
+    }
+
+private:
+    void skipSpace() {
+        while (position < text.size() && isspace((unsigned char) text[position]))
+            position++;
+    }
+
+    bool parseString(std::string* outString) {
+        if (text[position] != '"')
+            return false;
+        position++;
+        outString->clear();
+        while (position < text.size() && text[position] != '"') {
+            char c = text[position++];
+            if (c == '\\' && position < text.size()) {
+                c = text[position++];
+                if (c == 'n')
+                    c = '\n';
+                else if (c == 't')
+                    c = '\t';
+                else if (c == 'u') {
+                    position += 4;  // only ASCII is written by the benchmarks
+                    c = '?';
+                }
+            }
+            outString->push_back(c);
+        }
+        if (position == text.size())
+            return false;
+        position++;
+        return true;
+    }
+
+    bool parseValue(JsonValue* value) {
+        skipSpace();
+        if (position == text.size())
+            return false;
+        char c = text[position];
+        if (c == '{') {
+            value->type = JsonValue::OBJECT;
+            position++;
+            skipSpace();
+            if (position < text.size() && text[position] == '}') {
+                position++;
+                return true;
+            }
+            while (true) {
+                std::pair<std::string, JsonValue> member;
+                skipSpace();
+                if (position == text.size() || !parseString(&member.first))
+                    return false;
+                skipSpace();
+                if (position == text.size() || text[position++] != ':' || !parseValue(&member.second))
+                    return false;
+                value->members.push_back(member);
+                skipSpace();
+                if (position == text.size())
+                    return false;
+                c = text[position++];
+                if (c == '}')
+                    return true;
+                if (c != ',')
+                    return false;
+            }
+        } else if (c == '[') {
+            value->type = JsonValue::ARRAY;
+            position++;
+            skipSpace();
+            if (position < text.size() && text[position] == ']') {
+                position++;
+                return true;
+            }
+            while (true) {
+                value->items.push_back(JsonValue());
+                if (!parseValue(&value->items.back()))
+                    return false;
+                skipSpace();
+                if (position == text.size())
+                    return false;
+                c = text[position++];
+                if (c == ']')
+                    return true;
+                if (c != ',')
+                    return false;
+            }
+        } else if (c == '"') {
+            value->type = JsonValue::STRING;
+            return parseString(&value->string);
+        } else if (text.compare(position, 4, "true") == 0 || text.compare(position, 5, "false") == 0) {
+            value->type = JsonValue::BOOLEAN;
+            value->number = (c == 't' ? 1.0 : 0.0);
+            position += (c == 't' ? 4 : 5);
+            return true;
+        } else if (text.compare(position, 4, "null") == 0) {
+            position += 4;
+            return true;
+        } else {
+            const char* start = text.c_str() + position;
+            char* end;
+            value->type = JsonValue::NUMBER;
+            value->number = strtod(start, &end);
+            if (end == start)
+                return false;
+            position += end - start;
+            return true;
+        }
+    }
+
+    const std::string& text;
+    size_t position;
+};
+
+static bool readJSON(const std::string& fileName,
+                     JsonValue* outValue) {
+    FILE* file = fopen(fileName.c_str(), "rb");
+    if (file == NULL)
+        return false;
+    std::string text;
+    char buffer[4096];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        text.append(buffer, length);
+    fclose(file);
+    return JsonParser(text).parse(outValue);
+}
+
+static std::string quote(const std::string& value) {
+    std::string quoted = "\"";
+    for (size_t i = 0; i < value.size(); i++) {
+        if (value[i] == '"' || value[i] == '\\')
+            quoted.push_back('\\');
+        quoted.push_back(value[i]);
+    }
+    return quoted + "\"";
+}
+
+// ------------------------------------------------------------------------
+// Store
+
+static bool readStore(const std::string& fileName,
+                      std::vector<Run>& runs) {
+    JsonValue store;
+    if (!readJSON(fileName, &store))
+        return false;
+    if (store.getNumber("version") != STORE_VERSION) {
+        fprintf(stderr, "error: %s is not a benchmark store of this version\n", fileName.c_str());
+        return false;
+    }
+    const JsonValue* storedRuns = store.get("runs");
+    for (size_t r = 0; storedRuns != NULL && r < storedRuns->items.size(); r++) {
+        const JsonValue& storedRun = storedRuns->items[r];
+        Run run;
+        run.revision = storedRun.getString("revision");
+        run.date = storedRun.getString("date");
+        run.version = storedRun.getString("version");
+        const JsonValue* results = storedRun.get("results");
+        for (size_t i = 0; results != NULL && i < results->items.size(); i++) {
+            const JsonValue& stored = results->items[i];
+            Result result;
+            result.workload = stored.getString("workload");
+            result.configuration = stored.getString("configuration");
+            result.kernel = stored.getString("kernel");
+            result.unit = stored.getString("unit");
+            const JsonValue* samples = stored.get("samples");
+            for (size_t s = 0; samples != NULL && s < samples->items.size(); s++)
+                result.samples.push_back(samples->items[s].number);
+            run.results[result.workload + "|" + result.configuration + "|" + result.kernel] = result;
+        }
+        runs.push_back(run);
+    }
+    return true;
+}
+
+static int writeStore(const std::string& fileName,
+                      const std::vector<Run>& runs) {
+    FILE* file = fopen(fileName.c_str(), "w");
+    if (file == NULL) {
+        fprintf(stderr, "error: could not write %s\n", fileName.c_str());
+        return 1;
+    }
+    fprintf(file, "{\n  \"version\": %d,\n  \"runs\": [\n", STORE_VERSION);
+    for (size_t r = 0; r < runs.size(); r++) {
+        const Run& run = runs[r];
+        fprintf(file, "    {\n      \"revision\": %s,\n      \"date\": %s,\n      \"version\": %s,\n"
+                      "      \"results\": [\n", quote(run.revision).c_str(), quote(run.date).c_str(),
+                quote(run.version).c_str());
+        size_t i = 0;
+        for (ResultMap::const_iterator it = run.results.begin(); it != run.results.end(); ++it, ++i) {
+            const Result& result = it->second;
+            fprintf(file, "        {\"workload\": %s, \"configuration\": %s, \"kernel\": %s, \"unit\": %s, \"samples\": [",
+                    quote(result.workload).c_str(), quote(result.configuration).c_str(),
+                    quote(result.kernel).c_str(), quote(result.unit).c_str());
+            for (size_t s = 0; s < result.samples.size(); s++)
+                fprintf(file, "%s%.6e", (s > 0 ? ", " : ""), result.samples[s]);
+            fprintf(file, "]}%s\n", (i + 1 < run.results.size() ? "," : ""));
+        }
+        fprintf(file, "      ]\n    }%s\n", (r + 1 < runs.size() ? "," : ""));
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return 0;
+}
+
+// ------------------------------------------------------------------------
+// Benchmark runs
+
+static void addSample(ResultMap& results,
+                      const std::string& workload,
+                      const std::string& configuration,
+                      const std::string& kernel,
+                      const char* unit,
+                      double value) {
+    Result& result = results[workload + "|" + configuration + "|" + kernel];
+    result.workload = workload;
+    result.configuration = configuration;
+    result.kernel = kernel;
+    result.unit = unit;
+    result.samples.push_back(value);
+}
+
+static bool runKernelbench(const RegressOptions& options,
+                           const std::string& outputFile,
+                           ResultMap& results) {
+    std::string command = options.kernelbench + " " + options.kernelArgs + " --json " + outputFile + " > /dev/null";
+    JsonValue output;
+    if (system(command.c_str()) != 0 || !readJSON(outputFile, &output)) {
+        fprintf(stderr, "error: %s failed\n", command.c_str());
+        return false;
+    }
+    const JsonValue* benchmarks = output.get("benchmarks");
+    for (size_t i = 0; benchmarks != NULL && i < benchmarks->items.size(); i++) {
+        const JsonValue& benchmark = benchmarks->items[i];
+        char configuration[256];
+        snprintf(configuration, sizeof(configuration), "%s states=%d patterns=%d categories=%d %s %s",
+                 benchmark.getString("implementation").c_str(), (int) benchmark.getNumber("states"),
+                 (int) benchmark.getNumber("patterns"), (int) benchmark.getNumber("categories"),
+                 benchmark.getString("precision").c_str(), benchmark.getString("vector").c_str());
+        // names repeat the configuration after the kernel family
+        std::string kernel = benchmark.getString("name");
+        kernel = kernel.substr(0, kernel.find('/'));
+        double partialsPerSecond = benchmark.getNumber("partials_per_second");
+        double realTime = benchmark.getNumber("real_time");
+        if (partialsPerSecond > 0.0)
+            addSample(results, "kernelbench", configuration, kernel, "partials/s",
+                      partialsPerSecond);
+        else if (realTime > 0.0)
+            addSample(results, "kernelbench", configuration, kernel, "calls/s",
+                      1e9 / realTime);
+    }
+    return true;
+}
+
+static bool runWorkload(const RegressOptions& options,
+                        const std::string& workload,
+                        const char* configuration,
+                        const char* flags,
+                        const std::string& outputFile,
+                        ResultMap& results) {
+    char reps[32];
+    snprintf(reps, sizeof(reps), "%d", options.replayReps);
+    std::string command = options.workloadreplay + " " + flags + " --reps " + reps + " --json " +
+                          outputFile + " " + workload + " > /dev/null";
+    JsonValue output;
+    if (system(command.c_str()) != 0 || !readJSON(outputFile, &output)) {
+        fprintf(stderr, "error: %s failed\n", command.c_str());
+        return false;
+    }
+    std::string name = workload.substr(workload.find_last_of("/\\") + 1);
+    const JsonValue* calls = output.get("calls");
+    for (size_t i = 0; calls != NULL && i < calls->items.size(); i++) {
+        const JsonValue& call = calls->items[i];
+        if (call.getNumber("calls_per_second") > 0.0)
+            addSample(results, name, configuration, call.getString("name"), "calls/s",
+                      call.getNumber("calls_per_second"));
+    }
+    return true;
+}
+
+// ------------------------------------------------------------------------
+// Statistics
+
+static double betaContinuedFraction(double a,
+                                    double b,
+                                    double x) {
+    const double tiny = 1e-300;
+    double c = 1.0;
+    double d = 1.0 - (a + b) * x / (a + 1.0);
+    if (fabs(d) < tiny)
+        d = tiny;
+    d = 1.0 / d;
+    double h = d;
+    for (int m = 1; m <= 200; m++) {
+        int m2 = 2 * m;
+        double aa = m * (b - m) * x / ((a + m2 - 1.0) * (a + m2));
+        d = 1.0 + aa * d;
+        d = (fabs(d) < tiny ? tiny : d);
+        c = 1.0 + aa / c;
+        c = (fabs(c) < tiny ? tiny : c);
+        d = 1.0 / d;
+        h *= d * c;
+        aa = -(a + m) * (a + b + m) * x / ((a + m2) * (a + m2 + 1.0));
+        d = 1.0 + aa * d;
+        d = (fabs(d) < tiny ? tiny : d);
+        c = 1.0 + aa / c;
+        c = (fabs(c) < tiny ? tiny : c);
+        d = 1.0 / d;
+        double delta = d * c;
+        h *= delta;
+        if (fabs(delta - 1.0) < 1e-12)
+            break;
+    }
+    return h;
+}
+
+// regularized incomplete beta function I_x(a, b)
+static double incompleteBeta(double a,
+                             double b,
+                             double x) {
+    if (x <= 0.0)
+        return 0.0;
+    if (x >= 1.0)
+        return 1.0;
+    double front = exp(lgamma(a + b) - lgamma(a) - lgamma(b) + a * log(x) + b * log(1.0 - x));
+    if (x < (a + 1.0) / (a + b + 2.0))
+        return front * betaContinuedFraction(a, b, x) / a;
+    return 1.0 - front * betaContinuedFraction(b, a, 1.0 - x) / b;
+}
+
+static void getMoments(const std::vector<double>& samples,
+                       double* outMean,
+                       double* outVariance) {
+    double sum = 0.0;
+    for (size_t i = 0; i < samples.size(); i++)
+        sum += samples[i];
+    *outMean = sum / samples.size();
+    double squares = 0.0;
+    for (size_t i = 0; i < samples.size(); i++)
+        squares += (samples[i] - *outMean) * (samples[i] - *outMean);
+    *outVariance = (samples.size() > 1 ? squares / (samples.size() - 1) : 0.0);
+}
+
+// one-sided p-value of the current mean being lower than the baseline mean; -1 if too few samples
+static double getSlowdownPValue(const std::vector<double>& baseline,
+                                const std::vector<double>& current) {
+    if (baseline.size() < 2 || current.size() < 2)
+        return -1.0;
+    double baselineMean, baselineVariance, currentMean, currentVariance;
+    getMoments(baseline, &baselineMean, &baselineVariance);
+    getMoments(current, &currentMean, &currentVariance);
+    double baselineError = baselineVariance / baseline.size();
+    double currentError = currentVariance / current.size();
+    double standardError = baselineError + currentError;
+    if (standardError <= 0.0)
+        return (currentMean < baselineMean ? 0.0 : 1.0);
+    double t = (baselineMean - currentMean) / sqrt(standardError);
+    double df = standardError * standardError /
+                (baselineError * baselineError / (baseline.size() - 1) +
+                 currentError * currentError / (current.size() - 1));
+    double tail = 0.5 * incompleteBeta(df / 2.0, 0.5, df / (df + t * t));
+    return (t > 0.0 ? tail : 1.0 - tail);
+}
+
+// ------------------------------------------------------------------------
+// Report
+
+static int compareRuns(const Run& baseline,
+                       const Run& current,
+                       const RegressOptions& options) {
+    struct ConfigurationSummary {
+        int compared;
+        int regressions;
+        int improvements;
+        double logRatioSum;
+    };
+    std::map<std::string, ConfigurationSummary> configurations;
+    int regressions = 0;
+
+    fprintf(stdout, "\ncomparing %s against baseline %s (threshold %.1f%%, alpha %g)\n\n",
+            current.revision.c_str(), baseline.revision.c_str(), options.threshold * 100.0, options.alpha);
+    fprintf(stdout, "%-10s %-16s %-64s %-40s %12s %12s %8s %8s\n", "status", "workload", "configuration",
+            "kernel", "baseline", "current", "change", "p");
+
+    for (ResultMap::const_iterator it = current.results.begin(); it != current.results.end(); ++it) {
+        const Result& result = it->second;
+        ResultMap::const_iterator base = baseline.results.find(it->first);
+        if (base == baseline.results.end())
+            continue;
+
+        double baselineMean, currentMean, variance;
+        getMoments(base->second.samples, &baselineMean, &variance);
+        getMoments(result.samples, &currentMean, &variance);
+        if (baselineMean <= 0.0 || currentMean <= 0.0)
+            continue;
+        double change = currentMean / baselineMean - 1.0;
+        double pSlower = getSlowdownPValue(base->second.samples, result.samples);
+        double pFaster = getSlowdownPValue(result.samples, base->second.samples);
+
+        const char* status = NULL;
+        double p = -1.0;
+        if (change <= -options.threshold && pSlower >= 0.0 && pSlower < options.alpha) {
+            status = "REGRESSION";
+            p = pSlower;
+        } else if (change >= options.threshold && pFaster >= 0.0 && pFaster < options.alpha) {
+            status = "improved";
+            p = pFaster;
+        }
+
+        std::string configurationKey = result.workload + " " + result.configuration;
+        ConfigurationSummary& summary = configurations[configurationKey];
+        summary.compared++;
+        summary.logRatioSum += log(currentMean / baselineMean);
+        if (status == NULL)
+            continue;
+        if (p == pSlower && change < 0.0) {
+            summary.regressions++;
+            regressions++;
+        } else {
+            summary.improvements++;
+        }
+        fprintf(stdout, "%-10s %-16s %-64s %-40s %12.4e %12.4e %+7.1f%% %8.2g\n", status,
+                result.workload.c_str(), result.configuration.c_str(), result.kernel.c_str(),
+                baselineMean, currentMean, change * 100.0, p);
+    }
+
+    fprintf(stdout, "\n%-86s %8s %11s %8s %14s\n", "configuration", "kernels", "regressions", "improved",
+            "geomean change");
+    int compared = 0;
+    for (std::map<std::string, ConfigurationSummary>::const_iterator it = configurations.begin();
+         it != configurations.end(); ++it) {
+        const ConfigurationSummary& summary = it->second;
+        compared += summary.compared;
+        fprintf(stdout, "%-86s %8d %11d %8d %+13.1f%%\n", it->first.c_str(), summary.compared,
+                summary.regressions, summary.improvements,
+                (exp(summary.logRatioSum / summary.compared) - 1.0) * 100.0);
+    }
+
+    fprintf(stdout, "\n%d kernels compared, %d significant regressions\n", compared, regressions);
+    return (regressions > 0 ? 1 : 0);
+}
+
+static std::string getGitRevision() {
+    std::string revision;
+    FILE* pipe = popen("git rev-parse --short HEAD 2> /dev/null", "r");
+    if (pipe != NULL) {
+        char line[128];
+        if (fgets(line, sizeof(line), pipe) != NULL) {
+            revision = line;
+            revision.erase(revision.find_last_not_of(" \r\n") + 1);
+        }
+        pclose(pipe);
+    }
+    return (revision.empty() ? "unknown" : revision);
+}
+
+static void helpMessage() {
+    fprintf(stderr, "Usage:\n\n");
+    fprintf(stderr, "benchregress [--help] [--store <file>] [--revision <name>] [--baseline <name>] [--samples <integer>] [--workload <file>]... [--replayreps <integer>] [--kernelargs <arguments>] [--kernelbench <path>] [--workloadreplay <path>] [--threshold <fraction>] [--alpha <number>] [--norun]\n\n");
+    fprintf(stderr, "Defaults are --store benchregress.json --samples 5 --threshold 0.05 --alpha 0.01, the revision of\n");
+    fprintf(stderr, "the git checkout, and the most recent other revision in the store as the baseline\n");
+    fprintf(stderr, "--kernelargs replaces the kernelbench matrix, \"--states 4,20,61 --patterns 1000,10000 --rates 4 --mintime 0.05\"\n");
+    fprintf(stderr, "--workload adds a workload recorded with BEAGLE_RECORD, replayed in double, single and threaded mode\n");
+    fprintf(stderr, "--norun only compares revisions already in the store\n");
+    fprintf(stderr, "Exits with status 1 if there are significant regressions\n\n");
+    exit(0);
+}
+
+int main(int argc, const char* argv[]) {
+    RegressOptions options;
+    options.storeFile = "benchregress.json";
+    options.kernelbench = "../kernelbench/kernelbench";
+    options.workloadreplay = "../workloadreplay/workloadreplay";
+    options.kernelArgs = "--states 4,20,61 --patterns 1000,10000 --rates 4 --mintime 0.05";
+    options.samples = 5;
+    options.replayReps = 3;
+    options.threshold = 0.05;
+    options.alpha = 0.01;
+    options.run = true;
+
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--help") {
+            helpMessage();
+        } else if (i + 1 < argc && option == "--store") {
+            options.storeFile = argv[++i];
+        } else if (i + 1 < argc && option == "--revision") {
+            options.revision = argv[++i];
+        } else if (i + 1 < argc && option == "--baseline") {
+            options.baseline = argv[++i];
+        } else if (i + 1 < argc && option == "--samples") {
+            options.samples = atoi(argv[++i]);
+        } else if (i + 1 < argc && option == "--workload") {
+            options.workloads.push_back(argv[++i]);
+        } else if (i + 1 < argc && option == "--replayreps") {
+            options.replayReps = atoi(argv[++i]);
+        } else if (i + 1 < argc && option == "--kernelargs") {
+            options.kernelArgs = argv[++i];
+        } else if (i + 1 < argc && option == "--kernelbench") {
+            options.kernelbench = argv[++i];
+        } else if (i + 1 < argc && option == "--workloadreplay") {
+            options.workloadreplay = argv[++i];
+        } else if (i + 1 < argc && option == "--threshold") {
+            options.threshold = atof(argv[++i]);
+        } else if (i + 1 < argc && option == "--alpha") {
+            options.alpha = atof(argv[++i]);
+        } else if (option == "--norun") {
+            options.run = false;
+        } else {
+            fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+            helpMessage();
+        }
+    }
+
+    if (options.revision.empty())
+        options.revision = getGitRevision();
+
+    std::vector<Run> runs;
+    FILE* existing = fopen(options.storeFile.c_str(), "r");
+    if (existing != NULL) {
+        fclose(existing);
+        if (!readStore(options.storeFile, runs)) {
+            fprintf(stderr, "error: could not read %s\n", options.storeFile.c_str());
+            return 2;
+        }
+    }
+
+    if (options.run) {
+        Run run;
+        run.revision = options.revision;
+        run.version = beagleGetVersion();
+        char date[32];
+        time_t now = time(NULL);
+        strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+        run.date = date;
+
+        struct ReplayConfiguration {
+            const char* name;
+            const char* flags;
+        } replayConfigurations[] = {
+            {"double",          "--double"},
+            {"single",          "--single"},
+            {"double threaded", "--double --enablethreads"}
+        };
+
+        std::string outputFile = options.storeFile + ".sample.json";
+        for (int s = 0; s < options.samples; s++) {
+            fprintf(stdout, "sample %d of %d\n", s + 1, options.samples);
+            fflush(stdout);
+            if (!runKernelbench(options, outputFile, run.results))
+                return 2;
+            for (size_t w = 0; w < options.workloads.size(); w++)
+                for (size_t c = 0; c < sizeof(replayConfigurations) / sizeof(ReplayConfiguration); c++)
+                    if (!runWorkload(options, options.workloads[w], replayConfigurations[c].name,
+                                     replayConfigurations[c].flags, outputFile, run.results))
+                        return 2;
+        }
+        remove(outputFile.c_str());
+
+        // a revision measured again replaces its earlier run
+        for (size_t r = 0; r < runs.size(); r++) {
+            if (runs[r].revision == run.revision) {
+                runs.erase(runs.begin() + r);
+                break;
+            }
+        }
+        runs.push_back(run);
+        if (writeStore(options.storeFile, runs) != 0)
+            return 2;
+        fprintf(stdout, "stored %lu results of revision %s in %s\n", (unsigned long) run.results.size(),
+                run.revision.c_str(), options.storeFile.c_str());
+    }
+
+    const Run* current = NULL;
+    const Run* baseline = NULL;
+    for (size_t r = 0; r < runs.size(); r++) {
+        if (runs[r].revision == options.revision)
+            current = &runs[r];
+        else if (options.baseline.empty() || runs[r].revision == options.baseline)
+            baseline = &runs[r];
+    }
+    if (current == NULL) {
+        fprintf(stderr, "error: no results of revision %s in %s\n", options.revision.c_str(),
+                options.storeFile.c_str());
+        return 2;
+    }
+    if (baseline == NULL) {
+        if (!options.baseline.empty()) {
+            fprintf(stderr, "error: no results of baseline %s in %s\n", options.baseline.c_str(),
+                    options.storeFile.c_str());
+            return 2;
+        }
+        fprintf(stdout, "no baseline revision in %s yet\n", options.storeFile.c_str());
+        return 0;
+    }
+
+    return compareRuns(*baseline, *current, options);
+}
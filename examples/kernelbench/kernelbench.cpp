@@ -0,0 +1,494 @@
+/*
+ *  kernelbench.cpp
+ *  Microbenchmarks of the individual kernels of the CPU implementations
+ *
+ *  Each kernel family is timed in isolation through the API, for every
+ *  combination of state count, pattern count, category count, precision and
+ *  vectorization that a CPU implementation can be created for. States 4 select
+ *  the 4-state implementations; SSE and AVX select the vectorized classes.
+ *  Results are printed as a table and optionally written as JSON. With
+ *  --counters, hardware counters of each kernel are read as well, and with
+ *  --peakgflops and --peakbandwidth each kernel is placed on the roofline of the
+ *  machine from its FLOP and compulsory byte counts.
+ */
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <sstream>
+
+#include "libhmsbeagle/beagle.h"
+#include "libhmsbeagle/benchmark/PerfCounters.h"
+
+using beagle::benchmark::PerfCounters;
+using beagle::benchmark::PerfCounterValues;
+using beagle::benchmark::RooflinePosition;
+
+#define BENCH_TIP_COUNT     4   // two compact tips, two partials tips
+#define BENCH_MATRIX_COUNT  8   // transition matrices updated per matrix update call
+
+struct BenchResult {
+    std::string name;
+    std::string implName;
+    int stateCount;
+    int patternCount;
+    int categoryCount;
+    bool singlePrecision;
+    const char* vectorName;
+    long long iterations;
+    double seconds;         // per iteration
+    double partials;        // partials elements computed per iteration
+    double flops;           // floating point operations per iteration
+    double bytes;           // compulsory memory traffic per iteration
+    PerfCounterValues counters; // totals over all iterations of the final round
+};
+
+struct BenchOptions {
+    std::vector<int> states;
+    std::vector<int> patterns;
+    std::vector<int> categories;
+    double minTime;
+    const char* filter;
+    const char* jsonFile;
+    PerfCounters* counters; // NULL unless --counters is given
+    double peakGflops;
+    double peakBandwidth;   // GB/s
+};
+
+static double getTime() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::vector<int> parseList(const char* arg) {
+    std::vector<int> list;
+    std::stringstream stream(arg);
+    std::string item;
+    while (std::getline(stream, item, ','))
+        list.push_back(atoi(item.c_str()));
+    return list;
+}
+
+static void helpMessage() {
+    fprintf(stderr, "Usage:\n\n");
+    fprintf(stderr, "kernelbench [--help] [--states <list>] [--patterns <list>] [--rates <list>] [--mintime <seconds>] [--filter <substring>] [--json <file>] [--counters] [--peakgflops <number>] [--peakbandwidth <GB/s>]\n\n");
+    fprintf(stderr, "Lists are comma-separated; defaults are --states 4,20,61 --patterns 1000,10000 --rates 1,4 --mintime 0.1\n");
+    fprintf(stderr, "--counters reads cycles, instructions and cache misses through perf_event_open (Linux only)\n");
+    fprintf(stderr, "--peakgflops and --peakbandwidth give the machine roofline each kernel is placed on\n");
+    exit(0);
+}
+
+static double randomValue() {
+    return (rand() + 1.0) / (RAND_MAX + 2.0);
+}
+
+// Sets up an instance with random data; returns the instance or an error code
+static int createBenchInstance(int stateCount,
+                               int patternCount,
+                               int categoryCount,
+                               long requirementFlags,
+                               BeagleInstanceDetails* details) {
+    int partialsCount = BENCH_TIP_COUNT + 3;
+    int instance = beagleCreateInstance(BENCH_TIP_COUNT, partialsCount, 2, stateCount, patternCount,
+                                        1, BENCH_MATRIX_COUNT * 3, categoryCount, partialsCount,
+                                        NULL, 0, 0, requirementFlags, details);
+    if (instance < 0)
+        return instance;
+
+    srand(42);
+    std::vector<int> states(patternCount);
+    for (int t = 0; t < 2; t++) {
+        for (int k = 0; k < patternCount; k++)
+            states[k] = rand() % stateCount;
+        beagleSetTipStates(instance, t, &states[0]);
+    }
+    std::vector<double> partials(patternCount * stateCount);
+    for (int t = 2; t < BENCH_TIP_COUNT; t++) {
+        for (size_t k = 0; k < partials.size(); k++)
+            partials[k] = randomValue();
+        beagleSetTipPartials(instance, t, &partials[0]);
+    }
+
+    // an orthogonal eigensystem of a symmetric rate matrix is enough to exercise the kernels
+    std::vector<double> evec(stateCount * stateCount, 0.0);
+    std::vector<double> ivec(stateCount * stateCount, 0.0);
+    std::vector<double> eval(stateCount);
+    for (int i = 0; i < stateCount; i++) {
+        evec[i * stateCount + i] = 1.0;
+        ivec[i * stateCount + i] = 1.0;
+        eval[i] = (i == 0 ? 0.0 : -1.0 - i / (double) stateCount);
+    }
+    beagleSetEigenDecomposition(instance, 0, &evec[0], &ivec[0], &eval[0]);
+
+    std::vector<double> frequencies(stateCount, 1.0 / stateCount);
+    beagleSetStateFrequencies(instance, 0, &frequencies[0]);
+    std::vector<double> rates(categoryCount);
+    std::vector<double> weights(categoryCount, 1.0 / categoryCount);
+    for (int i = 0; i < categoryCount; i++)
+        rates[i] = (i + 0.5) * 2.0 / categoryCount;
+    beagleSetCategoryRates(instance, &rates[0]);
+    beagleSetCategoryWeights(instance, 0, &weights[0]);
+    std::vector<double> patternWeights(patternCount, 1.0);
+    beagleSetPatternWeights(instance, &patternWeights[0]);
+
+    return instance;
+}
+
+// Runs a kernel for at least minTime seconds after a warm-up call
+template <typename KERNEL>
+static void timeKernel(KERNEL kernel,
+                       double minTime,
+                       PerfCounters* counters,
+                       BenchResult& result) {
+    kernel();
+    long long iterations = 1;
+    while (true) {
+        if (counters != NULL)
+            counters->start();
+        double start = getTime();
+        for (long long i = 0; i < iterations; i++)
+            kernel();
+        double elapsed = getTime() - start;
+        if (counters != NULL)
+            counters->stop(&result.counters);
+        if (elapsed >= minTime || iterations >= (1LL << 30)) {
+            result.iterations = iterations;
+            result.seconds = elapsed / iterations;
+            return;
+        }
+        // aim slightly past minTime to avoid another round
+        double factor = (elapsed > 0.0 ? 1.4 * minTime / elapsed : 10.0);
+        iterations = (long long) (iterations * (factor > 10.0 ? 10.0 : (factor < 2.0 ? 2.0 : factor)));
+    }
+}
+
+// per-iteration value of a counter, or -1 if it was not counted
+static double getCounter(const BenchResult& result,
+                         int event) {
+    if (!result.counters.valid[event] || result.iterations == 0)
+        return -1.0;
+    return (double) result.counters.counts[event] / result.iterations;
+}
+
+static void printCounters(const BenchResult& result,
+                          const BenchOptions& options) {
+    RooflinePosition roofline = beagle::benchmark::getRooflinePosition(result.flops, result.bytes,
+                                                                       result.seconds,
+                                                                       options.peakGflops,
+                                                                       options.peakBandwidth);
+    if (options.counters == NULL && roofline.attainableGflops <= 0.0)
+        return;
+
+    fprintf(stdout, "    intensity %.3f FLOP/B", roofline.intensity);
+    if (options.counters != NULL) {
+        double cycles = getCounter(result, beagle::benchmark::PERF_COUNTER_CYCLES);
+        double instructions = getCounter(result, beagle::benchmark::PERF_COUNTER_INSTRUCTIONS);
+        double l1dMisses = getCounter(result, beagle::benchmark::PERF_COUNTER_L1D_MISSES);
+        double llcMisses = getCounter(result, beagle::benchmark::PERF_COUNTER_LLC_MISSES);
+        if (cycles >= 0.0)
+            fprintf(stdout, ", %.4g cycles", cycles);
+        if (instructions >= 0.0)
+            fprintf(stdout, ", %.4g instructions", instructions);
+        if (cycles > 0.0 && instructions >= 0.0)
+            fprintf(stdout, ", IPC %.2f", instructions / cycles);
+        if (l1dMisses >= 0.0)
+            fprintf(stdout, ", %.4g L1D misses", l1dMisses);
+        if (llcMisses >= 0.0)
+            fprintf(stdout, ", %.4g LLC misses (%.3f GB/s)", llcMisses,
+                    llcMisses * PERF_COUNTERS_CACHE_LINE / result.seconds / 1e9);
+    }
+    if (roofline.attainableGflops > 0.0)
+        fprintf(stdout, ", %.1f%% of %.3f GFLOP/s roof (%s bound)", roofline.fractionOfRoof * 100.0,
+                roofline.attainableGflops, (roofline.memoryBound ? "memory" : "compute"));
+    fprintf(stdout, "\n");
+}
+
+static void benchInstance(int instance,
+                          const char* implName,
+                          int stateCount,
+                          int patternCount,
+                          int categoryCount,
+                          bool singlePrecision,
+                          const char* vectorName,
+                          const BenchOptions& options,
+                          std::vector<BenchResult>& results) {
+    const int S = stateCount;
+    const double elements = (double) patternCount * categoryCount * S;
+    const double realSize = (singlePrecision ? sizeof(float) : sizeof(double));
+    const double partialsBytes = elements * realSize;
+    const double matrixBytes = (double) categoryCount * S * S * realSize;
+    const double eigenBytes = (2.0 * S * S + S) * realSize;
+    const double tipBytes = (double) patternCount * sizeof(int);
+    const double patternBytes = (double) patternCount * realSize;
+
+    BenchResult base;
+    base.implName = implName;
+    base.stateCount = stateCount;
+    base.patternCount = patternCount;
+    base.categoryCount = categoryCount;
+    base.singlePrecision = singlePrecision;
+    base.vectorName = vectorName;
+    for (int e = 0; e < beagle::benchmark::PERF_COUNTER_COUNT; e++) {
+        base.counters.counts[e] = 0;
+        base.counters.valid[e] = false;
+    }
+
+    int matrixIndices[BENCH_MATRIX_COUNT];
+    int firstDerivIndices[BENCH_MATRIX_COUNT];
+    int secondDerivIndices[BENCH_MATRIX_COUNT];
+    double edgeLengths[BENCH_MATRIX_COUNT];
+    for (int i = 0; i < BENCH_MATRIX_COUNT; i++) {
+        matrixIndices[i] = i;
+        firstDerivIndices[i] = BENCH_MATRIX_COUNT + i;
+        secondDerivIndices[i] = 2 * BENCH_MATRIX_COUNT + i;
+        edgeLengths[i] = 0.01 + 0.05 * i;
+    }
+
+    // {destination, writeScale, readScale, child1, matrix1, child2, matrix2}
+    BeagleOperation statesStates = {4, BEAGLE_OP_NONE, BEAGLE_OP_NONE, 0, 0, 1, 1};
+    BeagleOperation statesPartials = {5, BEAGLE_OP_NONE, BEAGLE_OP_NONE, 0, 2, 2, 3};
+    BeagleOperation partialsPartials = {6, BEAGLE_OP_NONE, BEAGLE_OP_NONE, 2, 4, 3, 5};
+    BeagleOperation partialsPartialsScaled = {6, 0, BEAGLE_OP_NONE, 2, 4, 3, 5};
+
+    int rootBuffer = 6;
+    int parentBuffer = 6;
+    int childBuffer = 5;
+    int edgeMatrix = 6;
+    int edgeFirstDeriv = BENCH_MATRIX_COUNT + 6;
+    int edgeSecondDeriv = 2 * BENCH_MATRIX_COUNT + 6;
+    int zero = 0;
+    int noScale = BEAGLE_OP_NONE;
+    double logL, d1, d2;
+
+    struct Kernel {
+        const char* name;
+        double partials;
+        double flops;
+        double bytes;
+        int kind;
+        const BeagleOperation* operation;
+    } kernels[] = {
+        {"matrixUpdate", 0.0, 2.0 * BENCH_MATRIX_COUNT * categoryCount * S * S * S,
+            BENCH_MATRIX_COUNT * matrixBytes + eigenBytes, 0, NULL},
+        {"matrixUpdateDerivatives", 0.0, 6.0 * BENCH_MATRIX_COUNT * categoryCount * S * S * S,
+            3 * BENCH_MATRIX_COUNT * matrixBytes + eigenBytes, 1, NULL},
+        {"statesStates", elements, elements,
+            2 * tipBytes + 2 * matrixBytes + partialsBytes, 2, &statesStates},
+        {"statesPartials", elements, elements * (2.0 * S + 1.0),
+            tipBytes + 2 * matrixBytes + 2 * partialsBytes, 2, &statesPartials},
+        {"partialsPartials", elements, elements * (4.0 * S + 1.0),
+            2 * matrixBytes + 3 * partialsBytes, 2, &partialsPartials},
+        {"partialsPartialsScaled", elements, elements * (4.0 * S + 2.0),
+            2 * matrixBytes + 3 * partialsBytes + patternBytes, 2, &partialsPartialsScaled},
+        {"rootIntegration", elements, 2.0 * elements,
+            partialsBytes + patternBytes, 3, NULL},
+        {"edgeIntegration", elements, elements * (2.0 * S + 2.0),
+            matrixBytes + 2 * partialsBytes + patternBytes, 4, NULL},
+        {"edgeIntegrationDerivatives", elements, elements * (6.0 * S + 6.0),
+            3 * matrixBytes + 2 * partialsBytes + 3 * patternBytes, 5, NULL}
+    };
+
+    // fill all matrices and internal buffers used as inputs
+    beagleUpdateTransitionMatrices(instance, 0, matrixIndices, firstDerivIndices, secondDerivIndices,
+                                   edgeLengths, BENCH_MATRIX_COUNT);
+    beagleUpdatePartials(instance, &statesPartials, 1, BEAGLE_OP_NONE);
+    beagleUpdatePartials(instance, &partialsPartials, 1, BEAGLE_OP_NONE);
+
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(Kernel); k++) {
+        const Kernel& kernel = kernels[k];
+
+        BenchResult result = base;
+        std::ostringstream name;
+        name << kernel.name << "/states:" << S << "/patterns:" << patternCount
+             << "/categories:" << categoryCount << "/" << (singlePrecision ? "single" : "double")
+             << "/" << vectorName;
+        result.name = name.str();
+        if (options.filter != NULL && result.name.find(options.filter) == std::string::npos)
+            continue;
+        result.partials = kernel.partials;
+        result.flops = kernel.flops;
+        result.bytes = kernel.bytes;
+
+        switch (kernel.kind) {
+            case 0:
+                timeKernel([&] () {
+                    beagleUpdateTransitionMatrices(instance, 0, matrixIndices, NULL, NULL,
+                                                   edgeLengths, BENCH_MATRIX_COUNT);
+                }, options.minTime, options.counters, result);
+                break;
+            case 1:
+                timeKernel([&] () {
+                    beagleUpdateTransitionMatrices(instance, 0, matrixIndices, firstDerivIndices,
+                                                   secondDerivIndices, edgeLengths, BENCH_MATRIX_COUNT);
+                }, options.minTime, options.counters, result);
+                break;
+            case 2:
+                timeKernel([&] () {
+                    beagleUpdatePartials(instance, kernel.operation, 1, BEAGLE_OP_NONE);
+                }, options.minTime, options.counters, result);
+                break;
+            case 3:
+                timeKernel([&] () {
+                    beagleCalculateRootLogLikelihoods(instance, &rootBuffer, &zero, &zero, &noScale,
+                                                      1, &logL);
+                }, options.minTime, options.counters, result);
+                break;
+            case 4:
+                timeKernel([&] () {
+                    beagleCalculateEdgeLogLikelihoods(instance, &parentBuffer, &childBuffer, &edgeMatrix,
+                                                      NULL, NULL, &zero, &zero, &noScale, 1,
+                                                      &logL, NULL, NULL);
+                }, options.minTime, options.counters, result);
+                break;
+            case 5:
+                timeKernel([&] () {
+                    beagleCalculateEdgeLogLikelihoods(instance, &parentBuffer, &childBuffer, &edgeMatrix,
+                                                      &edgeFirstDeriv, &edgeSecondDeriv, &zero, &zero,
+                                                      &noScale, 1, &logL, &d1, &d2);
+                }, options.minTime, options.counters, result);
+                break;
+        }
+
+        fprintf(stdout, "%-72s %-28s %12.3f us %10.3f Mpartials/s %8.3f GFLOP/s\n",
+                result.name.c_str(), result.implName.c_str(), result.seconds * 1e6,
+                (result.partials > 0.0 ? result.partials / result.seconds / 1e6 : 0.0),
+                result.flops / result.seconds / 1e9);
+        printCounters(result, options);
+        fflush(stdout);
+
+        results.push_back(result);
+    }
+}
+
+static int writeJSON(const char* fileName,
+                     const std::vector<BenchResult>& results,
+                     double peakGflops,
+                     double peakBandwidth) {
+    FILE* file = fopen(fileName, "w");
+    if (file == NULL) {
+        fprintf(stderr, "error: could not write %s\n", fileName);
+        return 1;
+    }
+
+    fprintf(file, "{\n  \"context\": {\n    \"library\": \"BEAGLE\",\n    \"version\": \"%s\"\n  },\n", beagleGetVersion());
+    fprintf(file, "  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        fprintf(file, "    {\"name\": \"%s\", \"implementation\": \"%s\", \"states\": %d, \"patterns\": %d, "
+                      "\"categories\": %d, \"precision\": \"%s\", \"vector\": \"%s\", \"iterations\": %lld, "
+                      "\"real_time\": %.3f, \"time_unit\": \"ns\", \"partials_per_second\": %.6e, "
+                      "\"gflops\": %.6f, \"intensity\": %.6f",
+                r.name.c_str(), r.implName.c_str(), r.stateCount, r.patternCount, r.categoryCount,
+                (r.singlePrecision ? "single" : "double"), r.vectorName, r.iterations, r.seconds * 1e9,
+                (r.partials > 0.0 ? r.partials / r.seconds : 0.0), r.flops / r.seconds / 1e9,
+                (r.bytes > 0.0 ? r.flops / r.bytes : 0.0));
+        for (int e = 0; e < beagle::benchmark::PERF_COUNTER_COUNT; e++) {
+            double value = getCounter(r, e);
+            if (value >= 0.0)
+                fprintf(file, ", \"%s\": %.1f", beagle::benchmark::getPerfCounterName(e), value);
+        }
+        RooflinePosition roofline = beagle::benchmark::getRooflinePosition(r.flops, r.bytes, r.seconds,
+                                                                           peakGflops, peakBandwidth);
+        if (roofline.attainableGflops > 0.0)
+            fprintf(file, ", \"roofline_fraction\": %.6f, \"memory_bound\": %s", roofline.fractionOfRoof,
+                    (roofline.memoryBound ? "true" : "false"));
+        fprintf(file, "}%s\n", (i + 1 < results.size() ? "," : ""));
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+
+    return 0;
+}
+
+int main(int argc, const char* argv[]) {
+    BenchOptions options;
+    options.states = parseList("4,20,61");
+    options.patterns = parseList("1000,10000");
+    options.categories = parseList("1,4");
+    options.minTime = 0.1;
+    options.filter = NULL;
+    options.jsonFile = NULL;
+    options.counters = NULL;
+    options.peakGflops = 0.0;
+    options.peakBandwidth = 0.0;
+    bool useCounters = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--help") {
+            helpMessage();
+        } else if (i + 1 < argc && option == "--states") {
+            options.states = parseList(argv[++i]);
+        } else if (i + 1 < argc && option == "--patterns") {
+            options.patterns = parseList(argv[++i]);
+        } else if (i + 1 < argc && option == "--rates") {
+            options.categories = parseList(argv[++i]);
+        } else if (i + 1 < argc && option == "--mintime") {
+            options.minTime = atof(argv[++i]);
+        } else if (i + 1 < argc && option == "--filter") {
+            options.filter = argv[++i];
+        } else if (i + 1 < argc && option == "--json") {
+            options.jsonFile = argv[++i];
+        } else if (option == "--counters") {
+            useCounters = true;
+        } else if (i + 1 < argc && option == "--peakgflops") {
+            options.peakGflops = atof(argv[++i]);
+        } else if (i + 1 < argc && option == "--peakbandwidth") {
+            options.peakBandwidth = atof(argv[++i]);
+        } else {
+            fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+            helpMessage();
+        }
+    }
+
+    PerfCounters counters;
+    if (useCounters) {
+        if (counters.isAvailable())
+            options.counters = &counters;
+        else
+            fprintf(stderr, "warning: hardware counters are not available on this system\n");
+    }
+
+    struct Vectorization {
+        const char* name;
+        long flag;
+    } vectorizations[] = {
+        {"none", BEAGLE_FLAG_VECTOR_NONE},
+        {"SSE",  BEAGLE_FLAG_VECTOR_SSE},
+        {"AVX",  BEAGLE_FLAG_VECTOR_AVX}
+    };
+
+    std::vector<BenchResult> results;
+
+    for (size_t s = 0; s < options.states.size(); s++)
+    for (size_t p = 0; p < options.patterns.size(); p++)
+    for (size_t c = 0; c < options.categories.size(); c++)
+    for (int precision = 0; precision < 2; precision++)
+    for (size_t v = 0; v < sizeof(vectorizations) / sizeof(Vectorization); v++) {
+        bool singlePrecision = (precision == 0);
+        long requirementFlags = BEAGLE_FLAG_PROCESSOR_CPU | BEAGLE_FLAG_FRAMEWORK_CPU |
+                                BEAGLE_FLAG_SCALING_MANUAL | BEAGLE_FLAG_THREADING_NONE |
+                                vectorizations[v].flag |
+                                (singlePrecision ? BEAGLE_FLAG_PRECISION_SINGLE : BEAGLE_FLAG_PRECISION_DOUBLE);
+
+        BeagleInstanceDetails details;
+        int instance = createBenchInstance(options.states[s], options.patterns[p], options.categories[c],
+                                           requirementFlags, &details);
+        if (instance < 0)
+            continue; // no implementation with these requirements
+
+        benchInstance(instance, details.implName, options.states[s], options.patterns[p],
+                      options.categories[c], singlePrecision, vectorizations[v].name, options, results);
+
+        beagleFinalizeInstance(instance);
+    }
+
+    beagleFinalize();
+
+    if (options.jsonFile != NULL)
+        return writeJSON(options.jsonFile, results, options.peakGflops, options.peakBandwidth);
+
+    return 0;
+}
@@ -12,6 +12,7 @@
 #include <vector>
 #include <algorithm>
 #include <sstream>
+#include <string>
 #include <cmath>
 #include <stack>
 #include <queue>
@@ -68,6 +69,33 @@
 
 double cpuTimeSetPartitions, cpuTimeUpdateTransitionMatrices, cpuTimeUpdatePartials, cpuTimeAccumulateScaleFactors, cpuTimeCalculateRootLogLikelihoods, cpuTimeTotal;
 
+// best-run timings of one resource and problem size, for --json and --csv output
+struct TimingRecord {
+    int resource;
+    std::string resourceName;
+    std::string implName;
+    bool doublePrecision;
+    int stateCount;
+    int ntaxa;
+    int nsites;
+    int rateCategoryCount;
+    int threadCount;
+    int nreps;
+    double logL;
+    double timeTotal;               // all times in ms
+    double timeSetPartitions;
+    double timeUpdateTransitionMatrices;
+    double timeUpdatePartials;
+    double timeAccumulateScaleFactors;
+    double timeCalculateRootLogLikelihoods;
+    double partialsThroughput;      // M partials/second in updatePartials
+    double computeThroughput;       // GFLOPS in updatePartials
+    double memoryBandwidth;         // GB/s in updatePartials
+    double treeThroughput;          // M partials/second over the whole evaluation
+};
+
+std::vector<TimingRecord> timingRecords;
+
 bool useStdlibRand;
 
 static unsigned int rand_state = 1;
@@ -1563,7 +1591,8 @@ void runBeagle(int resource,
                int  resourceCount,
                bool alignmentFromFile,
                char* treenewick,
-               bool clientThreadingEnabled)
+               bool clientThreadingEnabled,
+               bool parallelStreams)
 {
 
     int instanceCount = 1;
@@ -1714,7 +1743,7 @@ void runBeagle(int resource,
                     1,                /**< Length of resourceList list (input) */
                     (enableThreads ? BEAGLE_FLAG_THREADING_CPP : 0) |
                     ((multiRsrc && !clientThreadingEnabled) ? BEAGLE_FLAG_COMPUTATION_ASYNCH : 0) |
-		    (multiRsrc ? BEAGLE_FLAG_PARALLELOPS_STREAMS : 0),         /**< Bit-flags indicating preferred implementation charactertistics, see BeagleFlags (input) */
+		    ((multiRsrc || parallelStreams) ? BEAGLE_FLAG_PARALLELOPS_STREAMS : 0),         /**< Bit-flags indicating preferred implementation charactertistics, see BeagleFlags (input) */
                     (disableVector ? BEAGLE_FLAG_VECTOR_NONE : 0) |
                     (opencl ? BEAGLE_FLAG_FRAMEWORK_OPENCL : 0) |
                     (ievectrans ? BEAGLE_FLAG_INVEVEC_TRANSPOSED : BEAGLE_FLAG_INVEVEC_STANDARD) |
@@ -2555,6 +2584,45 @@ void runBeagle(int resource,
 
     std::cout.setf(std::ios::showpoint);
     std::cout.setf(std::ios::floatfield, std::ios::fixed);
+    unsigned int partialsOps = internalCount * eigenCount;
+    unsigned int flopsPerPartial = (stateCount * 4) - 2 + 1;
+    unsigned int bytesPerPartial = 3 * (requireDoublePrecision ? 8 : 4);
+    if (manualScaling) {
+        flopsPerPartial++;
+        bytesPerPartial += (requireDoublePrecision ? 8 : 4);
+    }
+    unsigned int matrixBytes = partialsOps * 2 * stateCount*stateCount*rateCategoryCount * (requireDoublePrecision ? 8 : 4);
+    unsigned long long partialsSize = stateCount * nsites * rateCategoryCount;
+    unsigned long long partialsTotal = partialsSize * partialsOps;
+    unsigned long long flopsTotal = partialsTotal * flopsPerPartial;
+
+    TimingRecord record;
+    record.resource = instDetails.resourceNumber;
+    record.resourceName = instDetails.resourceName;
+    record.implName = instDetails.implName;
+    record.doublePrecision = (instDetails.flags & BEAGLE_FLAG_PRECISION_DOUBLE) != 0;
+    record.stateCount = stateCount;
+    record.ntaxa = ntaxa;
+    record.nsites = nsites;
+    record.rateCategoryCount = rateCategoryCount;
+    record.threadCount = threadCount;
+    record.nreps = nreps;
+    record.logL = logL;
+    record.timeTotal = bestTimeTotal;
+    record.timeSetPartitions = bestTimeSetPartitions;
+    record.timeUpdateTransitionMatrices = bestTimeUpdateTransitionMatrices;
+    record.timeUpdatePartials = bestTimeUpdatePartials;
+    record.timeAccumulateScaleFactors = ((manualScaling || autoScaling) ? bestTimeAccumulateScaleFactors : 0.0);
+    record.timeCalculateRootLogLikelihoods = bestTimeCalculateRootLogLikelihoods;
+    // runs too short for the timer resolution report zero rather than infinite throughput
+    double partialsTime = (bestTimeUpdatePartials > 0.0 ? bestTimeUpdatePartials : HUGE_VAL);
+    double totalTime = (bestTimeTotal > 0.0 ? bestTimeTotal : HUGE_VAL);
+    record.partialsThroughput = (partialsTotal/partialsTime)/1000.0;
+    record.computeThroughput = (flopsTotal/partialsTime)/1000000.0;
+    record.memoryBandwidth = ((partialsTotal * bytesPerPartial + matrixBytes)/partialsTime)/1000000.0;
+    record.treeThroughput = (partialsTotal/totalTime)/1000.0;
+    timingRecords.push_back(record);
+
     std::cout << "best run: ";
     printTiming(bestTimeTotal, timePrecision, resource, cpuTimeTotal, speedupPrecision, 0, 0, 0);
     if (fullTiming) {
@@ -2564,17 +2632,6 @@ void runBeagle(int resource,
         printTiming(bestTimeUpdateTransitionMatrices, timePrecision, resource, cpuTimeUpdateTransitionMatrices, speedupPrecision, 1, bestTimeTotal, percentPrecision);
         std::cout << " partials:   ";
         printTiming(bestTimeUpdatePartials, timePrecision, resource, cpuTimeUpdatePartials, speedupPrecision, 1, bestTimeTotal, percentPrecision);
-        unsigned int partialsOps = internalCount * eigenCount;
-        unsigned int flopsPerPartial = (stateCount * 4) - 2 + 1;
-        unsigned int bytesPerPartial = 3 * (requireDoublePrecision ? 8 : 4);
-        if (manualScaling) {
-            flopsPerPartial++;
-            bytesPerPartial += (requireDoublePrecision ? 8 : 4);
-        }
-        unsigned int matrixBytes = partialsOps * 2 * stateCount*stateCount*rateCategoryCount * (requireDoublePrecision ? 8 : 4);
-        unsigned long long partialsSize = stateCount * nsites * rateCategoryCount;
-        unsigned long long partialsTotal = partialsSize * partialsOps;
-        unsigned long long flopsTotal = partialsTotal * flopsPerPartial;
         std::cout << " partials throughput:   " << (partialsTotal/bestTimeUpdatePartials)/1000.0 << " M partials/second " << std::endl;
         std::cout << " compute throughput:   " << (flopsTotal/bestTimeUpdatePartials)/1000000.0 << " GFLOPS " << std::endl;
         std::cout << " memory bandwidth:   " << (((partialsTotal * bytesPerPartial + matrixBytes)/bestTimeUpdatePartials))/1000000.0 << " GB/s " << std::endl;
@@ -2836,11 +2893,62 @@ void runBeagle(int resource,
 	free(freqs);
 	free(weights);
 	free(rates);
+}
 
-    if (multiRsrc) {
-        std::exit(0);
+std::string escapeJSON(const std::string& text) {
+    std::string escaped;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '"' || text[i] == '\\')
+            escaped += '\\';
+        escaped += text[i];
     }
+    return escaped;
+}
 
+void writeTimingJSON(const char* fileName,
+                     int randomSeed) {
+    FILE* file = fopen(fileName, "w");
+    if (file == NULL)
+        abort(std::string("unable to write ") + fileName);
+
+    fprintf(file, "{\n  \"context\": {\"library\": \"BEAGLE\", \"version\": \"%s\", \"seed\": %d, \"time_unit\": \"ms\"},\n",
+            beagleGetVersion(), randomSeed);
+    fprintf(file, "  \"results\": [");
+    for (size_t i = 0; i < timingRecords.size(); i++) {
+        const TimingRecord& r = timingRecords[i];
+        fprintf(file, "%s\n    {\"resource\": %d, \"resource_name\": \"%s\", \"impl_name\": \"%s\", \"precision\": \"%s\", ",
+                (i > 0 ? "," : ""), r.resource, escapeJSON(r.resourceName).c_str(), escapeJSON(r.implName).c_str(),
+                (r.doublePrecision ? "double" : "single"));
+        fprintf(file, "\"states\": %d, \"taxa\": %d, \"sites\": %d, \"rates\": %d, \"threads\": %d, \"reps\": %d, \"logL\": %.5f,\n",
+                r.stateCount, r.ntaxa, r.nsites, r.rateCategoryCount, r.threadCount, r.nreps, r.logL);
+        fprintf(file, "     \"time\": {\"total\": %.6f, \"setPartitions\": %.6f, \"transMats\": %.6f, \"partials\": %.6f, \"accScalers\": %.6f, \"rootLnL\": %.6f},\n",
+                r.timeTotal, r.timeSetPartitions, r.timeUpdateTransitionMatrices, r.timeUpdatePartials,
+                r.timeAccumulateScaleFactors, r.timeCalculateRootLogLikelihoods);
+        fprintf(file, "     \"partials_throughput\": %.6f, \"compute_throughput\": %.6f, \"memory_bandwidth\": %.6f, \"tree_throughput\": %.6f}",
+                r.partialsThroughput, r.computeThroughput, r.memoryBandwidth, r.treeThroughput);
+    }
+    fprintf(file, "\n  ]\n}\n");
+    fclose(file);
+}
+
+void writeTimingCSV(const char* fileName) {
+    FILE* file = fopen(fileName, "w");
+    if (file == NULL)
+        abort(std::string("unable to write ") + fileName);
+
+    fprintf(file, "resource,resource_name,impl_name,precision,states,taxa,sites,rates,threads,reps,logL,"
+                  "time_total_ms,time_setPartitions_ms,time_transMats_ms,time_partials_ms,time_accScalers_ms,time_rootLnL_ms,"
+                  "partials_throughput_Mps,compute_throughput_GFLOPS,memory_bandwidth_GBps,tree_throughput_Mps\n");
+    for (size_t i = 0; i < timingRecords.size(); i++) {
+        const TimingRecord& r = timingRecords[i];
+        fprintf(file, "%d,\"%s\",\"%s\",%s,%d,%d,%d,%d,%d,%d,%.5f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f\n",
+                r.resource, r.resourceName.c_str(), r.implName.c_str(), (r.doublePrecision ? "double" : "single"),
+                r.stateCount, r.ntaxa, r.nsites, r.rateCategoryCount, r.threadCount, r.nreps, r.logL,
+                r.timeTotal, r.timeSetPartitions, r.timeUpdateTransitionMatrices, r.timeUpdatePartials,
+                r.timeAccumulateScaleFactors, r.timeCalculateRootLogLikelihoods,
+                r.partialsThroughput, r.computeThroughput, r.memoryBandwidth, r.treeThroughput);
+    }
+    fclose(file);
 }
 
 void printResourceList() {
@@ -2866,7 +2974,7 @@ void printResourceList() {
 
 void helpMessage() {
     std::cerr << "Usage:\n\n";
-    std::cerr << "synthetictest [--help] [--resourcelist] [--benchmarklist] [--states <integer>] [--taxa <integer>] [--sites <integer>] [--rates <integer>] [--manualscale] [--autoscale] [--dynamicscale] [--rsrc <integer>] [--reps <integer>] [--doubleprecision] [--disablevector] [--enablethreads] [--compacttips <integer>] [--seed <integer>] [--rescalefrequency <integer>] [--fulltiming] [--unrooted] [--calcderivs] [--logscalers] [--eigencount <integer>] [--eigencomplex] [--ievectrans] [--setmatrix] [--opencl] [--partitions <integer>] [--sitelikes] [--newdata] [--randomtree] [--reroot] [--stdrand] [--pectinate] [--multirsrc] [--postorder] [--newtree] [--newparameters] [--threadcount] [--clientthreads]";
+    std::cerr << "synthetictest [--help] [--resourcelist] [--benchmarklist] [--states <integer>] [--taxa <integer>] [--sites <integer>] [--rates <integer>] [--manualscale] [--autoscale] [--dynamicscale] [--rsrc <integer>] [--reps <integer>] [--doubleprecision] [--disablevector] [--enablethreads] [--compacttips <integer>] [--seed <integer>] [--rescalefrequency <integer>] [--fulltiming] [--unrooted] [--calcderivs] [--logscalers] [--eigencount <integer>] [--eigencomplex] [--ievectrans] [--setmatrix] [--opencl] [--partitions <integer>] [--sitelikes] [--newdata] [--randomtree] [--reroot] [--stdrand] [--pectinate] [--multirsrc] [--postorder] [--newtree] [--newparameters] [--threadcount] [--clientthreads] [--streams] [--json <file>] [--csv <file>]";
 #ifdef HAVE_PLL
     std::cerr << " [--plltest]";
     std::cerr << " [--pllonly]";
@@ -2881,9 +2989,26 @@ void helpMessage() {
     std::cerr << "If --help is specified, this usage message is shown\n\n";
     std::cerr << "If --manualscale, --autoscale, or --dynamicscale is specified, BEAGLE will rescale the partials during computation\n\n";
     std::cerr << "If --fulltiming is specified, you will see more detailed timing results (requires BEAGLE_DEBUG_SYNCH defined to report accurate values)\n\n";
+    std::cerr << "--states, --taxa, --sites and --threadcount accept comma-separated lists (e.g. --sites 1000,10000,100000); every combination is run in turn on each selected resource\n\n";
+    std::cerr << "If --streams is specified, independent operations are run concurrently on separate device streams or command queues\n\n";
+    std::cerr << "If --json or --csv is specified, the best-run timings and throughput of every run are also written to the given file\n\n";
     std::exit(0);
 }
 
+void parseIntegerList(const std::string& option,
+                      std::vector<int>* values) {
+    values->clear();
+    std::stringstream ss(option);
+    int j;
+    while (ss >> j) {
+        values->push_back(j);
+        if (ss.peek() == ',')
+            ss.ignore();
+    }
+    if (values->empty())
+        values->push_back(0);
+}
+
 void interpretCommandLineParameters(int argc, const char* argv[],
                                     int* stateCount,
                                     int* ntaxa,
@@ -2927,7 +3052,14 @@ void interpretCommandLineParameters(int argc, const char* argv[],
                                     char** alignmentdna,
                                     bool* compress,
                                     char** treenewick,
-                                    bool* clientThreadingEnabled)    {
+                                    bool* clientThreadingEnabled,
+                                    bool* parallelStreams,
+                                    std::vector<int>* stateCounts,
+                                    std::vector<int>* taxaCounts,
+                                    std::vector<int>* siteCounts,
+                                    std::vector<int>* threadCounts,
+                                    char** jsonFile,
+                                    char** csvFile)    {
     bool expecting_stateCount = false;
     bool expecting_ntaxa = false;
     bool expecting_nsites = false;
@@ -2942,18 +3074,23 @@ void interpretCommandLineParameters(int argc, const char* argv[],
     bool expecting_threads = false;
     bool expecting_alignmentdna = false;
     bool expecting_treenewick = false;
+    bool expecting_jsonFile = false;
+    bool expecting_csvFile = false;
     
     for (unsigned i = 1; i < argc; ++i) {
         std::string option = argv[i];
         
         if (expecting_stateCount) {
-            *stateCount = (unsigned)atoi(option.c_str());
+            parseIntegerList(option, stateCounts);
+            *stateCount = *std::min_element(stateCounts->begin(), stateCounts->end());
             expecting_stateCount = false;
         } else if (expecting_ntaxa) {
-            *ntaxa = (unsigned)atoi(option.c_str());
+            parseIntegerList(option, taxaCounts);
+            *ntaxa = *std::min_element(taxaCounts->begin(), taxaCounts->end());
             expecting_ntaxa = false;
         } else if (expecting_nsites) {
-            *nsites = (unsigned)atoi(option.c_str());
+            parseIntegerList(option, siteCounts);
+            *nsites = *std::min_element(siteCounts->begin(), siteCounts->end());
             expecting_nsites = false;
         } else if (expecting_rateCategoryCount) {
             *rateCategoryCount = (unsigned)atoi(option.c_str());
@@ -2986,8 +3123,17 @@ void interpretCommandLineParameters(int argc, const char* argv[],
             *partitions = (unsigned)atoi(option.c_str());
             expecting_partitions = false;
         } else if (expecting_threads) {
-            *threadCount = (unsigned)atoi(option.c_str());
+            parseIntegerList(option, threadCounts);
+            *threadCount = *std::min_element(threadCounts->begin(), threadCounts->end());
             expecting_threads = false;
+        } else if (expecting_jsonFile) {
+            *jsonFile = (char*) malloc(sizeof(char) * (option.size() + 1));
+            strcpy(*jsonFile, option.c_str());
+            expecting_jsonFile = false;
+        } else if (expecting_csvFile) {
+            *csvFile = (char*) malloc(sizeof(char) * (option.size() + 1));
+            strcpy(*csvFile, option.c_str());
+            expecting_csvFile = false;
         } else if (expecting_alignmentdna) {
             *alignmentdna = (char*) malloc(sizeof(char) * sizeof(option.c_str()));
             strcpy(*alignmentdna, option.c_str());
@@ -3093,6 +3239,12 @@ void interpretCommandLineParameters(int argc, const char* argv[],
 #endif // HAVE_NCL
         } else if (option == "--clientthreads") {
             *clientThreadingEnabled = true;
+        } else if (option == "--streams") {
+            *parallelStreams = true;
+        } else if (option == "--json") {
+            expecting_jsonFile = true;
+        } else if (option == "--csv") {
+            expecting_csvFile = true;
         } else {
             std::string msg("Unknown command line parameter \"");
             msg.append(option);         
@@ -3133,6 +3285,18 @@ void interpretCommandLineParameters(int argc, const char* argv[],
     if (expecting_partitions)
         abort("read last command line option without finding value associated with --partitions");
 
+    if (expecting_threads)
+        abort("read last command line option without finding value associated with --threadcount");
+
+    if (expecting_jsonFile)
+        abort("read last command line option without finding value associated with --json");
+
+    if (expecting_csvFile)
+        abort("read last command line option without finding value associated with --csv");
+
+    if (*multiRsrc && stateCounts->size() * taxaCounts->size() * siteCounts->size() * threadCounts->size() > 1)
+        abort("multiple resources cannot be used with lists of states, taxa, sites or threads");
+
     if (*stateCount < 2)
         abort("invalid number of states supplied on the command line");
         
@@ -3163,7 +3327,7 @@ void interpretCommandLineParameters(int argc, const char* argv[],
     if (*eigenCount < 1)
         abort("invalid number for eigencount supplied on the command line");
     
-    if (*eigencomplex && (*stateCount != 4 || *eigenCount != 1))
+    if (*eigencomplex && (*stateCount != 4 || stateCounts->size() > 1 || *eigenCount != 1))
         abort("eigencomplex option only works with stateCount=4 and eigenCount=1");
 
     if (*partitions < 1 || *partitions > *nsites)
@@ -3247,6 +3411,7 @@ int main( int argc, const char* argv[] )
     bool compress = false;
     char* treenewick = NULL;
     bool clientThreadingEnabled = false;
+    bool parallelStreams = false;
 
     std::vector<int> rsrc;
     rsrc.push_back(-1);
@@ -3258,6 +3423,13 @@ int main( int argc, const char* argv[] )
     bool fullTiming = false;
     
     int rateCategoryCount = 4;
+
+    std::vector<int> stateCounts(1, stateCount);
+    std::vector<int> taxaCounts(1, ntaxa);
+    std::vector<int> siteCounts(1, nsites);
+    std::vector<int> threadCounts(1, threadCount);
+    char* jsonFile = NULL;
+    char* csvFile = NULL;
     
     interpretCommandLineParameters(argc, argv, &stateCount, &ntaxa, &nsites, &manualScaling, &autoScaling,
                                    &dynamicScaling, &rateCategoryCount, &rsrc, &nreps, &fullTiming,
@@ -3267,40 +3439,24 @@ int main( int argc, const char* argv[] )
                                    &partitions, &sitelikes, &newDataPerRep, &randomTree, &rerootTrees, &pectinate, &benchmarklist, &pllTest, &pllSiteRepeats, &pllOnly, &multiRsrc,
                                    &postorderTraversal, &newTreePerRep, &newParametersPerRep,
                                    &threadCount, &alignmentdna, &compress, &treenewick,
-                                   &clientThreadingEnabled);
+                                   &clientThreadingEnabled, &parallelStreams, &stateCounts, &taxaCounts, &siteCounts, &threadCounts,
+                                   &jsonFile, &csvFile);
 
-    if (alignmentdna == NULL) {
-        std::cout << "\nSimulating genomic ";
-        if (stateCount == 4)
-            std::cout << "DNA";
-        else
-            std::cout << stateCount << "-state data";
-        if (partitions > 1) {
-            std::cout << " with " << ntaxa << " taxa, " << nsites << " site patterns, and " << partitions << " partitions";
-        } else {
-            std::cout << " with " << ntaxa << " taxa and " << nsites << " site patterns";
-        }
-    }
 #ifdef HAVE_NCL
-    else {
+    if (alignmentdna != NULL) {
+        if (stateCounts.size() > 1 || taxaCounts.size() > 1 || siteCounts.size() > 1)
+            abort("an alignment file cannot be used with lists of states, taxa or sites");
         stateCount = 4;
         ncl_readAlignmentDNA(alignmentdna, &ntaxa, &nsites, compress);
         compactTipCount = ntaxa;
         alignmentFromFile = true;
         free(alignmentdna);
+        stateCounts.assign(1, stateCount);
+        taxaCounts.assign(1, ntaxa);
+        siteCounts.assign(1, nsites);
     }
 #endif //HAVE_NCL
 
-    if (!benchmarklist)
-        std::cout << " (" << nreps << " rep" << (nreps > 1 ? "s" : "");
-
-    std::cout << (manualScaling ? ", manual scaling":(autoScaling ? ", auto scaling":(dynamicScaling ? ", dynamic scaling":"")));
-
-    if (!benchmarklist)
-        std::cout << ", random seed " << randomSeed << ")";
-
-    std::cout << "\n\n";
-
     if (benchmarklist || multiRsrc) {
         rsrcCount =  rsrc.size() - 1;
         if (rsrcCount == 0) {
@@ -3310,9 +3466,47 @@ int main( int argc, const char* argv[] )
         }
     }
 
+    // plugins are loaded once and reused by every combination of the lists
     BeagleResourceList* rl = beagleGetResourceList();
 
-    if(rl != NULL){
+    if (rl == NULL)
+        abort("no BEAGLE resources found");
+
+    for (size_t s = 0; s < stateCounts.size(); s++) {
+    for (size_t t = 0; t < taxaCounts.size(); t++) {
+    for (size_t n = 0; n < siteCounts.size(); n++) {
+    for (size_t c = 0; c < threadCounts.size(); c++) {
+        stateCount = stateCounts[s];
+        ntaxa = taxaCounts[t];
+        nsites = siteCounts[n];
+        threadCount = threadCounts[c];
+
+        if (!alignmentFromFile) {
+            std::cout << "\nSimulating genomic ";
+            if (stateCount == 4)
+                std::cout << "DNA";
+            else
+                std::cout << stateCount << "-state data";
+            if (partitions > 1) {
+                std::cout << " with " << ntaxa << " taxa, " << nsites << " site patterns, and " << partitions << " partitions";
+            } else {
+                std::cout << " with " << ntaxa << " taxa and " << nsites << " site patterns";
+            }
+        }
+
+        if (!benchmarklist)
+            std::cout << " (" << nreps << " rep" << (nreps > 1 ? "s" : "");
+
+        std::cout << (manualScaling ? ", manual scaling":(autoScaling ? ", auto scaling":(dynamicScaling ? ", dynamic scaling":"")));
+
+        if (threadCounts.size() > 1)
+            std::cout << ", " << threadCount << " thread" << (threadCount > 1 ? "s" : "");
+
+        if (!benchmarklist)
+            std::cout << ", random seed " << randomSeed << ")";
+
+        std::cout << "\n\n";
+
         for(int i=0; i<rl->length; i++){
             if (rsrc.size() == 1 || std::find(rsrc.begin(), rsrc.end(), i)!=rsrc.end()) {
                 runBeagle(i,
@@ -3358,11 +3552,27 @@ int main( int argc, const char* argv[] )
                           rsrcCount,
                           alignmentFromFile,
                           treenewick,
-                          clientThreadingEnabled);
+                          clientThreadingEnabled,
+                          parallelStreams);
+
+                // a multiple-resource run uses the whole resource list at once
+                if (multiRsrc)
+                    break;
             }
         }
-    } else {
-        abort("no BEAGLE resources found");
+    }
+    }
+    }
+    }
+
+    if (jsonFile != NULL) {
+        writeTimingJSON(jsonFile, randomSeed);
+        free(jsonFile);
+    }
+
+    if (csvFile != NULL) {
+        writeTimingCSV(csvFile);
+        free(csvFile);
     }
 
 //#ifdef _WIN32
@@ -0,0 +1,625 @@
+/*
+ *  workloadreplay.cpp
+ *  Replays a recorded API call stream as a benchmark
+ *
+ *  A workload is recorded by running any client with BEAGLE_RECORD set to a file
+ *  name (and BEAGLE_RECORD_DATA set to also keep tip data, partials and pattern
+ *  weights). This program re-executes the recorded calls in order against the
+ *  resource and flags given on the command line, timing each call, and can check
+ *  the log likelihoods it computes against the recorded ones.
+ */
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "libhmsbeagle/beagle.h"
+#include "libhmsbeagle/WorkloadRecorder.h"
+
+using beagle::WorkloadCall;
+
+struct ReplayOptions {
+    const char* fileName;
+    int resource;               // -1 for any resource
+    long preferenceFlags;       // 0 to use the recorded flags
+    long requirementFlags;
+    long setFlags;              // added to the recorded requirement flags
+    long clearFlags;            // removed from the recorded requirement flags
+    bool asRecorded;            // require the flags of the recorded instances
+    int reps;
+    bool verify;
+    double tolerance;
+    const char* jsonFile;
+};
+
+struct InstanceDims {
+    int stateCount;
+    int patternCount;
+    int categoryCount;
+};
+
+struct CallTiming {
+    long long calls;
+    double seconds;
+};
+
+struct ReplayState {
+    std::map<int, int> instances;           // recorded index to replayed index
+    std::map<int, InstanceDims> dims;       // by recorded index
+    std::vector<CallTiming> timings;
+    long long mismatches;
+    long long failures;
+    long long skipped;
+};
+
+static double getTime() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void helpMessage() {
+    fprintf(stderr, "Usage:\n\n");
+    fprintf(stderr, "workloadreplay [--help] [--rsrc <integer>] [--preferenceflags <integer>] [--requirementflags <integer>] [--asrecorded] [--single] [--double] [--disablevector] [--sse] [--avx] [--enablethreads] [--reps <integer>] [--verify] [--tolerance <number>] [--json <file>] <workload file>\n\n");
+    fprintf(stderr, "Record a workload by running a client with %s=<file>, and %s=1 to keep tip data\n", BEAGLE_RECORD_ENV, BEAGLE_RECORD_DATA_ENV);
+    fprintf(stderr, "Without flags, instances are created with the recorded preference and requirement flags\n");
+    fprintf(stderr, "--asrecorded requires the flags of the implementations that were recorded\n");
+    fprintf(stderr, "--verify compares log likelihoods with the recorded ones (needs recorded tip data)\n");
+    fprintf(stderr, "--json writes the per-call timings to a file\n\n");
+    exit(0);
+}
+
+// pointer to the values of an array argument, NULL if a NULL pointer was recorded
+template <typename T>
+static T* getPointer(std::vector<T>& values,
+                     int length) {
+    if (length < 0)
+        return NULL;
+    if (values.empty())
+        values.resize(1);
+    return &values[0];
+}
+
+// synthetic stand-in for bulk data that was not recorded
+static void fillStates(std::vector<int>& states,
+                       int stateCount) {
+    for (size_t i = 0; i < states.size(); i++)
+        states[i] = rand() % stateCount;
+}
+
+static void fillTipPartials(std::vector<double>& partials,
+                            int stateCount) {
+    for (size_t i = 0; i < partials.size(); i += stateCount) {
+        int state = rand() % stateCount;
+        for (int s = 0; s < stateCount && i + s < partials.size(); s++)
+            partials[i + s] = (s == state ? 1.0 : 0.0);
+    }
+}
+
+static void fillPartials(std::vector<double>& partials) {
+    for (size_t i = 0; i < partials.size(); i++)
+        partials[i] = (rand() + 1.0) / (RAND_MAX + 2.0);
+}
+
+static long replaceFlags(long flags,
+                         long setFlags,
+                         long clearFlags) {
+    return (flags & ~clearFlags) | setFlags;
+}
+
+static void checkValue(const char* name,
+                       double recorded,
+                       double replayed,
+                       const ReplayOptions& options,
+                       ReplayState& state) {
+    if (!options.verify)
+        return;
+    double difference = fabs(recorded - replayed);
+    if (difference > options.tolerance * fabs(recorded) && difference > options.tolerance) {
+        if (state.mismatches < 10)
+            fprintf(stderr, "mismatch in %s: recorded %.10g, replayed %.10g\n", name, recorded, replayed);
+        state.mismatches++;
+    }
+}
+
+// Re-executes one call; returns false if its arguments could not be read
+static bool replayCall(WorkloadCall& call,
+                       const ReplayOptions& options,
+                       ReplayState& state) {
+    std::vector<int> i0, i1, i2, i3, i4, i5, i6, i7, i8;
+    std::vector<double> d0, d1, d2;
+    int n0, n1, n2, n3, n4, n5, n6, n7, n8, m0, m1, m2;
+    bool s0, s1, s2;
+    int a, b, c;
+    double x, y;
+    int returnValue = BEAGLE_SUCCESS;
+    bool timed = true;
+    double start = 0.0;
+
+    int instance = -1;
+    InstanceDims dims = {0, 0, 0};
+    if (call.call != beagle::WORKLOAD_CREATE_INSTANCE) {
+        std::map<int, int>::iterator it = state.instances.find(call.instance);
+        if (it == state.instances.end()) {
+            state.skipped++; // instance could not be created in this replay
+            return true;
+        }
+        instance = it->second;
+        dims = state.dims[call.instance];
+    }
+    int matrixSize = dims.stateCount * dims.stateCount * dims.categoryCount;
+    int partialsSize = dims.patternCount * dims.stateCount * dims.categoryCount;
+
+#define READ_OR_FAIL(expression) if (!(expression)) return false
+#define TIMED(expression) start = getTime(); returnValue = (expression)
+
+    switch (call.call) {
+        case beagle::WORKLOAD_CREATE_INSTANCE: {
+            int counts[9];
+            long long preferenceFlags, requirementFlags, implFlags;
+            for (int i = 0; i < 9; i++)
+                READ_OR_FAIL(call.readInt(&counts[i]));
+            READ_OR_FAIL(call.readLong(&preferenceFlags) && call.readLong(&requirementFlags) &&
+                         call.readLong(&implFlags));
+            if (call.returnValue < 0)
+                return true; // failed when recorded too
+            long preference = (options.preferenceFlags != 0 ? options.preferenceFlags : (long) preferenceFlags);
+            long requirement = (options.requirementFlags != 0 ? options.requirementFlags :
+                                (options.asRecorded ? (long) implFlags : (long) requirementFlags));
+            requirement = replaceFlags(requirement, options.setFlags, options.clearFlags);
+            int resource = options.resource;
+            BeagleInstanceDetails details;
+            TIMED(beagleCreateInstance(counts[0], counts[1], counts[2], counts[3], counts[4], counts[5],
+                                       counts[6], counts[7], counts[8], (resource >= 0 ? &resource : NULL),
+                                       (resource >= 0 ? 1 : 0), preference, requirement, &details));
+            if (returnValue >= 0) {
+                state.instances[call.instance] = returnValue;
+                InstanceDims created = {counts[3], counts[4], counts[7]};
+                state.dims[call.instance] = created;
+                fprintf(stdout, "instance %d: %s on %s\n", call.instance, details.implName, details.resourceName);
+                returnValue = call.returnValue;
+            } else {
+                fprintf(stderr, "could not create instance %d (error %d)\n", call.instance, returnValue);
+            }
+            break;
+        }
+        case beagle::WORKLOAD_FINALIZE_INSTANCE:
+            TIMED(beagleFinalizeInstance(instance));
+            state.instances.erase(call.instance);
+            break;
+        case beagle::WORKLOAD_CLONE_INSTANCE: {
+            BeagleInstanceDetails details;
+            TIMED(beagleCloneInstance(instance, &details));
+            if (returnValue >= 0 && call.returnValue >= 0) {
+                state.instances[call.returnValue] = returnValue;
+                state.dims[call.returnValue] = dims;
+                returnValue = call.returnValue;
+            }
+            break;
+        }
+        case beagle::WORKLOAD_SET_CPU_THREAD_COUNT:
+            READ_OR_FAIL(call.readInt(&a));
+            TIMED(beagleSetCPUThreadCount(instance, a));
+            break;
+        case beagle::WORKLOAD_SET_TIP_STATES:
+            READ_OR_FAIL(call.readInt(&a) && call.readInts(i0, &n0, &s0));
+            if (!s0)
+                fillStates(i0, dims.stateCount);
+            TIMED(beagleSetTipStates(instance, a, getPointer(i0, n0)));
+            break;
+        case beagle::WORKLOAD_SET_TIP_PARTIALS:
+            READ_OR_FAIL(call.readInt(&a) && call.readDoubles(d0, &n0, &s0));
+            if (!s0)
+                fillTipPartials(d0, dims.stateCount);
+            TIMED(beagleSetTipPartials(instance, a, getPointer(d0, n0)));
+            break;
+        case beagle::WORKLOAD_SET_PARTIALS:
+            READ_OR_FAIL(call.readInt(&a) && call.readDoubles(d0, &n0, &s0));
+            if (!s0)
+                fillPartials(d0);
+            TIMED(beagleSetPartials(instance, a, getPointer(d0, n0)));
+            break;
+        case beagle::WORKLOAD_GET_PARTIALS:
+            READ_OR_FAIL(call.readInt(&a) && call.readInt(&b));
+            d0.resize(partialsSize);
+            TIMED(beagleGetPartials(instance, a, b, &d0[0]));
+            break;
+        case beagle::WORKLOAD_SET_EIGEN_DECOMPOSITION:
+            READ_OR_FAIL(call.readInt(&a) && call.readDoubles(d0, &n0, &s0) &&
+                         call.readDoubles(d1, &n1, &s1) && call.readDoubles(d2, &n2, &s2));
+            TIMED(beagleSetEigenDecomposition(instance, a, getPointer(d0, n0), getPointer(d1, n1),
+                                              getPointer(d2, n2)));
+            break;
+        case beagle::WORKLOAD_SET_STATE_FREQUENCIES:
+            READ_OR_FAIL(call.readInt(&a) && call.readDoubles(d0, &n0, &s0));
+            TIMED(beagleSetStateFrequencies(instance, a, getPointer(d0, n0)));
+            break;
+        case beagle::WORKLOAD_SET_CATEGORY_WEIGHTS:
+            READ_OR_FAIL(call.readInt(&a) && call.readDoubles(d0, &n0, &s0));
+            TIMED(beagleSetCategoryWeights(instance, a, getPointer(d0, n0)));
+            break;
+        case beagle::WORKLOAD_SET_PATTERN_WEIGHTS:
+            READ_OR_FAIL(call.readDoubles(d0, &n0, &s0));
+            if (!s0)
+                d0.assign(d0.size(), 1.0);
+            TIMED(beagleSetPatternWeights(instance, getPointer(d0, n0)));
+            break;
+        case beagle::WORKLOAD_SET_PATTERN_PARTITIONS:
+            READ_OR_FAIL(call.readInt(&a) && call.readInts(i0, &n0, &s0));
+            TIMED(beagleSetPatternPartitions(instance, a, getPointer(i0, n0)));
+            break;
+        case beagle::WORKLOAD_SET_CATEGORY_RATES:
+            READ_OR_FAIL(call.readDoubles(d0, &n0, &s0));
+            TIMED(beagleSetCategoryRates(instance, getPointer(d0, n0)));
+            break;
+        case beagle::WORKLOAD_SET_CATEGORY_RATES_WITH_INDEX:
+            READ_OR_FAIL(call.readInt(&a) && call.readDoubles(d0, &n0, &s0));
+            TIMED(beagleSetCategoryRatesWithIndex(instance, a, getPointer(d0, n0)));
+            break;
+        case beagle::WORKLOAD_SET_TRANSITION_MATRIX:
+            READ_OR_FAIL(call.readInt(&a) && call.readDoubles(d0, &n0, &s0) && call.readDouble(&x));
+            TIMED(beagleSetTransitionMatrix(instance, a, getPointer(d0, n0), x));
+            break;
+        case beagle::WORKLOAD_SET_TRANSITION_MATRICES:
+            READ_OR_FAIL(call.readInt(&a) && call.readInts(i0, &n0, &s0) &&
+                         call.readDoubles(d0, &n1, &s1) && call.readDoubles(d1, &n2, &s2));
+            TIMED(beagleSetTransitionMatrices(instance, getPointer(i0, n0), getPointer(d0, n1),
+                                              getPointer(d1, n2), a));
+            break;
+        case beagle::WORKLOAD_GET_TRANSITION_MATRIX:
+            READ_OR_FAIL(call.readInt(&a));
+            d0.resize(matrixSize);
+            TIMED(beagleGetTransitionMatrix(instance, a, &d0[0]));
+            break;
+        case beagle::WORKLOAD_CONVOLVE_TRANSITION_MATRICES:
+            READ_OR_FAIL(call.readInt(&a) && call.readInts(i0, &n0, &s0) &&
+                         call.readInts(i1, &n1, &s1) && call.readInts(i2, &n2, &s2));
+            TIMED(beagleConvolveTransitionMatrices(instance, getPointer(i0, n0), getPointer(i1, n1),
+                                                   getPointer(i2, n2), a));
+            break;
+        case beagle::WORKLOAD_UPDATE_TRANSITION_MATRICES:
+            READ_OR_FAIL(call.readInt(&a) && call.readInt(&b) && call.readInts(i0, &n0, &s0) &&
+                         call.readInts(i1, &n1, &s1) && call.readInts(i2, &n2, &s2) &&
+                         call.readDoubles(d0, &m0, &s0));
+            TIMED(beagleUpdateTransitionMatrices(instance, a, getPointer(i0, n0), getPointer(i1, n1),
+                                                 getPointer(i2, n2), getPointer(d0, m0), b));
+            break;
+        case beagle::WORKLOAD_UPDATE_TRANSITION_MATRICES_CATEGORIES:
+            READ_OR_FAIL(call.readInt(&b) && call.readInts(i3, &n3, &s0) && call.readInts(i0, &n0, &s0) &&
+                         call.readInts(i1, &n1, &s1) && call.readInts(i2, &n2, &s2) &&
+                         call.readDoubles(d0, &m0, &s0));
+            TIMED(beagleUpdateTransitionMatricesWithModelCategories(instance, getPointer(i3, n3),
+                                                                    getPointer(i0, n0), getPointer(i1, n1),
+                                                                    getPointer(i2, n2), getPointer(d0, m0), b));
+            break;
+        case beagle::WORKLOAD_UPDATE_TRANSITION_MATRICES_MODELS:
+            READ_OR_FAIL(call.readInt(&b) && call.readInts(i3, &n3, &s0) && call.readInts(i4, &n4, &s0) &&
+                         call.readInts(i0, &n0, &s0) && call.readInts(i1, &n1, &s1) &&
+                         call.readInts(i2, &n2, &s2) && call.readDoubles(d0, &m0, &s0));
+            TIMED(beagleUpdateTransitionMatricesWithMultipleModels(instance, getPointer(i3, n3),
+                                                                   getPointer(i4, n4), getPointer(i0, n0),
+                                                                   getPointer(i1, n1), getPointer(i2, n2),
+                                                                   getPointer(d0, m0), b));
+            break;
+        case beagle::WORKLOAD_UPDATE_PARTIALS:
+            READ_OR_FAIL(call.readInt(&a) && call.readInt(&b) && call.readInts(i0, &n0, &s0));
+            TIMED(beagleUpdatePartials(instance, (const BeagleOperation*) getPointer(i0, n0), a, b));
+            break;
+        case beagle::WORKLOAD_UPDATE_PARTIALS_BY_PARTITION:
+            READ_OR_FAIL(call.readInt(&a) && call.readInts(i0, &n0, &s0));
+            TIMED(beagleUpdatePartialsByPartition(instance, (const BeagleOperationByPartition*) getPointer(i0, n0), a));
+            break;
+        case beagle::WORKLOAD_SET_TREE:
+            READ_OR_FAIL(call.readInt(&a) && call.readInt(&b) && call.readInts(i0, &n0, &s0));
+            TIMED(beagleSetTree(instance, (const BeagleOperation*) getPointer(i0, n0), a, b));
+            break;
+        case beagle::WORKLOAD_INVALIDATE_PARTIALS:
+            READ_OR_FAIL(call.readInt(&a) && call.readInts(i0, &n0, &s0));
+            TIMED(beagleInvalidatePartials(instance, getPointer(i0, n0), a));
+            break;
+        case beagle::WORKLOAD_INVALIDATE_TRANSITION_MATRICES:
+            READ_OR_FAIL(call.readInt(&a) && call.readInts(i0, &n0, &s0));
+            TIMED(beagleInvalidateTransitionMatrices(instance, getPointer(i0, n0), a));
+            break;
+        case beagle::WORKLOAD_UPDATE_TREE:
+            TIMED(beagleUpdateTree(instance));
+            break;
+        case beagle::WORKLOAD_WAIT_FOR_PARTIALS:
+            READ_OR_FAIL(call.readInt(&a) && call.readInts(i0, &n0, &s0));
+            TIMED(beagleWaitForPartials(instance, getPointer(i0, n0), a));
+            break;
+        case beagle::WORKLOAD_ACCUMULATE_SCALE_FACTORS:
+        case beagle::WORKLOAD_REMOVE_SCALE_FACTORS:
+            READ_OR_FAIL(call.readInt(&a) && call.readInt(&b) && call.readInts(i0, &n0, &s0));
+            if (call.call == beagle::WORKLOAD_ACCUMULATE_SCALE_FACTORS) {
+                TIMED(beagleAccumulateScaleFactors(instance, getPointer(i0, n0), a, b));
+            } else {
+                TIMED(beagleRemoveScaleFactors(instance, getPointer(i0, n0), a, b));
+            }
+            break;
+        case beagle::WORKLOAD_ACCUMULATE_SCALE_FACTORS_BY_PARTITION:
+        case beagle::WORKLOAD_REMOVE_SCALE_FACTORS_BY_PARTITION:
+            READ_OR_FAIL(call.readInt(&a) && call.readInt(&b) && call.readInt(&c) &&
+                         call.readInts(i0, &n0, &s0));
+            if (call.call == beagle::WORKLOAD_ACCUMULATE_SCALE_FACTORS_BY_PARTITION) {
+                TIMED(beagleAccumulateScaleFactorsByPartition(instance, getPointer(i0, n0), a, b, c));
+            } else {
+                TIMED(beagleRemoveScaleFactorsByPartition(instance, getPointer(i0, n0), a, b, c));
+            }
+            break;
+        case beagle::WORKLOAD_RESET_SCALE_FACTORS:
+            READ_OR_FAIL(call.readInt(&a));
+            TIMED(beagleResetScaleFactors(instance, a));
+            break;
+        case beagle::WORKLOAD_RESET_SCALE_FACTORS_BY_PARTITION:
+            READ_OR_FAIL(call.readInt(&a) && call.readInt(&b));
+            TIMED(beagleResetScaleFactorsByPartition(instance, a, b));
+            break;
+        case beagle::WORKLOAD_COPY_SCALE_FACTORS:
+            READ_OR_FAIL(call.readInt(&a) && call.readInt(&b));
+            TIMED(beagleCopyScaleFactors(instance, a, b));
+            break;
+        case beagle::WORKLOAD_GET_SCALE_FACTORS:
+            READ_OR_FAIL(call.readInt(&a));
+            d0.resize(dims.patternCount);
+            TIMED(beagleGetScaleFactors(instance, a, &d0[0]));
+            break;
+        case beagle::WORKLOAD_CALCULATE_ROOT:
+            READ_OR_FAIL(call.readInt(&a) && call.readInts(i0, &n0, &s0) && call.readInts(i1, &n1, &s0) &&
+                         call.readInts(i2, &n2, &s0) && call.readInts(i3, &n3, &s0) && call.readDouble(&x));
+            TIMED(beagleCalculateRootLogLikelihoods(instance, getPointer(i0, n0), getPointer(i1, n1),
+                                                    getPointer(i2, n2), getPointer(i3, n3), a, &y));
+            checkValue("calculateRootLogLikelihoods", x, y, options, state);
+            break;
+        case beagle::WORKLOAD_CALCULATE_ROOT_BY_PARTITION:
+            READ_OR_FAIL(call.readInt(&a) && call.readInt(&b) && call.readInts(i0, &n0, &s0) &&
+                         call.readInts(i1, &n1, &s0) && call.readInts(i2, &n2, &s0) &&
+                         call.readInts(i3, &n3, &s0) && call.readInts(i4, &n4, &s0) &&
+                         call.readDoubles(d0, &m0, &s0) && call.readDouble(&x));
+            d1.resize(b > 0 ? b : 1);
+            TIMED(beagleCalculateRootLogLikelihoodsByPartition(instance, getPointer(i0, n0), getPointer(i1, n1),
+                                                               getPointer(i2, n2), getPointer(i3, n3),
+                                                               getPointer(i4, n4), b, a, &d1[0], &y));
+            checkValue("calculateRootLogLikelihoodsByPartition", x, y, options, state);
+            break;
+        case beagle::WORKLOAD_CALCULATE_EDGE:
+            READ_OR_FAIL(call.readInt(&a) && call.readInts(i0, &n0, &s0) && call.readInts(i1, &n1, &s0) &&
+                         call.readInts(i2, &n2, &s0) && call.readInts(i3, &n3, &s0) &&
+                         call.readInts(i4, &n4, &s0) && call.readInts(i5, &n5, &s0) &&
+                         call.readInts(i6, &n6, &s0) && call.readInts(i7, &n7, &s0) && call.readDouble(&x));
+            {
+                double firstDerivative, secondDerivative;
+                TIMED(beagleCalculateEdgeLogLikelihoods(instance, getPointer(i0, n0), getPointer(i1, n1),
+                                                        getPointer(i2, n2), getPointer(i3, n3),
+                                                        getPointer(i4, n4), getPointer(i5, n5),
+                                                        getPointer(i6, n6), getPointer(i7, n7), a, &y,
+                                                        &firstDerivative, &secondDerivative));
+            }
+            checkValue("calculateEdgeLogLikelihoods", x, y, options, state);
+            break;
+        case beagle::WORKLOAD_CALCULATE_EDGE_BY_PARTITION:
+            READ_OR_FAIL(call.readInt(&a) && call.readInt(&b) && call.readInts(i0, &n0, &s0) &&
+                         call.readInts(i1, &n1, &s0) && call.readInts(i2, &n2, &s0) &&
+                         call.readInts(i3, &n3, &s0) && call.readInts(i4, &n4, &s0) &&
+                         call.readInts(i5, &n5, &s0) && call.readInts(i6, &n6, &s0) &&
+                         call.readInts(i7, &n7, &s0) && call.readInts(i8, &n8, &s0) &&
+                         call.readDoubles(d0, &m0, &s0) && call.readDouble(&x));
+            {
+                std::vector<double> byPartition(3 * (b > 0 ? b : 1));
+                double firstDerivative, secondDerivative;
+                TIMED(beagleCalculateEdgeLogLikelihoodsByPartition(instance, getPointer(i0, n0), getPointer(i1, n1),
+                                                                   getPointer(i2, n2), getPointer(i3, n3),
+                                                                   getPointer(i4, n4), getPointer(i5, n5),
+                                                                   getPointer(i6, n6), getPointer(i7, n7),
+                                                                   getPointer(i8, n8), b, a, &byPartition[0], &y,
+                                                                   &byPartition[b], &firstDerivative,
+                                                                   &byPartition[2 * b], &secondDerivative));
+            }
+            checkValue("calculateEdgeLogLikelihoodsByPartition", x, y, options, state);
+            break;
+        case beagle::WORKLOAD_GET_LOG_LIKELIHOOD:
+            TIMED(beagleGetLogLikelihood(instance, &y));
+            break;
+        case beagle::WORKLOAD_GET_DERIVATIVES:
+            TIMED(beagleGetDerivatives(instance, &x, &y));
+            break;
+        case beagle::WORKLOAD_GET_SITE_LOG_LIKELIHOODS:
+            d0.resize(dims.patternCount);
+            TIMED(beagleGetSiteLogLikelihoods(instance, &d0[0]));
+            break;
+        case beagle::WORKLOAD_GET_SITE_DERIVATIVES:
+            d0.resize(dims.patternCount);
+            d1.resize(dims.patternCount);
+            TIMED(beagleGetSiteDerivatives(instance, &d0[0], &d1[0]));
+            break;
+        default:
+            timed = false;
+            state.skipped++; // recorded by a newer library
+            break;
+    }
+
+#undef READ_OR_FAIL
+#undef TIMED
+
+    if (timed) {
+        CallTiming& timing = state.timings[call.call];
+        timing.calls++;
+        timing.seconds += getTime() - start;
+        if (returnValue < 0 && call.returnValue >= 0)
+            state.failures++;
+    }
+
+    return true;
+}
+
+static int writeJSON(const char* fileName,
+                     const ReplayOptions& options,
+                     const std::vector<CallTiming>& timings) {
+    FILE* file = fopen(fileName, "w");
+    if (file == NULL) {
+        fprintf(stderr, "error: could not write %s\n", fileName);
+        return 1;
+    }
+
+    fprintf(file, "{\n  \"context\": {\n    \"library\": \"BEAGLE\",\n    \"version\": \"%s\",\n"
+                  "    \"workload\": \"%s\",\n    \"reps\": %d\n  },\n", beagleGetVersion(),
+            options.fileName, options.reps);
+    fprintf(file, "  \"calls\": [\n");
+    bool first = true;
+    for (int c = 0; c < beagle::WORKLOAD_CALL_COUNT; c++) {
+        const CallTiming& timing = timings[c];
+        if (timing.calls == 0)
+            continue;
+        fprintf(file, "%s    {\"name\": \"%s\", \"calls\": %lld, \"real_time\": %.3f, \"time_unit\": \"ns\", "
+                      "\"calls_per_second\": %.6e}",
+                (first ? "" : ",\n"), beagle::getWorkloadCallName(c), timing.calls,
+                timing.seconds / timing.calls * 1e9,
+                (timing.seconds > 0.0 ? timing.calls / timing.seconds : 0.0));
+        first = false;
+    }
+    fprintf(file, "\n  ]\n}\n");
+    fclose(file);
+
+    return 0;
+}
+
+int main(int argc, const char* argv[]) {
+    ReplayOptions options;
+    options.fileName = NULL;
+    options.resource = -1;
+    options.preferenceFlags = 0;
+    options.requirementFlags = 0;
+    options.setFlags = 0;
+    options.clearFlags = 0;
+    options.asRecorded = false;
+    options.reps = 1;
+    options.verify = false;
+    options.tolerance = 1e-6;
+    options.jsonFile = NULL;
+
+    const long vectorFlags = BEAGLE_FLAG_VECTOR_NONE | BEAGLE_FLAG_VECTOR_SSE | BEAGLE_FLAG_VECTOR_AVX;
+    const long precisionFlags = BEAGLE_FLAG_PRECISION_SINGLE | BEAGLE_FLAG_PRECISION_DOUBLE;
+    const long threadingFlags = BEAGLE_FLAG_THREADING_NONE | BEAGLE_FLAG_THREADING_CPP |
+                                BEAGLE_FLAG_THREADING_OPENMP;
+
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--help") {
+            helpMessage();
+        } else if (i + 1 < argc && option == "--rsrc") {
+            options.resource = atoi(argv[++i]);
+        } else if (i + 1 < argc && option == "--preferenceflags") {
+            options.preferenceFlags = strtol(argv[++i], NULL, 0);
+        } else if (i + 1 < argc && option == "--requirementflags") {
+            options.requirementFlags = strtol(argv[++i], NULL, 0);
+        } else if (option == "--asrecorded") {
+            options.asRecorded = true;
+        } else if (option == "--single" || option == "--double") {
+            options.clearFlags |= precisionFlags;
+            options.setFlags = (options.setFlags & ~precisionFlags) |
+                               (option == "--single" ? BEAGLE_FLAG_PRECISION_SINGLE : BEAGLE_FLAG_PRECISION_DOUBLE);
+        } else if (option == "--disablevector" || option == "--sse" || option == "--avx") {
+            options.clearFlags |= vectorFlags;
+            options.setFlags = (options.setFlags & ~vectorFlags) |
+                               (option == "--sse" ? BEAGLE_FLAG_VECTOR_SSE :
+                                (option == "--avx" ? BEAGLE_FLAG_VECTOR_AVX : BEAGLE_FLAG_VECTOR_NONE));
+        } else if (option == "--enablethreads") {
+            options.clearFlags |= threadingFlags;
+            options.setFlags = (options.setFlags & ~threadingFlags) | BEAGLE_FLAG_THREADING_CPP;
+        } else if (i + 1 < argc && option == "--reps") {
+            options.reps = atoi(argv[++i]);
+        } else if (option == "--verify") {
+            options.verify = true;
+        } else if (i + 1 < argc && option == "--tolerance") {
+            options.tolerance = atof(argv[++i]);
+        } else if (i + 1 < argc && option == "--json") {
+            options.jsonFile = argv[++i];
+        } else if (options.fileName == NULL && option[0] != '-') {
+            options.fileName = argv[i];
+        } else {
+            fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+            helpMessage();
+        }
+    }
+
+    if (options.fileName == NULL)
+        helpMessage();
+
+    // read the whole workload first, so that file access is not timed
+    beagle::WorkloadReader reader;
+    if (reader.open(options.fileName) != BEAGLE_SUCCESS) {
+        fprintf(stderr, "error: %s is not a workload file of this version\n", options.fileName);
+        return 1;
+    }
+    std::vector<WorkloadCall> calls;
+    WorkloadCall call;
+    while (reader.next(&call))
+        calls.push_back(call);
+    fprintf(stdout, "%s: %lu calls\n", options.fileName, (unsigned long) calls.size());
+
+    ReplayState state;
+    CallTiming zero = {0, 0.0};
+    state.timings.assign(beagle::WORKLOAD_CALL_COUNT, zero);
+    state.mismatches = 0;
+    state.failures = 0;
+    state.skipped = 0;
+
+    for (int rep = 0; rep < options.reps; rep++) {
+        srand(42);
+        state.instances.clear();
+        state.dims.clear();
+        for (size_t i = 0; i < calls.size(); i++) {
+            WorkloadCall replayed = calls[i];
+            if (!replayCall(replayed, options, state)) {
+                fprintf(stderr, "error: malformed %s call at position %lu\n",
+                        beagle::getWorkloadCallName(replayed.call), (unsigned long) i);
+                return 1;
+            }
+        }
+        // instances left open by the client
+        for (std::map<int, int>::iterator it = state.instances.begin(); it != state.instances.end(); ++it)
+            beagleFinalizeInstance(it->second);
+    }
+
+    double totalSeconds = 0.0;
+    long long totalCalls = 0;
+    long long likelihoodCalls = 0;
+    fprintf(stdout, "\n%-44s %10s %14s %12s\n", "call", "count", "total (ms)", "mean (us)");
+    for (int c = 0; c < beagle::WORKLOAD_CALL_COUNT; c++) {
+        const CallTiming& timing = state.timings[c];
+        if (timing.calls == 0)
+            continue;
+        fprintf(stdout, "%-44s %10lld %14.3f %12.3f\n", beagle::getWorkloadCallName(c), timing.calls,
+                timing.seconds * 1e3, timing.seconds / timing.calls * 1e6);
+        totalSeconds += timing.seconds;
+        totalCalls += timing.calls;
+        if (c == beagle::WORKLOAD_CALCULATE_ROOT || c == beagle::WORKLOAD_CALCULATE_ROOT_BY_PARTITION ||
+            c == beagle::WORKLOAD_CALCULATE_EDGE || c == beagle::WORKLOAD_CALCULATE_EDGE_BY_PARTITION)
+            likelihoodCalls += timing.calls;
+    }
+    fprintf(stdout, "\ntotal: %lld calls in %.3f ms, %.1f calls/s, %.1f likelihood evaluations/s\n",
+            totalCalls, totalSeconds * 1e3, (totalSeconds > 0.0 ? totalCalls / totalSeconds : 0.0),
+            (totalSeconds > 0.0 ? likelihoodCalls / totalSeconds : 0.0));
+    if (state.skipped > 0)
+        fprintf(stdout, "skipped %lld calls on instances that could not be created or of unknown kind\n",
+                state.skipped);
+    if (state.failures > 0)
+        fprintf(stdout, "%lld calls returned a different error code than recorded\n", state.failures);
+
+    beagleFinalize();
+
+    if (options.jsonFile != NULL && writeJSON(options.jsonFile, options, state.timings) != 0)
+        return 1;
+
+    if (options.verify) {
+        if (state.mismatches > 0 || state.failures > 0) {
+            fprintf(stdout, "verification failed: %lld log likelihood mismatches\n", state.mismatches);
+            return 1;
+        }
+        fprintf(stdout, "verification passed\n");
+    }
+
+    return 0;
+}
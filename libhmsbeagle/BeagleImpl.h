@@ -29,6 +29,7 @@
 #define __beagle_impl__
 
 #include "libhmsbeagle/beagle.h"
+#include "libhmsbeagle/TraceRecorder.h"
 
 #ifdef DOUBLE_PRECISION
 #define REAL    double
@@ -41,6 +42,8 @@ namespace beagle {
 class BeagleImpl
 {
 public:
+    BeagleImpl() : traceRecorder(NULL), traceInstance(-1) {}
+
     virtual ~BeagleImpl(){}
     
     virtual int createInstance(int tipCount,
@@ -73,6 +76,14 @@ public:
     virtual int getPartials(int bufferIndex,
 							int scaleIndex,
                             double* outPartials) = 0;
+
+    virtual int getBufferLayout(BeagleBufferLayout* returnLayout) = 0;
+
+    virtual int setPartialsBuffer(int bufferIndex,
+                                  void* inPartials) = 0;
+
+    virtual int setTipStatesBuffer(int tipIndex,
+                                   int* inStates) = 0;
     
     virtual int setEigenDecomposition(int eigenIndex,
                                       const double* inEigenVectors,
@@ -234,8 +245,26 @@ public:
     
     virtual int getSiteDerivatives(double* outFirstDerivatives,
                                    double* outSecondDerivatives) = 0;
+
+    virtual int setSiteLogLikelihoodsOutput(double* outLogLikelihoods,
+                                            double* outFirstDerivatives,
+                                            double* outSecondDerivatives) = 0;
+
+    virtual int setStatisticsEnabled(int enabled) = 0;
+
+    virtual int getStatistics(BeagleInstanceStatistics* outStatistics) = 0;
+
+    virtual int resetStatistics() = 0;
+
+    virtual int saveInstance(const char* fileName) = 0;
+
+    virtual int loadInstance(const char* fileName) = 0;
+
+    virtual int shareBuffers(BeagleImpl* sourceImpl) = 0;
 //protected:
     int resourceNumber;
+    TraceRecorder* traceRecorder; // set by the library when tracing is enabled, otherwise NULL
+    int traceInstance;            // instance number reported in trace events
 };
 
 class BeagleImplFactory {
@@ -69,6 +69,8 @@ protected:
     using BeagleCPUImpl<BEAGLE_CPU_4_AVX_FLOAT>::gStateFrequencies;
     using BeagleCPUImpl<BEAGLE_CPU_4_AVX_FLOAT>::realtypeMin;
     using BeagleCPUImpl<BEAGLE_CPU_4_AVX_FLOAT>::outLogLikelihoodsTmp;
+    using BeagleCPUImpl<BEAGLE_CPU_4_AVX_FLOAT>::gSiteLogLikelihoodsOutput;
+    using BeagleCPUImpl<BEAGLE_CPU_4_AVX_FLOAT>::storeSiteValue;
     using BeagleCPUImpl<BEAGLE_CPU_4_AVX_FLOAT>::gPatternWeights;
     
 public:    
@@ -150,6 +152,8 @@ protected:
     using BeagleCPUImpl<BEAGLE_CPU_4_AVX_DOUBLE>::gStateFrequencies;
     using BeagleCPUImpl<BEAGLE_CPU_4_AVX_DOUBLE>::realtypeMin;
     using BeagleCPUImpl<BEAGLE_CPU_4_AVX_DOUBLE>::outLogLikelihoodsTmp;
+    using BeagleCPUImpl<BEAGLE_CPU_4_AVX_DOUBLE>::gSiteLogLikelihoodsOutput;
+    using BeagleCPUImpl<BEAGLE_CPU_4_AVX_DOUBLE>::storeSiteValue;
     using BeagleCPUImpl<BEAGLE_CPU_4_AVX_DOUBLE>::gPatternWeights;
     
 public:
@@ -673,6 +673,7 @@ int BeagleCPU4StateAVXImpl<BEAGLE_CPU_4_AVX_DOUBLE>::calcEdgeLogLikelihoods(cons
     *outSumLogLikelihood = 0.0;
     for (int i = 0; i < kPatternCount; i++) {
         *outSumLogLikelihood += outLogLikelihoodsTmp[i] * gPatternWeights[i];
+        storeSiteValue(gSiteLogLikelihoodsOutput, i, outLogLikelihoodsTmp[i]);
     }
 
     if (*outSumLogLikelihood != *outSumLogLikelihood)
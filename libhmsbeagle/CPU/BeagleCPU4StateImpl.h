@@ -62,6 +62,8 @@ protected:
 	using BeagleCPUImpl<BEAGLE_CPU_GENERIC>::gCategoryWeights;
 	using BeagleCPUImpl<BEAGLE_CPU_GENERIC>::gPatternWeights;
 	using BeagleCPUImpl<BEAGLE_CPU_GENERIC>::outLogLikelihoodsTmp;
+	using BeagleCPUImpl<BEAGLE_CPU_GENERIC>::gSiteLogLikelihoodsOutput;
+	using BeagleCPUImpl<BEAGLE_CPU_GENERIC>::storeSiteValue;
 	using BeagleCPUImpl<BEAGLE_CPU_GENERIC>::realtypeMin;
   using BeagleCPUImpl<BEAGLE_CPU_GENERIC>::scalingExponentThreshold;
   using BeagleCPUImpl<BEAGLE_CPU_GENERIC>::gPatternPartitionsStartPatterns;
@@ -193,6 +195,59 @@ public:
                                             const int partitionIndex);
 
 
+protected:
+    // bodies of the virtual kernels above, compiled for several instruction sets, see CPUDispatch.h
+    BEAGLE_CPU_MULTIVERSION void calcStatesStatesKernel(REALTYPE* destP,
+                                                        const int* states1,
+                                                        const REALTYPE* matrices1,
+                                                        const int* states2,
+                                                        const REALTYPE* matrices2,
+                                                        int startPattern,
+                                                        int endPattern);
+
+    BEAGLE_CPU_MULTIVERSION void calcStatesStatesFixedScalingKernel(REALTYPE* destP,
+                                                                    const int* states1,
+                                                                    const REALTYPE* matrices1,
+                                                                    const int* states2,
+                                                                    const REALTYPE* matrices2,
+                                                                    const REALTYPE* scaleFactors,
+                                                                    int startPattern,
+                                                                    int endPattern);
+
+    BEAGLE_CPU_MULTIVERSION void calcStatesPartialsKernel(REALTYPE* destP,
+                                                          const int* states1,
+                                                          const REALTYPE* matrices1,
+                                                          const REALTYPE* partials2,
+                                                          const REALTYPE* matrices2,
+                                                          int startPattern,
+                                                          int endPattern);
+
+    BEAGLE_CPU_MULTIVERSION void calcStatesPartialsFixedScalingKernel(REALTYPE* destP,
+                                                                      const int* states1,
+                                                                      const REALTYPE* matrices1,
+                                                                      const REALTYPE* partials2,
+                                                                      const REALTYPE* matrices2,
+                                                                      const REALTYPE* scaleFactors,
+                                                                      int startPattern,
+                                                                      int endPattern);
+
+    BEAGLE_CPU_MULTIVERSION void calcPartialsPartialsKernel(REALTYPE* destP,
+                                                            const REALTYPE* partials1,
+                                                            const REALTYPE* matrices1,
+                                                            const REALTYPE* partials2,
+                                                            const REALTYPE* matrices2,
+                                                            int startPattern,
+                                                            int endPattern);
+
+    BEAGLE_CPU_MULTIVERSION void calcPartialsPartialsFixedScalingKernel(REALTYPE* destP,
+                                                                        const REALTYPE* partials1,
+                                                                        const REALTYPE* matrices1,
+                                                                        const REALTYPE* partials2,
+                                                                        const REALTYPE* matrices2,
+                                                                        const REALTYPE* scaleFactors,
+                                                                        int startPattern,
+                                                                        int endPattern);
+
 };
 
 BEAGLE_CPU_FACTORY_TEMPLATE
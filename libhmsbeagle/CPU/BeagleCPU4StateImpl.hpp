@@ -158,8 +158,18 @@ void BeagleCPU4StateImpl<BEAGLE_CPU_GENERIC>::calcStatesStates(REALTYPE* destP,
                                                                const REALTYPE* matrices2,
                                                                int startPattern,
                                                                int endPattern) {
+    calcStatesStatesKernel(destP, states1, matrices1, states2, matrices2, startPattern, endPattern);
+}
+
+BEAGLE_CPU_TEMPLATE
+void BeagleCPU4StateImpl<BEAGLE_CPU_GENERIC>::calcStatesStatesKernel(REALTYPE* destP,
+                                                                     const int* states1,
+                                                                     const REALTYPE* matrices1,
+                                                                     const int* states2,
+                                                                     const REALTYPE* matrices2,
+                                                                     int startPattern,
+                                                                     int endPattern) {
 
-#pragma omp parallel for num_threads(kCategoryCount)
     for (int l = 0; l < kCategoryCount; l++) {
         int v = l*4*kPaddedPatternCount;
         if (startPattern != 0) {
@@ -195,8 +205,20 @@ void BeagleCPU4StateImpl<BEAGLE_CPU_GENERIC>::calcStatesStatesFixedScaling(REALT
                                                                            const REALTYPE* scaleFactors,
                                                                            int startPattern,
                                                                            int endPattern) {
+    calcStatesStatesFixedScalingKernel(destP, states1, matrices1, states2,
+                                       matrices2, scaleFactors, startPattern, endPattern);
+}
+
+BEAGLE_CPU_TEMPLATE
+void BeagleCPU4StateImpl<BEAGLE_CPU_GENERIC>::calcStatesStatesFixedScalingKernel(REALTYPE* destP,
+                                                                                 const int* states1,
+                                                                                 const REALTYPE* matrices1,
+                                                                                 const int* states2,
+                                                                                 const REALTYPE* matrices2,
+                                                                                 const REALTYPE* scaleFactors,
+                                                                                 int startPattern,
+                                                                                 int endPattern) {
 
-#pragma omp parallel for num_threads(kCategoryCount)
     for (int l = 0; l < kCategoryCount; l++) {
         int v = l*4*kPaddedPatternCount;
         if (startPattern != 0) {
@@ -235,8 +257,19 @@ void BeagleCPU4StateImpl<BEAGLE_CPU_GENERIC>::calcStatesPartials(REALTYPE* destP
                                                                  const REALTYPE* matrices2,
                                                                  int startPattern,
                                                                  int endPattern) {
+    calcStatesPartialsKernel(destP, states1, matrices1, partials2,
+                             matrices2, startPattern, endPattern);
+}
+
+BEAGLE_CPU_TEMPLATE
+void BeagleCPU4StateImpl<BEAGLE_CPU_GENERIC>::calcStatesPartialsKernel(REALTYPE* destP,
+                                                                       const int* states1,
+                                                                       const REALTYPE* matrices1,
+                                                                       const REALTYPE* partials2,
+                                                                       const REALTYPE* matrices2,
+                                                                       int startPattern,
+                                                                       int endPattern) {
 
-#pragma omp parallel for num_threads(kCategoryCount)
     for (int l = 0; l < kCategoryCount; l++) {
         int u = l*4*kPaddedPatternCount;
         if (startPattern != 0) {
@@ -274,8 +307,20 @@ void BeagleCPU4StateImpl<BEAGLE_CPU_GENERIC>::calcStatesPartialsFixedScaling(REA
                                                                              const REALTYPE* scaleFactors,
                                                                              int startPattern,
                                                                              int endPattern) {
+    calcStatesPartialsFixedScalingKernel(destP, states1, matrices1, partials2,
+                                         matrices2, scaleFactors, startPattern, endPattern);
+}
+
+BEAGLE_CPU_TEMPLATE
+void BeagleCPU4StateImpl<BEAGLE_CPU_GENERIC>::calcStatesPartialsFixedScalingKernel(REALTYPE* destP,
+                                                                                   const int* states1,
+                                                                                   const REALTYPE* matrices1,
+                                                                                   const REALTYPE* partials2,
+                                                                                   const REALTYPE* matrices2,
+                                                                                   const REALTYPE* scaleFactors,
+                                                                                   int startPattern,
+                                                                                   int endPattern) {
 
-#pragma omp parallel for num_threads(kCategoryCount)
     for (int l = 0; l < kCategoryCount; l++) {
         int u = l*4*kPaddedPatternCount;
         if (startPattern != 0) {
@@ -313,9 +358,20 @@ void BeagleCPU4StateImpl<BEAGLE_CPU_GENERIC>::calcPartialsPartials(REALTYPE* des
                                                                    const REALTYPE* matrices2,
                                                                    int startPattern,
                                                                    int endPattern) {
+    calcPartialsPartialsKernel(destP, partials1, matrices1, partials2,
+                               matrices2, startPattern, endPattern);
+}
+
+BEAGLE_CPU_TEMPLATE
+void BeagleCPU4StateImpl<BEAGLE_CPU_GENERIC>::calcPartialsPartialsKernel(REALTYPE* destP,
+                                                                         const REALTYPE* partials1,
+                                                                         const REALTYPE* matrices1,
+                                                                         const REALTYPE* partials2,
+                                                                         const REALTYPE* matrices2,
+                                                                         int startPattern,
+                                                                         int endPattern) {
     
  
-#pragma omp parallel for num_threads(kCategoryCount)
     for (int l = 0; l < kCategoryCount; l++) {
         int u = l*4*kPaddedPatternCount;
         if (startPattern != 0) {
@@ -353,7 +409,6 @@ void BeagleCPU4StateImpl<BEAGLE_CPU_GENERIC>::calcPartialsPartialsAutoScaling(RE
                                                                     int* activateScaling) {
     
     
-#pragma omp parallel for num_threads(kCategoryCount)
     for (int l = 0; l < kCategoryCount; l++) {
         int u = l*4*kPaddedPatternCount;
         int w = l*4*OFFSET;
@@ -408,8 +463,20 @@ void BeagleCPU4StateImpl<BEAGLE_CPU_GENERIC>::calcPartialsPartialsFixedScaling(R
                                                                                const REALTYPE* scaleFactors,
                                                                                int startPattern,
                                                                                int endPattern) {
+    calcPartialsPartialsFixedScalingKernel(destP, partials1, matrices1, partials2,
+                                           matrices2, scaleFactors, startPattern, endPattern);
+}
+
+BEAGLE_CPU_TEMPLATE
+void BeagleCPU4StateImpl<BEAGLE_CPU_GENERIC>::calcPartialsPartialsFixedScalingKernel(REALTYPE* destP,
+                                                                                     const REALTYPE* partials1,
+                                                                                     const REALTYPE* matrices1,
+                                                                                     const REALTYPE* partials2,
+                                                                                     const REALTYPE* matrices2,
+                                                                                     const REALTYPE* scaleFactors,
+                                                                                     int startPattern,
+                                                                                     int endPattern) {
 
-#pragma omp parallel for num_threads(kCategoryCount)
     for (int l = 0; l < kCategoryCount; l++) {
         int u = l*4*kPaddedPatternCount;
         if (startPattern != 0) {
@@ -480,6 +547,7 @@ int inline BeagleCPU4StateImpl<BEAGLE_CPU_GENERIC>::integrateOutStatesAndScale(c
     *outSumLogLikelihood = 0.0;    
     for(int k=0; k < kPatternCount; k++) {
         *outSumLogLikelihood += outLogLikelihoodsTmp[k] * gPatternWeights[k];
+        storeSiteValue(gSiteLogLikelihoodsOutput, k, outLogLikelihoodsTmp[k]);
     }    
     
     if (*outSumLogLikelihood != *outSumLogLikelihood)
@@ -535,6 +603,7 @@ void inline BeagleCPU4StateImpl<BEAGLE_CPU_GENERIC>::integrateOutStatesAndScaleB
       outSumLogLikelihoodByPartition[p] = 0.0;
       for(int k=startPattern; k < endPattern; k++) {
           outSumLogLikelihoodByPartition[p] += outLogLikelihoodsTmp[k] * gPatternWeights[k];
+          storeSiteValue(gSiteLogLikelihoodsOutput, k, outLogLikelihoodsTmp[k]);
       }
     }
     
@@ -1043,6 +1112,7 @@ int BeagleCPU4StateImpl<BEAGLE_CPU_GENERIC>::calcRootLogLikelihoodsMulti(const i
     *outSumLogLikelihood = 0.0;
     for (int i = 0; i < kPatternCount; i++) {
         *outSumLogLikelihood += outLogLikelihoodsTmp[i] * gPatternWeights[i];
+        storeSiteValue(gSiteLogLikelihoodsOutput, i, outLogLikelihoodsTmp[i]);
     }
     
     if (*outSumLogLikelihood != *outSumLogLikelihood)
@@ -1111,7 +1181,7 @@ BEAGLE_CPU_FACTORY_TEMPLATE
 const long BeagleCPU4StateImplFactory<BEAGLE_CPU_FACTORY_GENERIC>::getFlags() {
     long flags =  BEAGLE_FLAG_COMPUTATION_SYNCH |
                   BEAGLE_FLAG_SCALING_MANUAL | BEAGLE_FLAG_SCALING_ALWAYS | BEAGLE_FLAG_SCALING_AUTO |
-                  BEAGLE_FLAG_THREADING_NONE | BEAGLE_FLAG_THREADING_CPP |
+                  BEAGLE_CPU_THREADING_FLAGS |
                   BEAGLE_FLAG_PROCESSOR_CPU |
                   BEAGLE_FLAG_VECTOR_NONE |
                   BEAGLE_FLAG_SCALERS_LOG | BEAGLE_FLAG_SCALERS_RAW |
@@ -69,6 +69,8 @@ protected:
     using BeagleCPUImpl<BEAGLE_CPU_4_SSE_FLOAT>::gStateFrequencies;
     using BeagleCPUImpl<BEAGLE_CPU_4_SSE_FLOAT>::realtypeMin;
     using BeagleCPUImpl<BEAGLE_CPU_4_SSE_FLOAT>::outLogLikelihoodsTmp;
+    using BeagleCPUImpl<BEAGLE_CPU_4_SSE_FLOAT>::gSiteLogLikelihoodsOutput;
+    using BeagleCPUImpl<BEAGLE_CPU_4_SSE_FLOAT>::storeSiteValue;
     using BeagleCPUImpl<BEAGLE_CPU_4_SSE_FLOAT>::gPatternWeights;
     using BeagleCPUImpl<BEAGLE_CPU_4_SSE_FLOAT>::gPatternPartitionsStartPatterns;
     
@@ -161,6 +163,8 @@ protected:
     using BeagleCPUImpl<BEAGLE_CPU_4_SSE_DOUBLE>::gStateFrequencies;
     using BeagleCPUImpl<BEAGLE_CPU_4_SSE_DOUBLE>::realtypeMin;
     using BeagleCPUImpl<BEAGLE_CPU_4_SSE_DOUBLE>::outLogLikelihoodsTmp;
+    using BeagleCPUImpl<BEAGLE_CPU_4_SSE_DOUBLE>::gSiteLogLikelihoodsOutput;
+    using BeagleCPUImpl<BEAGLE_CPU_4_SSE_DOUBLE>::storeSiteValue;
     using BeagleCPUImpl<BEAGLE_CPU_4_SSE_DOUBLE>::gPatternWeights;
     using BeagleCPUImpl<BEAGLE_CPU_4_SSE_DOUBLE>::gPatternPartitionsStartPatterns;
     
@@ -618,6 +618,7 @@ int BeagleCPU4StateSSEImpl<BEAGLE_CPU_4_SSE_DOUBLE>::calcEdgeLogLikelihoods(cons
     *outSumLogLikelihood = 0.0;
     for (int i = 0; i < kPatternCount; i++) {
         *outSumLogLikelihood += outLogLikelihoodsTmp[i] * gPatternWeights[i];
+        storeSiteValue(gSiteLogLikelihoodsOutput, i, outLogLikelihoodsTmp[i]);
     }
 
     if (*outSumLogLikelihood != *outSumLogLikelihood)
@@ -791,6 +792,7 @@ void BeagleCPU4StateSSEImpl<BEAGLE_CPU_4_SSE_DOUBLE>::calcEdgeLogLikelihoodsByPa
         outSumLogLikelihoodByPartition[p] = 0.0;
         for (int i = startPattern; i < endPattern; i++) {
             outSumLogLikelihoodByPartition[p] += outLogLikelihoodsTmp[i] * gPatternWeights[i];
+            storeSiteValue(gSiteLogLikelihoodsOutput, i, outLogLikelihoodsTmp[i]);
         }
 
     }
@@ -900,7 +902,7 @@ template <>
 const long BeagleCPU4StateSSEImplFactory<double>::getFlags() {
     return BEAGLE_FLAG_COMPUTATION_SYNCH |
            BEAGLE_FLAG_SCALING_MANUAL | BEAGLE_FLAG_SCALING_ALWAYS | BEAGLE_FLAG_SCALING_AUTO |
-           BEAGLE_FLAG_THREADING_NONE | BEAGLE_FLAG_THREADING_CPP |
+           BEAGLE_CPU_THREADING_FLAGS |
            BEAGLE_FLAG_PROCESSOR_CPU |
            BEAGLE_FLAG_VECTOR_SSE |
            BEAGLE_FLAG_PRECISION_DOUBLE |
@@ -914,7 +916,7 @@ template <>
 const long BeagleCPU4StateSSEImplFactory<float>::getFlags() {
     return BEAGLE_FLAG_COMPUTATION_SYNCH |
            BEAGLE_FLAG_SCALING_MANUAL | BEAGLE_FLAG_SCALING_ALWAYS | BEAGLE_FLAG_SCALING_AUTO |
-           BEAGLE_FLAG_THREADING_NONE | BEAGLE_FLAG_THREADING_CPP |
+           BEAGLE_CPU_THREADING_FLAGS |
            BEAGLE_FLAG_PROCESSOR_CPU |
            BEAGLE_FLAG_VECTOR_SSE |
            BEAGLE_FLAG_PRECISION_SINGLE |
@@ -0,0 +1,71 @@
+/*
+ *  BeagleCPUAVXFactories.cpp
+ *  AVX implementations of the CPU plugin
+ *
+ *
+ * Copyright 2009 Phylogenetic Likelihood Working Group
+ *
+ * This file is part of BEAGLE.
+ *
+ * BEAGLE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * BEAGLE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BEAGLE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "libhmsbeagle/config.h"
+#endif
+
+#include "libhmsbeagle/CPU/CPUDispatch.h"
+
+// the AVX implementations are experimental, and only built with BEAGLE_CPU_AVX
+#if defined(BEAGLE_CPU_AVX) && (defined(__AVX__) || defined(BEAGLE_CPU_TARGET_PRAGMA))
+    #define BEAGLE_CPU_BUILD_AVX
+#endif
+
+#ifdef BEAGLE_CPU_BUILD_AVX
+// the shared base classes come first, so that they stay compiled for the baseline
+#include "libhmsbeagle/CPU/BeagleCPU4StateImpl.h"
+#include "libhmsbeagle/CPU/BeagleCPUImpl.h"
+
+#if !defined(__AVX__) && defined(BEAGLE_CPU_TARGET_PRAGMA)
+    #pragma GCC push_options
+    #pragma GCC target("avx")
+    #define BEAGLE_CPU_POP_TARGET
+#endif
+
+// BeagleCPUAVXImpl, for other state counts, does not build against the current kernel interface
+#include "libhmsbeagle/CPU/BeagleCPU4StateAVXImpl.h"
+
+#ifdef BEAGLE_CPU_POP_TARGET
+    #pragma GCC pop_options
+#endif
+#endif // BEAGLE_CPU_BUILD_AVX
+
+namespace beagle {
+namespace cpu {
+
+long addAVXFactories(std::list<beagle::BeagleImplFactory*>& factories) {
+#ifdef BEAGLE_CPU_BUILD_AVX
+    if (!cpuSupportsAVX())
+        return 0;
+
+    factories.push_back(new beagle::cpu::BeagleCPU4StateAVXImplFactory<double>());
+    return BEAGLE_FLAG_VECTOR_AVX;
+#else
+    return 0;
+#endif
+}
+
+}   // namespace cpu
+}   // namespace beagle
@@ -33,8 +33,11 @@
 #endif
 
 #include "libhmsbeagle/BeagleImpl.h"
+#include "libhmsbeagle/InstanceStatistics.h"
 #include "libhmsbeagle/CPU/Precision.h"
 #include "libhmsbeagle/CPU/EigenDecomposition.h"
+#include "libhmsbeagle/CPU/CPUAutotuner.h"
+#include "libhmsbeagle/CPU/CPUDispatch.h"
 
 #include <vector>
 #include <thread>
@@ -43,6 +46,7 @@
 #include <condition_variable>
 #include <mutex>
 #include <functional>
+#include <atomic>
 
 #define BEAGLE_CPU_GENERIC	REALTYPE, T_PAD, P_PAD
 #define BEAGLE_CPU_TEMPLATE	template <typename REALTYPE, int T_PAD, int P_PAD>
@@ -54,11 +58,25 @@
 #define T_PAD_DEFAULT   1   // Pad transition matrix rows with an extra 1.0 for ambiguous characters
 #define P_PAD_DEFAULT   0   // No partials padding necessary for non-SSE implementations
 
-//  TODO: assess following cut-offs dynamically
+//  Fixed cut-offs, used where no measured configuration is available (see CPUAutotuner.h)
 #define BEAGLE_CPU_ASYNC_HW_THREAD_COUNT_THRESHOLD     16  // CPU category threshold
 #define BEAGLE_CPU_ASYNC_MIN_PATTERN_COUNT_LOW        256  // do not use CPU auto-threading for problems with fewer patterns on CPUs with many cores
 #define BEAGLE_CPU_ASYNC_MIN_PATTERN_COUNT_HIGH       768  // do not use CPU auto-threading for problems with fewer patterns on CPUs with few cores
 #define BEAGLE_CPU_ASYNC_LIMIT_PATTERN_COUNT       262144  // do not use all CPU cores for problems with fewer patterns
+#define BEAGLE_CPU_ASYNC_PARTITIONS_PER_THREAD         4  // auto-threading pattern blocks per thread, taken by whichever thread is free
+#define BEAGLE_CPU_ASYNC_MIN_PARTITION_PATTERN_COUNT  32  // do not split auto-threading pattern blocks below this size
+
+// threading models of the CPU implementations; OpenMP only in plugins built with it
+#ifdef _OPENMP
+    #define BEAGLE_CPU_THREADING_FLAGS  (BEAGLE_FLAG_THREADING_NONE | BEAGLE_FLAG_THREADING_CPP | BEAGLE_FLAG_THREADING_OPENMP)
+#else
+    #define BEAGLE_CPU_THREADING_FLAGS  (BEAGLE_FLAG_THREADING_NONE | BEAGLE_FLAG_THREADING_CPP)
+#endif
+
+#define BEAGLE_CPU_BUFFER_ALIGNMENT        32  // byte alignment of partials, matrix and tip-state buffers
+
+#define BEAGLE_CPU_CHECKPOINT_VERSION       1  // increment whenever the checkpoint file layout changes
+#define BEAGLE_CPU_CHECKPOINT_ALIGNMENT    64  // byte alignment of each buffer within a checkpoint file
 
 namespace beagle {
 namespace cpu {
@@ -126,6 +144,15 @@ protected:
     //  into a single array
     REALTYPE** gTransitionMatrices;
 
+    // Reference counts of partials, tip-state and matrix buffers that are shared
+    // copy-on-write with cloned instances; NULL while a buffer is owned exclusively
+    // and &gCallerOwned while it belongs to the caller
+    std::atomic<int>** gPartialsRefCounts;
+    std::atomic<int>** gTipStatesRefCounts;
+    std::atomic<int>** gTransitionMatricesRefCounts;
+
+    static std::atomic<int> gCallerOwned;
+
     REALTYPE* integrationTmp;
     REALTYPE* firstDerivTmp;
     REALTYPE* secondDerivTmp;
@@ -134,6 +161,13 @@ protected:
     REALTYPE* outFirstDerivativesTmp;
     REALTYPE* outSecondDerivativesTmp;
 
+    // Caller arrays that receive site values in original pattern order as they are
+    // integrated, and the original pattern of each reordered pattern (NULL if not reordered)
+    double* gSiteLogLikelihoodsOutput;
+    double* gSiteFirstDerivativesOutput;
+    double* gSiteSecondDerivativesOutput;
+    int* gSiteOutputOrder;
+
     REALTYPE* ones;
     REALTYPE* zeros;
 
@@ -146,19 +180,66 @@ protected:
         bool stop = false; // When set, this flag tells the thread that it should exit
     };
 
+    // Checkpoint files start with a fixed header followed by a table of
+    // (offset, length) entries, one per buffer in the order produced by
+    // getCheckpointSections(); buffers are stored verbatim in the instance's
+    // native precision and padded layout so the file can be mapped and copied
+    // back without any parsing or conversion.
+    struct checkpointHeader
+    {
+        char magic[8];
+        int version;
+        int realSize;
+        int transPad;
+        int partialsPad;
+        int stateCount;
+        int patternCount;
+        int paddedPatternCount;
+        int categoryCount;
+        int bufferCount;
+        int tipCount;
+        int matrixCount;
+        int eigenDecompCount;
+        int scaleBufferCount;
+        int eigenBufferCount;
+        int partitionCount;
+        int patternsReordered;
+        long long flags;
+        long long sectionCount;
+    };
+
+    struct checkpointEntry
+    {
+        long long offset;
+        long long length;
+    };
+
+    struct checkpointSection
+    {
+        void** slot; // lazily allocated buffers are (re)allocated through this, may be NULL
+        std::atomic<int>** refCount; // copy-on-write reference count of the buffer, may be NULL
+        void* data;
+        size_t length;
+        bool aligned;
+        bool verifyOnly; // must match on load instead of being restored
+    };
+
     int kNumThreads;
     bool kThreadingEnabled;
     bool kAutoPartitioningEnabled;
     bool kAutoRootPartitioningEnabled;
 
     threadData* gThreads;
-    int** gThreadOperations;
-    int* gThreadOpCounts;
+    std::vector<int> gPartitionOperations; // operations grouped by partition, in order within each
+    std::vector<int> gPartitionOpOffsets;
+    std::vector<int> gPartitionOpCursors;
     int* gAutoPartitionOperations;
     int* gAutoPartitionIndices;
     double* gAutoPartitionOutSumLogLikelihoods;
     std::shared_future<void>* gFutures;
 
+    InstanceStatistics gStatistics;
+
 public:
     virtual ~BeagleCPUImpl();
 
@@ -204,6 +285,16 @@ public:
 					int scaleBuffer,
                     double* outPartials);
 
+    int getBufferLayout(BeagleBufferLayout* returnLayout);
+
+    // use a caller-owned buffer, in native precision and padded layout, as partials
+    int setPartialsBuffer(int bufferIndex,
+                          void* inPartials);
+
+    // use a caller-owned buffer of padded pattern length as tip states
+    int setTipStatesBuffer(int tipIndex,
+                           int* inStates);
+
     // sets the Eigen decomposition for a given matrix
     //
     // matrixIndex the matrix index to update
@@ -406,6 +497,22 @@ public:
     int getSiteDerivatives(double* outFirstDerivatives,
                            double* outSecondDerivatives);
 
+    int setSiteLogLikelihoodsOutput(double* outLogLikelihoods,
+                                    double* outFirstDerivatives,
+                                    double* outSecondDerivatives);
+
+    int setStatisticsEnabled(int enabled);
+
+    int getStatistics(BeagleInstanceStatistics* outStatistics);
+
+    int resetStatistics();
+
+    int saveInstance(const char* fileName);
+
+    int loadInstance(const char* fileName);
+
+    int shareBuffers(BeagleImpl* sourceImpl);
+
     int block(void);
 
 	virtual const char* getName();
@@ -622,10 +729,136 @@ protected:
 
     virtual int getPaddedPatternsModulus();
 
+    void storeSiteValue(double* outSiteValues,
+                        int pattern,
+                        REALTYPE value);
+
+    void updateSiteOutputOrder();
+
+    long long getPartialsBytes(long long patternCount);
+
+    long long getMatrixUpdateBytes(const int* firstDerivativeIndices,
+                                   const int* secondDerivativeIndices,
+                                   int count);
+
+    long long getPartitionPatternCount(const int* partitionIndices,
+                                       int partitionCount);
+
+    virtual void getCheckpointSections(std::vector<checkpointSection>& sections);
+
+    void* unshareBuffer(void* buffer,
+                        std::atomic<int>** refCount,
+                        size_t size);
+
+    void releaseBuffer(void* buffer,
+                       std::atomic<int>** refCount);
+
+    void* shareBuffer(void* sourceBuffer,
+                      std::atomic<int>** sourceRefCount,
+                      std::atomic<int>** destRefCount,
+                      size_t size);
+
+    void makePartialsWritable(int bufferIndex);
+
+    void makeMatrixWritable(int matrixIndex);
+
+    void makeMatricesWritable(const int* matrixIndices,
+                              int count);
+
+    void makeOperationsWritable(const int* operations,
+                                int count,
+                                int numOps);
+
+    void fillCheckpointHeader(checkpointHeader* header);
+
     void* mallocAligned(size_t size);
 
+    void waitForThreads();
+
     void threadWaiting(threadData* tData);
 
+    void stopThreads();
+
+    // runs task(0) ... task(taskCount-1) on the instance's threads, each thread taking the
+    // next task as it finishes one
+    void runThreadTasks(int taskCount,
+                        const std::function<void(int)>& task);
+
+    // threads available to the instance: OMP_NUM_THREADS for OpenMP threading, else the hardware's
+    int getHardwareThreadCount();
+
+    int partitionPatterns(int partitionCount,
+                          const int* inPatternPartitions,
+                          int threadCount);
+
+    // thread count for auto-threading from the fixed cut-offs; 1 for none
+    int getDefaultAutoPartitionCount(int threadLimit);
+
+    // measured partition count for this problem shape; measures it if allowed and
+    // not yet known. Returns false if none is available.
+    bool getTunedAutoPartitionCount(bool allowMeasurement,
+                                    int* outPartitionCount);
+
+    // times candidate partition counts on the instance's own, still unused buffers
+    int measureAutoPartitionCount(int hardwareThreads);
+
+    // splits the patterns into blocks for threadCount threads
+    void enableAutoPartitioning(int threadCount);
+
+    void disableAutoPartitioning();
+
+    // bodies of the virtual kernels above, compiled for several instruction sets, see CPUDispatch.h
+    BEAGLE_CPU_MULTIVERSION void calcStatesStatesKernel(REALTYPE* destP,
+                                                        const int* states1,
+                                                        const REALTYPE* matrices1,
+                                                        const int* states2,
+                                                        const REALTYPE* matrices2,
+                                                        int startPattern,
+                                                        int endPattern);
+
+    BEAGLE_CPU_MULTIVERSION void calcStatesStatesFixedScalingKernel(REALTYPE* destP,
+                                                                    const int* child1States,
+                                                                    const REALTYPE* child1TransMat,
+                                                                    const int* child2States,
+                                                                    const REALTYPE* child2TransMat,
+                                                                    const REALTYPE* scaleFactors,
+                                                                    int startPattern,
+                                                                    int endPattern);
+
+    BEAGLE_CPU_MULTIVERSION void calcStatesPartialsKernel(REALTYPE* destP,
+                                                          const int* states1,
+                                                          const REALTYPE* matrices1,
+                                                          const REALTYPE* partials2,
+                                                          const REALTYPE* matrices2,
+                                                          int startPattern,
+                                                          int endPattern);
+
+    BEAGLE_CPU_MULTIVERSION void calcStatesPartialsFixedScalingKernel(REALTYPE* destP,
+                                                                      const int* states1,
+                                                                      const REALTYPE* matrices1,
+                                                                      const REALTYPE* partials2,
+                                                                      const REALTYPE* matrices2,
+                                                                      const REALTYPE* scaleFactors,
+                                                                      int startPattern,
+                                                                      int endPattern);
+
+    BEAGLE_CPU_MULTIVERSION void calcPartialsPartialsKernel(REALTYPE* destP,
+                                                            const REALTYPE* partials1,
+                                                            const REALTYPE* matrices1,
+                                                            const REALTYPE* partials2,
+                                                            const REALTYPE* matrices2,
+                                                            int startPattern,
+                                                            int endPattern);
+
+    BEAGLE_CPU_MULTIVERSION void calcPartialsPartialsFixedScalingKernel(REALTYPE* destP,
+                                                                        const REALTYPE* partials1,
+                                                                        const REALTYPE* matrices1,
+                                                                        const REALTYPE* partials2,
+                                                                        const REALTYPE* matrices2,
+                                                                        const REALTYPE* scaleFactors,
+                                                                        int startPattern,
+                                                                        int endPattern);
+
 };
 
 BEAGLE_CPU_FACTORY_TEMPLATE
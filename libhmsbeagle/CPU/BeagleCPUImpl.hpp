@@ -81,12 +81,23 @@
 #include <vector>
 #include <cfloat>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #include "libhmsbeagle/beagle.h"
 #include "libhmsbeagle/CPU/Precision.h"
 #include "libhmsbeagle/CPU/BeagleCPUImpl.h"
 #include "libhmsbeagle/CPU/EigenDecompositionCube.h"
 #include "libhmsbeagle/CPU/EigenDecompositionSquare.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 namespace beagle {
 namespace cpu {
 
@@ -124,6 +135,9 @@ inline const long getBeagleCPUFlags<float>(){ return BEAGLE_FLAG_COMPUTATION_SYN
 
 
 
+BEAGLE_CPU_TEMPLATE
+std::atomic<int> BeagleCPUImpl<BEAGLE_CPU_GENERIC>::gCallerOwned(0);
+
 BEAGLE_CPU_TEMPLATE
 BeagleCPUImpl<BEAGLE_CPU_GENERIC>::~BeagleCPUImpl() {
     // free all that stuff...
@@ -139,18 +153,21 @@ BeagleCPUImpl<BEAGLE_CPU_GENERIC>::~BeagleCPUImpl() {
 
     for(unsigned int i=0; i<kMatrixCount; i++) {
         if (gTransitionMatrices[i] != NULL)
-            free(gTransitionMatrices[i]);
+            releaseBuffer(gTransitionMatrices[i], &gTransitionMatricesRefCounts[i]);
     }
     free(gTransitionMatrices);
+    free(gTransitionMatricesRefCounts);
 
     for(unsigned int i=0; i<kBufferCount; i++) {
         if (gPartials[i] != NULL)
-            free(gPartials[i]);
+            releaseBuffer(gPartials[i], &gPartialsRefCounts[i]);
         if (gTipStates[i] != NULL)
-            free(gTipStates[i]);
+            releaseBuffer(gTipStates[i], &gTipStatesRefCounts[i]);
     }
     free(gPartials);
     free(gTipStates);
+    free(gPartialsRefCounts);
+    free(gTipStatesRefCounts);
     
     if (kFlags & BEAGLE_FLAG_SCALING_AUTO) {
         for(unsigned int i=0; i<kScaleBufferCount; i++) {
@@ -191,35 +208,15 @@ BeagleCPUImpl<BEAGLE_CPU_GENERIC>::~BeagleCPUImpl() {
     free(outFirstDerivativesTmp);
     free(outSecondDerivativesTmp);
 
+    if (gSiteOutputOrder != NULL)
+        free(gSiteOutputOrder);
+
     free(ones);
     free(zeros);
 
     delete gEigenDecomposition;
 
-    if (kThreadingEnabled) {
-        // Send stop signal to all threads and join them...
-        for (int i = 0; i < kNumThreads; i++) {
-            threadData* td = &gThreads[i];
-            std::unique_lock<std::mutex> l(td->m);
-            td->stop = true;
-            td->cv.notify_one();
-        }
-
-        // Join all the threads
-        for (int i = 0; i < kNumThreads; i++) {
-            threadData* td = &gThreads[i];
-            td->t.join();
-        }
-
-        delete[] gThreads;
-        delete[] gFutures;
-
-        for (int i=0; i<kNumThreads; i++) {
-            free(gThreadOperations[i]);
-        }
-        free(gThreadOperations);
-        free(gThreadOpCounts);
-    }
+    stopThreads();
 
     if (kAutoPartitioningEnabled) {
         free(gAutoPartitionOperations);
@@ -322,6 +319,9 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::createInstance(int tipCount,
 
     if (requirementFlags & BEAGLE_FLAG_THREADING_CPP || preferenceFlags & BEAGLE_FLAG_THREADING_CPP)
         kFlags |= BEAGLE_FLAG_THREADING_CPP;
+    else if ((BEAGLE_CPU_THREADING_FLAGS & BEAGLE_FLAG_THREADING_OPENMP) &&
+             (requirementFlags & BEAGLE_FLAG_THREADING_OPENMP || preferenceFlags & BEAGLE_FLAG_THREADING_OPENMP))
+        kFlags |= BEAGLE_FLAG_THREADING_OPENMP;
     else
         kFlags |= BEAGLE_FLAG_THREADING_NONE;
     
@@ -366,6 +366,12 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::createInstance(int tipCount,
         gTipStates[i] = NULL;
     }
 
+    gPartialsRefCounts = (std::atomic<int>**) calloc(sizeof(std::atomic<int>*), kBufferCount);
+    gTipStatesRefCounts = (std::atomic<int>**) calloc(sizeof(std::atomic<int>*), kBufferCount);
+    gTransitionMatricesRefCounts = (std::atomic<int>**) calloc(sizeof(std::atomic<int>*), kMatrixCount);
+    if (gPartialsRefCounts == NULL || gTipStatesRefCounts == NULL || gTransitionMatricesRefCounts == NULL)
+        throw std::bad_alloc();
+
     for (int i = kTipCount; i < kBufferCount; i++) {
         gPartials[i] = (REALTYPE*) mallocAligned(sizeof(REALTYPE) * kPartialsSize);
         if (gPartials[i] == NULL)
@@ -426,6 +432,11 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::createInstance(int tipCount,
     outFirstDerivativesTmp = (REALTYPE*) malloc(sizeof(REALTYPE) * kPatternCount * kStateCount);
     outSecondDerivativesTmp = (REALTYPE*) malloc(sizeof(REALTYPE) * kPatternCount * kStateCount);
 
+    gSiteLogLikelihoodsOutput = NULL;
+    gSiteFirstDerivativesOutput = NULL;
+    gSiteSecondDerivativesOutput = NULL;
+    gSiteOutputOrder = NULL;
+
     zeros = (REALTYPE*) malloc(sizeof(REALTYPE) * kPaddedPatternCount);
     ones = (REALTYPE*) malloc(sizeof(REALTYPE) * kPaddedPatternCount);
     for(int i = 0; i < kPaddedPatternCount; i++) {
@@ -435,48 +446,21 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::createInstance(int tipCount,
 
     kThreadingEnabled = false;
     kAutoPartitioningEnabled = false;
-    if (kFlags & BEAGLE_FLAG_THREADING_CPP) {
-        int hardwareThreads = std::thread::hardware_concurrency();
-        if (kStateCount <= 4) {
-            kMinPatternCount = BEAGLE_CPU_ASYNC_MIN_PATTERN_COUNT_LOW;
-            if (hardwareThreads < BEAGLE_CPU_ASYNC_HW_THREAD_COUNT_THRESHOLD) {
-                kMinPatternCount = BEAGLE_CPU_ASYNC_MIN_PATTERN_COUNT_HIGH;
-            } else if (kPatternCount < BEAGLE_CPU_ASYNC_LIMIT_PATTERN_COUNT) {
-                hardwareThreads = BEAGLE_CPU_ASYNC_HW_THREAD_COUNT_THRESHOLD;
-            }
-        } else {
-            // todo: assess minimum pattern count for efficient auto-threading
-            //       for higher state-count values
-            kMinPatternCount = 2;
-        }
-        if (kPatternCount >= kMinPatternCount && hardwareThreads > 2) {
-            int partitionCount = kPatternCount/(kMinPatternCount/2);
-            if (partitionCount > hardwareThreads/2) {
-                partitionCount = hardwareThreads/2;
-            } 
-            int* patternPartitions = (int*) malloc(sizeof(int) * kPatternCount);
-            int partitionSize = kPatternCount/partitionCount;
-            for (int i=0; i<kPatternCount; i++) {
-                int sitePartition = i/partitionSize;
-                if (sitePartition > partitionCount - 1)
-                    sitePartition = partitionCount - 1;
-                patternPartitions[i] = sitePartition;
-            }
-            setPatternPartitions(partitionCount, patternPartitions);
-
-            gAutoPartitionOperations = (int*) malloc(sizeof(int) * kBufferCount * kPartitionCount * BEAGLE_PARTITION_OP_COUNT);
-
-            if (kPatternCount >= kMinPatternCount*4) {
-                gAutoPartitionIndices = (int*) malloc(sizeof(int) * partitionCount);
-                for (int i=0; i<partitionCount; i++) {
-                    gAutoPartitionIndices[i] = i;
-                }
-                gAutoPartitionOutSumLogLikelihoods = (double*) malloc(sizeof(double) * partitionCount);
-                kAutoRootPartitioningEnabled = true;
-            }
-
-            kAutoPartitioningEnabled = true;
+    kAutoRootPartitioningEnabled = false;
+    if (kFlags & (BEAGLE_FLAG_THREADING_CPP | BEAGLE_FLAG_THREADING_OPENMP)) {
+        int hardwareThreads = getHardwareThreadCount();
+        int threadLimit = hardwareThreads/2;
+        if (kStateCount <= 4 &&
+            hardwareThreads >= BEAGLE_CPU_ASYNC_HW_THREAD_COUNT_THRESHOLD &&
+            kPatternCount < BEAGLE_CPU_ASYNC_LIMIT_PATTERN_COUNT) {
+            threadLimit = BEAGLE_CPU_ASYNC_HW_THREAD_COUNT_THRESHOLD/2;
         }
+        int partitionCount = getDefaultAutoPartitionCount(threadLimit);
+        int tunedPartitionCount;
+        if (getTunedAutoPartitionCount(true, &tunedPartitionCount))
+            partitionCount = tunedPartitionCount;
+        if (partitionCount > 1)
+            enableAutoPartitioning(partitionCount);
     }
 
     return BEAGLE_SUCCESS;
@@ -511,49 +495,14 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::setCPUThreadCount(int threadCount) {
     if (threadCount < 1)
         return BEAGLE_ERROR_OUT_OF_RANGE;
 
-    kThreadingEnabled = false;
-    kAutoPartitioningEnabled = false;
-    if (kFlags & BEAGLE_FLAG_THREADING_CPP) {
-        int hardwareThreads = std::thread::hardware_concurrency();
-        if (kStateCount <= 4) {
-            kMinPatternCount = BEAGLE_CPU_ASYNC_MIN_PATTERN_COUNT_LOW;
-            if (hardwareThreads < BEAGLE_CPU_ASYNC_HW_THREAD_COUNT_THRESHOLD) {
-                kMinPatternCount = BEAGLE_CPU_ASYNC_MIN_PATTERN_COUNT_HIGH;
-            }
-        } else {
-            // todo: assess minimum pattern count for efficient auto-threading
-            //       for higher state-count values
-            kMinPatternCount = 2;
-        }
-        if (kPatternCount >= kMinPatternCount && hardwareThreads > 2) {
-            int partitionCount = kPatternCount/(kMinPatternCount/2);
-            if (partitionCount > threadCount) {
-                partitionCount = threadCount;
-            } 
-
-            int* patternPartitions = (int*) malloc(sizeof(int) * kPatternCount);
-            int partitionSize = kPatternCount/partitionCount;
-            for (int i=0; i<kPatternCount; i++) {
-                int sitePartition = i/partitionSize;
-                if (sitePartition > partitionCount - 1)
-                    sitePartition = partitionCount - 1;
-                patternPartitions[i] = sitePartition;
-            }
-            setPatternPartitions(partitionCount, patternPartitions);
-
-            gAutoPartitionOperations = (int*) malloc(sizeof(int) * kBufferCount * kPartitionCount * BEAGLE_PARTITION_OP_COUNT);
-
-            if (kPatternCount >= kMinPatternCount*4) {
-                gAutoPartitionIndices = (int*) malloc(sizeof(int) * partitionCount);
-                for (int i=0; i<partitionCount; i++) {
-                    gAutoPartitionIndices[i] = i;
-                }
-                gAutoPartitionOutSumLogLikelihoods = (double*) malloc(sizeof(double) * partitionCount);
-                kAutoRootPartitioningEnabled = true;
-            }
-
-            kAutoPartitioningEnabled = true;
-        }
+    disableAutoPartitioning();
+    if (kFlags & (BEAGLE_FLAG_THREADING_CPP | BEAGLE_FLAG_THREADING_OPENMP)) {
+        int partitionCount = getDefaultAutoPartitionCount(threadCount);
+        int tunedPartitionCount;
+        if (getTunedAutoPartitionCount(false, &tunedPartitionCount))
+            partitionCount = (tunedPartitionCount < threadCount ? tunedPartitionCount : threadCount);
+        if (partitionCount > 1)
+            enableAutoPartitioning(partitionCount);
     }
 
     return BEAGLE_SUCCESS;
@@ -564,7 +513,12 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::setTipStates(int tipIndex,
                                 const int* inStates) {
     if (tipIndex < 0 || tipIndex >= kTipCount)
         return BEAGLE_ERROR_OUT_OF_RANGE;
-    gTipStates[tipIndex] = (int*) mallocAligned(sizeof(int) * kPaddedPatternCount);
+    if (gTipStates[tipIndex] != NULL && gTipStatesRefCounts[tipIndex] != NULL) {
+        releaseBuffer(gTipStates[tipIndex], &gTipStatesRefCounts[tipIndex]);
+        gTipStates[tipIndex] = NULL;
+    }
+    if (gTipStates[tipIndex] == NULL)
+        gTipStates[tipIndex] = (int*) mallocAligned(sizeof(int) * kPaddedPatternCount);
     // TODO: What if this throws a memory full error?
     for (int j = 0; j < kPatternCount; j++) {
         gTipStates[tipIndex][j] = (inStates[j] < kStateCount ? inStates[j] : kStateCount);
@@ -586,6 +540,8 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::setTipPartials(int tipIndex,
         // TODO: What if this throws a memory full error?
         if (gPartials[tipIndex] == 0L)
             return BEAGLE_ERROR_OUT_OF_MEMORY;
+    } else {
+        makePartialsWritable(tipIndex);
     }
 
     const double* inPartialsOffset;
@@ -619,6 +575,8 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::setPartials(int bufferIndex,
         gPartials[bufferIndex] = (REALTYPE*) malloc(sizeof(REALTYPE) * kPartialsSize);
         if (gPartials[bufferIndex] == 0L)
             return BEAGLE_ERROR_OUT_OF_MEMORY;
+    } else {
+        makePartialsWritable(bufferIndex);
     }
     
     const double* inPartialsOffset = inPartials;
@@ -690,6 +648,53 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::getPartials(int bufferIndex,
     return BEAGLE_SUCCESS;
 }
 
+BEAGLE_CPU_TEMPLATE
+int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::getBufferLayout(BeagleBufferLayout* returnLayout) {
+    returnLayout->elementSize = sizeof(REALTYPE);
+    returnLayout->stateCount = kStateCount;
+    returnLayout->paddedStateCount = kPartialsPaddedStateCount;
+    returnLayout->patternCount = kPatternCount;
+    returnLayout->paddedPatternCount = kPaddedPatternCount;
+    returnLayout->categoryCount = kCategoryCount;
+    returnLayout->partialsLength = kPartialsSize;
+    returnLayout->tipStatesLength = kPaddedPatternCount;
+    returnLayout->alignment = BEAGLE_CPU_BUFFER_ALIGNMENT;
+
+    return BEAGLE_SUCCESS;
+}
+
+BEAGLE_CPU_TEMPLATE
+int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::setPartialsBuffer(int bufferIndex,
+                                                        void* inPartials) {
+    if (bufferIndex < 0 || bufferIndex >= kBufferCount)
+        return BEAGLE_ERROR_OUT_OF_RANGE;
+    if (inPartials == NULL || ((size_t) inPartials) % BEAGLE_CPU_BUFFER_ALIGNMENT != 0)
+        return BEAGLE_ERROR_GENERAL;
+
+    if (gPartials[bufferIndex] != NULL)
+        releaseBuffer(gPartials[bufferIndex], &gPartialsRefCounts[bufferIndex]);
+    gPartials[bufferIndex] = (REALTYPE*) inPartials;
+    gPartialsRefCounts[bufferIndex] = &gCallerOwned;
+
+    return BEAGLE_SUCCESS;
+}
+
+BEAGLE_CPU_TEMPLATE
+int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::setTipStatesBuffer(int tipIndex,
+                                                         int* inStates) {
+    if (tipIndex < 0 || tipIndex >= kTipCount)
+        return BEAGLE_ERROR_OUT_OF_RANGE;
+    if (inStates == NULL || ((size_t) inStates) % BEAGLE_CPU_BUFFER_ALIGNMENT != 0)
+        return BEAGLE_ERROR_GENERAL;
+
+    if (gTipStates[tipIndex] != NULL)
+        releaseBuffer(gTipStates[tipIndex], &gTipStatesRefCounts[tipIndex]);
+    gTipStates[tipIndex] = inStates;
+    gTipStatesRefCounts[tipIndex] = &gCallerOwned;
+
+    return BEAGLE_SUCCESS;
+}
+
 BEAGLE_CPU_TEMPLATE
 int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::setEigenDecomposition(int eigenIndex,
                                          const double* inEigenVectors,
@@ -736,6 +741,18 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::setPatternWeights(const double* inPattern
 BEAGLE_CPU_TEMPLATE
 int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::setPatternPartitions(int partitionCount,
                                                             const int* inPatternPartitions) {
+    int hardwareThreads = getHardwareThreadCount();
+    int threadCount = (partitionCount < hardwareThreads ? partitionCount : hardwareThreads);
+    if (threadCount < 1)
+        threadCount = 1;
+
+    return partitionPatterns(partitionCount, inPatternPartitions, threadCount);
+}
+
+BEAGLE_CPU_TEMPLATE
+int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::partitionPatterns(int partitionCount,
+                                                         const int* inPatternPartitions,
+                                                         int threadCount) {
     
     int returnCode = BEAGLE_SUCCESS;
 
@@ -770,35 +787,10 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::setPatternPartitions(int partitionCount,
         kMaxPartitionCount = partitionCount;
     }
 
-    if (kThreadingEnabled) {
-        // Send stop signal to all threads and join them...
-        for (int i = 0; i < kNumThreads; i++) {
-            threadData* td = &gThreads[i];
-            std::unique_lock<std::mutex> l(td->m);
-            td->stop = true;
-            td->cv.notify_one();
-        }
-
-        // Join all the threads
-        for (int i = 0; i < kNumThreads; i++) {
-            threadData* td = &gThreads[i];
-            td->t.join();
-        }
-
-        delete[] gThreads;
-        delete[] gFutures;
-
-        for (int i=0; i<kNumThreads; i++) {
-            free(gThreadOperations[i]);
-        }
-        free(gThreadOperations);
-        free(gThreadOpCounts);
-
-        kThreadingEnabled = false;
-    }
+    stopThreads();
 
     if (kFlags & BEAGLE_FLAG_THREADING_CPP) {
-        kNumThreads = partitionCount;
+        kNumThreads = threadCount;
 
         gThreads = new threadData[kNumThreads];
         for (int i = 0; i < kNumThreads; i++) {
@@ -809,14 +801,17 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::setPatternPartitions(int partitionCount,
         if (gFutures == NULL)
             throw std::bad_alloc();
 
-        gThreadOperations = (int**) malloc(sizeof(int*) * kNumThreads);
-        for (int i=0; i<kNumThreads; i++) {
-            gThreadOperations[i] = (int*) malloc(sizeof(int) * BEAGLE_PARTITION_OP_COUNT * kBufferCount * partitionCount);
-        }
-
-        gThreadOpCounts = (int*) malloc(sizeof(int) * kNumThreads);
-
         kThreadingEnabled = true;
+    } else if (kFlags & BEAGLE_FLAG_THREADING_OPENMP) {
+        // OpenMP keeps its own thread pool
+        kNumThreads = threadCount;
+        kThreadingEnabled = true;
+    }
+
+    if (kThreadingEnabled) {
+        gPartitionOperations.reserve(BEAGLE_PARTITION_OP_COUNT * kBufferCount * partitionCount);
+        gPartitionOpOffsets.resize(partitionCount + 1);
+        gPartitionOpCursors.resize(partitionCount);
     }
 
 
@@ -965,12 +960,303 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::getSiteDerivatives(double* outFirstDeriva
     return BEAGLE_SUCCESS;
 }
 
+BEAGLE_CPU_TEMPLATE
+int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::setSiteLogLikelihoodsOutput(double* outLogLikelihoods,
+                                                                  double* outFirstDerivatives,
+                                                                  double* outSecondDerivatives) {
+    gSiteLogLikelihoodsOutput = outLogLikelihoods;
+    gSiteFirstDerivativesOutput = outFirstDerivatives;
+    gSiteSecondDerivativesOutput = outSecondDerivatives;
+
+    updateSiteOutputOrder();
+
+    return BEAGLE_SUCCESS;
+}
+
+BEAGLE_CPU_TEMPLATE
+int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::setStatisticsEnabled(int enabled) {
+    gStatistics.setEnabled(enabled != 0);
+
+    return BEAGLE_SUCCESS;
+}
+
+BEAGLE_CPU_TEMPLATE
+int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::getStatistics(BeagleInstanceStatistics* outStatistics) {
+    if (outStatistics == NULL)
+        return BEAGLE_ERROR_OUT_OF_RANGE;
+
+    gStatistics.get(outStatistics);
+
+    return BEAGLE_SUCCESS;
+}
+
+BEAGLE_CPU_TEMPLATE
+int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::resetStatistics() {
+    gStatistics.reset();
+
+    return BEAGLE_SUCCESS;
+}
+
+BEAGLE_CPU_TEMPLATE
+int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::saveInstance(const char* fileName) {
+    std::vector<checkpointSection> sections;
+    getCheckpointSections(sections);
+
+    checkpointHeader header;
+    fillCheckpointHeader(&header);
+    header.sectionCount = sections.size();
+
+    std::vector<checkpointEntry> entries(sections.size());
+    long long offset = sizeof(checkpointHeader) + sizeof(checkpointEntry) * sections.size();
+    for (size_t i = 0; i < sections.size(); i++) {
+        offset += (BEAGLE_CPU_CHECKPOINT_ALIGNMENT - offset % BEAGLE_CPU_CHECKPOINT_ALIGNMENT) % BEAGLE_CPU_CHECKPOINT_ALIGNMENT;
+        if (sections[i].data != NULL && sections[i].length > 0) {
+            entries[i].offset = offset;
+            entries[i].length = sections[i].length;
+            offset += sections[i].length;
+        } else {
+            entries[i].offset = 0;
+            entries[i].length = 0;
+        }
+    }
+
+    FILE* file = fopen(fileName, "wb");
+    if (file == NULL)
+        return BEAGLE_ERROR_GENERAL;
+
+    bool written = (fwrite(&header, sizeof(checkpointHeader), 1, file) == 1);
+    if (written && !entries.empty())
+        written = (fwrite(&entries[0], sizeof(checkpointEntry), entries.size(), file) == entries.size());
+
+    const char padding[BEAGLE_CPU_CHECKPOINT_ALIGNMENT] = {0};
+    long long position = sizeof(checkpointHeader) + sizeof(checkpointEntry) * sections.size();
+    for (size_t i = 0; written && i < sections.size(); i++) {
+        if (entries[i].length == 0)
+            continue;
+        if (entries[i].offset > position)
+            written = (fwrite(padding, 1, entries[i].offset - position, file) == (size_t) (entries[i].offset - position));
+        if (written)
+            written = (fwrite(sections[i].data, 1, sections[i].length, file) == sections[i].length);
+        position = entries[i].offset + entries[i].length;
+    }
+
+    if (fclose(file) != 0)
+        written = false;
+
+    return (written ? BEAGLE_SUCCESS : BEAGLE_ERROR_GENERAL);
+}
+
+BEAGLE_CPU_TEMPLATE
+int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::loadInstance(const char* fileName) {
+    size_t fileSize = 0;
+    char* fileData = NULL;
+
+#ifdef _WIN32
+    FILE* file = fopen(fileName, "rb");
+    if (file == NULL)
+        return BEAGLE_ERROR_GENERAL;
+    fseek(file, 0, SEEK_END);
+    fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    fileData = (char*) malloc(fileSize);
+    if (fileData == NULL) {
+        fclose(file);
+        return BEAGLE_ERROR_OUT_OF_MEMORY;
+    }
+    size_t readSize = fread(fileData, 1, fileSize, file);
+    fclose(file);
+    if (readSize != fileSize) {
+        free(fileData);
+        return BEAGLE_ERROR_GENERAL;
+    }
+#else
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0)
+        return BEAGLE_ERROR_GENERAL;
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size < (off_t) sizeof(checkpointHeader)) {
+        close(fd);
+        return BEAGLE_ERROR_GENERAL;
+    }
+    fileSize = fileStat.st_size;
+    void* mapped = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return BEAGLE_ERROR_GENERAL;
+    fileData = (char*) mapped;
+#endif
+
+    std::vector<checkpointSection> sections;
+    getCheckpointSections(sections);
+
+    checkpointHeader expected;
+    fillCheckpointHeader(&expected);
+    expected.sectionCount = sections.size();
+
+    int returnCode = BEAGLE_SUCCESS;
+
+    const checkpointEntry* entries = NULL;
+    if (fileSize < sizeof(checkpointHeader) + sizeof(checkpointEntry) * sections.size() ||
+        memcmp(fileData, &expected, sizeof(checkpointHeader)) != 0) {
+        returnCode = BEAGLE_ERROR_GENERAL;
+    } else {
+        entries = (const checkpointEntry*) (fileData + sizeof(checkpointHeader));
+        for (size_t i = 0; i < sections.size() && returnCode == BEAGLE_SUCCESS; i++) {
+            if (entries[i].length == 0) {
+                if (sections[i].verifyOnly && sections[i].data != NULL)
+                    returnCode = BEAGLE_ERROR_GENERAL;
+            } else if (entries[i].length != (long long) sections[i].length ||
+                       entries[i].offset < 0 ||
+                       entries[i].offset + entries[i].length > (long long) fileSize) {
+                returnCode = BEAGLE_ERROR_GENERAL;
+            } else if (sections[i].verifyOnly &&
+                       (sections[i].data == NULL ||
+                        memcmp(sections[i].data, fileData + entries[i].offset, sections[i].length) != 0)) {
+                returnCode = BEAGLE_ERROR_GENERAL;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < sections.size() && returnCode == BEAGLE_SUCCESS; i++) {
+        checkpointSection& section = sections[i];
+        if (section.verifyOnly)
+            continue;
+        if (entries[i].length == 0) {
+            if (section.slot != NULL && *section.slot != NULL) {
+                if (section.refCount != NULL)
+                    releaseBuffer(*section.slot, section.refCount);
+                else
+                    free(*section.slot);
+                *section.slot = NULL;
+            }
+            continue;
+        }
+        if (section.refCount != NULL && *section.refCount != NULL) {
+            releaseBuffer(*section.slot, section.refCount);
+            *section.slot = NULL;
+        }
+        if (section.slot != NULL && *section.slot == NULL) {
+            *section.slot = (section.aligned ? mallocAligned(section.length) : malloc(section.length));
+            if (*section.slot == NULL) {
+                returnCode = BEAGLE_ERROR_OUT_OF_MEMORY;
+                break;
+            }
+            section.data = *section.slot;
+        }
+        memcpy(section.data, fileData + entries[i].offset, section.length);
+    }
+
+#ifdef _WIN32
+    free(fileData);
+#else
+    munmap(fileData, fileSize);
+#endif
+
+    return returnCode;
+}
+
+BEAGLE_CPU_TEMPLATE
+int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::shareBuffers(BeagleImpl* sourceImpl) {
+    BeagleCPUImpl<BEAGLE_CPU_GENERIC>* source = dynamic_cast<BeagleCPUImpl<BEAGLE_CPU_GENERIC>*>(sourceImpl);
+    if (source == NULL)
+        return BEAGLE_ERROR_NO_IMPLEMENTATION;
+
+    if (source->kBufferCount != kBufferCount || source->kTipCount != kTipCount ||
+        source->kStateCount != kStateCount || source->kPatternCount != kPatternCount ||
+        source->kCategoryCount != kCategoryCount || source->kMatrixCount != kMatrixCount ||
+        source->kEigenDecompCount != kEigenDecompCount || source->kScaleBufferCount != kScaleBufferCount ||
+        source->kFlags != kFlags)
+        return BEAGLE_ERROR_GENERAL;
+
+    // partitions first, as setting them may reorder tip data
+    if (source->kPartitionsInitialised) {
+        int returnCode = setPatternPartitions(source->kPartitionCount, source->gPatternPartitions);
+        if (returnCode != BEAGLE_SUCCESS)
+            return returnCode;
+        if (source->kPatternsReordered) {
+            gPatternsNewOrder = (int*) malloc(sizeof(int) * kPatternCount);
+            if (gPatternsNewOrder == NULL)
+                throw std::bad_alloc();
+            memcpy(gPatternsNewOrder, source->gPatternsNewOrder, sizeof(int) * kPatternCount);
+            kPatternsReordered = true;
+        }
+    }
+    memcpy(gPatternWeights, source->gPatternWeights, sizeof(double) * kPatternCount);
+
+    for (int i = 0; i < kBufferCount; i++) {
+        if (gPartials[i] != NULL)
+            releaseBuffer(gPartials[i], &gPartialsRefCounts[i]);
+        gPartials[i] = NULL;
+        if (source->gPartials[i] != NULL)
+            gPartials[i] = (REALTYPE*) shareBuffer(source->gPartials[i],
+                                                   &source->gPartialsRefCounts[i],
+                                                   &gPartialsRefCounts[i],
+                                                   sizeof(REALTYPE) * kPartialsSize);
+
+        if (gTipStates[i] != NULL)
+            releaseBuffer(gTipStates[i], &gTipStatesRefCounts[i]);
+        gTipStates[i] = NULL;
+        if (source->gTipStates[i] != NULL)
+            gTipStates[i] = (int*) shareBuffer(source->gTipStates[i],
+                                               &source->gTipStatesRefCounts[i],
+                                               &gTipStatesRefCounts[i],
+                                               sizeof(int) * kPaddedPatternCount);
+    }
+
+    for (int i = 0; i < kMatrixCount; i++) {
+        releaseBuffer(gTransitionMatrices[i], &gTransitionMatricesRefCounts[i]);
+        gTransitionMatrices[i] = (REALTYPE*) shareBuffer(source->gTransitionMatrices[i],
+                                                         &source->gTransitionMatricesRefCounts[i],
+                                                         &gTransitionMatricesRefCounts[i],
+                                                         sizeof(REALTYPE) * kMatrixSize * kCategoryCount);
+    }
+
+    // scale factors and model parameters are small and are copied outright
+    if (kFlags & BEAGLE_FLAG_SCALING_AUTO) {
+        for (int i = 0; i < kScaleBufferCount; i++)
+            memcpy(gAutoScaleBuffers[i], source->gAutoScaleBuffers[i], sizeof(signed short) * kPaddedPatternCount);
+        memcpy(gActiveScalingFactors, source->gActiveScalingFactors, sizeof(int) * kInternalPartialsBufferCount);
+        memcpy(gScaleBuffers[0], source->gScaleBuffers[0], sizeof(REALTYPE) * kPaddedPatternCount);
+    } else {
+        for (int i = 0; i < kScaleBufferCount; i++)
+            memcpy(gScaleBuffers[i], source->gScaleBuffers[i], sizeof(REALTYPE) * kPaddedPatternCount);
+    }
+
+    int eigenBufferCount = gEigenDecomposition->getBufferCount();
+    for (int i = 0; i < kEigenDecompCount; i++) {
+        for (int j = 0; j < eigenBufferCount; j++) {
+            int length;
+            REALTYPE* buffer = gEigenDecomposition->getBuffer(i, j, &length);
+            memcpy(buffer, source->gEigenDecomposition->getBuffer(i, j, &length), sizeof(REALTYPE) * length);
+        }
+    }
+
+    for (int i = 0; i < kEigenDecompCount; i++) {
+        if (source->gCategoryRates[i] != NULL)
+            setCategoryRatesWithIndex(i, source->gCategoryRates[i]);
+        if (source->gCategoryWeights[i] != NULL) {
+            if (gCategoryWeights[i] == NULL)
+                gCategoryWeights[i] = (REALTYPE*) malloc(sizeof(REALTYPE) * kCategoryCount);
+            memcpy(gCategoryWeights[i], source->gCategoryWeights[i], sizeof(REALTYPE) * kCategoryCount);
+        }
+        if (source->gStateFrequencies[i] != NULL) {
+            if (gStateFrequencies[i] == NULL)
+                gStateFrequencies[i] = (REALTYPE*) malloc(sizeof(REALTYPE) * kStateCount);
+            memcpy(gStateFrequencies[i], source->gStateFrequencies[i], sizeof(REALTYPE) * kStateCount);
+        }
+    }
+
+    return BEAGLE_SUCCESS;
+}
+
 
 BEAGLE_CPU_TEMPLATE
 int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::setTransitionMatrix(int matrixIndex,
                                        const double* inMatrix,
                                        double paddedValue) {
 
+    makeMatrixWritable(matrixIndex);
+
 if (T_PAD != 0) {
     const double* offsetInMatrix = inMatrix;
     REALTYPE* offsetBeagleMatrix = gTransitionMatrices[matrixIndex];
@@ -994,6 +1280,8 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::setTransitionMatrices(const int* matrixIn
                                                              const double* inMatrices,
                                                              const double* paddedValues,
                                                              int count) {
+    makeMatricesWritable(matrixIndices, count);
+
     for (int k = 0; k < count; k++) {
         const double* inMatrix = inMatrices + k*kStateCount*kStateCount*kCategoryCount;
         int matrixIndex = matrixIndices[k];
@@ -1049,6 +1337,8 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::convolveTransitionMatrices(const int* fir
 
         }//END: overwrite check
 
+        makeMatrixWritable(resultIndices[u]);
+
         REALTYPE* C = gTransitionMatrices[resultIndices[u]];
         REALTYPE* A = gTransitionMatrices[firstIndices[u]];
         REALTYPE* B = gTransitionMatrices[secondIndices[u]];
@@ -1139,6 +1429,14 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::updateTransitionMatrices(int eigenIndex,
     //     printf("uTM %d %d %f %d\n", eigenIndex, probabilityIndices[i], edgeLengths[i], 0);
     // }
 
+    makeMatricesWritable(probabilityIndices, count);
+    makeMatricesWritable(firstDerivativeIndices, count);
+    makeMatricesWritable(secondDerivativeIndices, count);
+
+    ScopedKernelTimer timer(gStatistics, traceRecorder, traceInstance,
+                            BEAGLE_STATISTICS_MATRIX_UPDATE, 0,
+                            getMatrixUpdateBytes(firstDerivativeIndices, secondDerivativeIndices, count));
+
     gEigenDecomposition->updateTransitionMatrices(eigenIndex,probabilityIndices,firstDerivativeIndices,secondDerivativeIndices,
                                                   edgeLengths,gCategoryRates[0],gTransitionMatrices,count);
     return BEAGLE_SUCCESS;
@@ -1153,6 +1451,14 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::updateTransitionMatricesWithModelCategori
                                             const double* edgeLengths,
                                             int count) {
 
+    makeMatricesWritable(probabilityIndices, count);
+    makeMatricesWritable(firstDerivativeIndices, count);
+    makeMatricesWritable(secondDerivativeIndices, count);
+
+    ScopedKernelTimer timer(gStatistics, traceRecorder, traceInstance,
+                            BEAGLE_STATISTICS_MATRIX_UPDATE, 0,
+                            getMatrixUpdateBytes(firstDerivativeIndices, secondDerivativeIndices, count));
+
     gEigenDecomposition->updateTransitionMatricesWithModelCategories(eigenIndices,probabilityIndices,firstDerivativeIndices,secondDerivativeIndices,
                                                   edgeLengths,gTransitionMatrices,count);
     return BEAGLE_SUCCESS;
@@ -1168,6 +1474,14 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::updateTransitionMatricesWithMultipleModel
                                                                                   const double* edgeLengths,
                                                                                   int count) {
 
+    makeMatricesWritable(probabilityIndices, count);
+    makeMatricesWritable(firstDerivativeIndices, count);
+    makeMatricesWritable(secondDerivativeIndices, count);
+
+    ScopedKernelTimer timer(gStatistics, traceRecorder, traceInstance,
+                            BEAGLE_STATISTICS_MATRIX_UPDATE, 0,
+                            getMatrixUpdateBytes(firstDerivativeIndices, secondDerivativeIndices, count));
+
     // TODO: move loop to within gEigenDecomposition
 
     for (int i = 0; i < count; i++) {
@@ -1203,6 +1517,8 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::updatePartials(const int* operations,
 
     int returnCode = BEAGLE_ERROR_GENERAL;
 
+    makeOperationsWritable(operations, count, BEAGLE_OP_COUNT);
+
     if (kAutoPartitioningEnabled) {
         autoPartitionPartialsOperations(operations,
                                         gAutoPartitionOperations,
@@ -1229,6 +1545,8 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::updatePartialsByPartition(const int* oper
     
     int returnCode = BEAGLE_ERROR_GENERAL;
 
+    makeOperationsWritable(operations, count, BEAGLE_PARTITION_OP_COUNT);
+
     if (kThreadingEnabled) {
         returnCode = upPartialsByPartitionAsync(operations,
                                                 count);            
@@ -1269,37 +1587,33 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::upPartialsByPartitionAsync(const int* ope
 
     int numOps = BEAGLE_PARTITION_OP_COUNT;
 
-    memset(gThreadOpCounts, 0, sizeof(int) * kNumThreads);
+    // partitions are independent, so each runs its own operations in order on whichever
+    // thread takes it
+    std::fill(gPartitionOpOffsets.begin(), gPartitionOpOffsets.end(), 0);
+    for (int i=0; i<count; i++) {
+        int partition = operations[i * numOps + 7];
+        if (partition < 0 || partition >= kPartitionCount)
+            return BEAGLE_ERROR_OUT_OF_RANGE;
+        gPartitionOpOffsets[partition + 1]++;
+    }
+    for (int p=0; p<kPartitionCount; p++) {
+        gPartitionOpOffsets[p + 1] += gPartitionOpOffsets[p];
+        gPartitionOpCursors[p] = gPartitionOpOffsets[p];
+    }
 
+    gPartitionOperations.resize(count * numOps);
     for (int i=0; i<count; i++) {
-        int t = operations[i * numOps + 7] % kNumThreads;
+        int k = gPartitionOpCursors[operations[i * numOps + 7]]++;
         for (int j=0; j<numOps; j++) {
-            gThreadOperations[t][gThreadOpCounts[t]*numOps + j] = operations[i*numOps + j];
+            gPartitionOperations[k*numOps + j] = operations[i*numOps + j];
         }
-        gThreadOpCounts[t]++;
     }
 
-    for (int i=0; i<kNumThreads; i++) {
-        std::packaged_task<void()> threadTask(
-            std::bind(&BeagleCPUImpl<BEAGLE_CPU_GENERIC>::upPartials, this,
-                      true,
-                      (const int*) gThreadOperations[i],
-                      gThreadOpCounts[i],
-                      BEAGLE_OP_NONE));
-
-        gFutures[i] = threadTask.get_future();
-        threadData* td = &gThreads[i];
-
-        std::unique_lock<std::mutex> l(td->m);
-        td->jobs.push(std::move(threadTask));
-        l.unlock();
-
-        gThreads[i].cv.notify_one();
-    }
-
-    for (int i=0; i<kNumThreads; i++) {
-        gFutures[i].wait();
-    }
+    runThreadTasks(kPartitionCount, [this, numOps] (int p) {
+        int opCount = gPartitionOpOffsets[p + 1] - gPartitionOpOffsets[p];
+        if (opCount > 0)
+            upPartials(true, &gPartitionOperations[gPartitionOpOffsets[p] * numOps], opCount, BEAGLE_OP_NONE);
+    });
 
     return BEAGLE_SUCCESS;
 }
@@ -1392,6 +1706,16 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::upPartials(bool byPartition,
                      << " readIndex = " << readScalingIndex << "\n";
         }
 
+        int kernel = BEAGLE_STATISTICS_PARTIALS_PARTIALS;
+        if (tipStates1 != NULL && tipStates2 != NULL)
+            kernel = BEAGLE_STATISTICS_STATES_STATES;
+        else if (tipStates1 != NULL || tipStates2 != NULL)
+            kernel = BEAGLE_STATISTICS_STATES_PARTIALS;
+
+        bool recordStatistics = gStatistics.isEnabled();
+        double kernelStartTime = (recordStatistics ? InstanceStatistics::getTime() : 0.0);
+        long long traceStartTime = (traceRecorder != NULL ? traceRecorder->getTime() : 0);
+
         if (tipStates1 != NULL) {
             if (tipStates2 != NULL ) {
                 if (rescale == 0) { // Use fixed scaleFactors
@@ -1401,13 +1725,6 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::upPartials(bool byPartition,
                     // First compute without any scaling
                     calcStatesStates(destPartials, tipStates1, matrices1, tipStates2, matrices2,
                                      startPattern, endPattern);
-                    if (rescale == 1) { // Recompute scaleFactors
-                        if (byPartition) {
-                            rescalePartialsByPartition(destPartials,scalingFactors,cumulativeScaleBuffer,0, currentPartition);
-                        } else {
-                            rescalePartials(destPartials,scalingFactors,cumulativeScaleBuffer,0);
-                        }
-                    }
                 }
             } else {
                 if (rescale == 0) {
@@ -1416,13 +1733,6 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::upPartials(bool byPartition,
                 } else {
                     calcStatesPartials(destPartials, tipStates1, matrices1, partials2, matrices2,
                                        startPattern, endPattern);
-                    if (rescale == 1) { // Recompute scaleFactors
-                        if (byPartition) {
-                            rescalePartialsByPartition(destPartials,scalingFactors,cumulativeScaleBuffer,0, currentPartition);
-                        } else {
-                            rescalePartials(destPartials,scalingFactors,cumulativeScaleBuffer,0);
-                        }
-                    }
                 }
             }
         } else {
@@ -1433,13 +1743,6 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::upPartials(bool byPartition,
                 } else {
                     calcStatesPartials(destPartials, tipStates2, matrices2, partials1, matrices1,
                                        startPattern, endPattern);
-                    if (rescale == 1) {// Recompute scaleFactors
-                        if (byPartition) {
-                            rescalePartialsByPartition(destPartials,scalingFactors,cumulativeScaleBuffer,0, currentPartition);
-                        } else {
-                            rescalePartials(destPartials,scalingFactors,cumulativeScaleBuffer,0);
-                        }
-                    }
                 }
             } else {
                 if (rescale == 2) {
@@ -1455,16 +1758,41 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::upPartials(bool byPartition,
                 } else {
                     calcPartialsPartials(destPartials, partials1, matrices1, partials2, matrices2,
                                          startPattern, endPattern);
-                    if (rescale == 1) {// Recompute scaleFactors
-                        if (byPartition) {
-                            rescalePartialsByPartition(destPartials,scalingFactors,cumulativeScaleBuffer,0, currentPartition);
-                        } else {
-                            rescalePartials(destPartials,scalingFactors,cumulativeScaleBuffer,0);
-                        }
-                    }
                 }
             }
         }
+
+        if (traceRecorder != NULL)
+            traceRecorder->record(getKernelName(kernel), "kernel", traceStartTime, traceInstance,
+                                  (byPartition ? currentPartition : -1), op);
+
+        if (recordStatistics) {
+            double kernelEndTime = InstanceStatistics::getTime();
+            long long patternCount = endPattern - startPattern;
+            long long partialsBytes = patternCount * kCategoryCount * kPartialsPaddedStateCount * sizeof(REALTYPE);
+            long long childBytes = 2 * (long long) kMatrixSize * kCategoryCount * sizeof(REALTYPE);
+            childBytes += (tipStates1 != NULL ? patternCount * sizeof(int) : partialsBytes);
+            childBytes += (tipStates2 != NULL ? patternCount * sizeof(int) : partialsBytes);
+            gStatistics.addKernel(kernel, kernelEndTime - kernelStartTime, patternCount,
+                                  partialsBytes + childBytes);
+        }
+
+        if (rescale == 1) { // Recompute scaleFactors
+            TraceScope rescaleTrace(traceRecorder, getKernelName(BEAGLE_STATISTICS_RESCALE), "kernel",
+                                    traceInstance, (byPartition ? currentPartition : -1), op);
+            double rescaleStartTime = (recordStatistics ? InstanceStatistics::getTime() : 0.0);
+            if (byPartition) {
+                rescalePartialsByPartition(destPartials,scalingFactors,cumulativeScaleBuffer,0, currentPartition);
+            } else {
+                rescalePartials(destPartials,scalingFactors,cumulativeScaleBuffer,0);
+            }
+            if (recordStatistics) {
+                long long patternCount = endPattern - startPattern;
+                long long partialsBytes = patternCount * kCategoryCount * kPartialsPaddedStateCount * sizeof(REALTYPE);
+                gStatistics.addKernel(BEAGLE_STATISTICS_RESCALE, InstanceStatistics::getTime() - rescaleStartTime,
+                                      patternCount, 2 * partialsBytes + patternCount * sizeof(REALTYPE));
+            }
+        }
         
         if (kFlags & BEAGLE_FLAG_SCALING_ALWAYS) {
             int parScalingIndex = parIndex - kTipCount;
@@ -1511,6 +1839,10 @@ BEAGLE_CPU_TEMPLATE
                                                              const int* cumulativeScaleIndices,
                                                              int count,
                                                              double* outSumLogLikelihood) {
+    ScopedKernelTimer timer(gStatistics, traceRecorder, traceInstance,
+                            BEAGLE_STATISTICS_ROOT_INTEGRATION, (long long) count * kPatternCount,
+                            count * getPartialsBytes(kPatternCount));
+
 
     if (count == 1) {
         // We treat this as a special case so that we don't have convoluted logic
@@ -1567,6 +1899,11 @@ BEAGLE_CPU_TEMPLATE
                                                                   double* outSumLogLikelihoodByPartition,
                                                                   double* outSumLogLikelihood) {
 
+    long long patternCount = getPartitionPatternCount(partitionIndices, partitionCount);
+    ScopedKernelTimer timer(gStatistics, traceRecorder, traceInstance,
+                            BEAGLE_STATISTICS_ROOT_INTEGRATION, count * patternCount,
+                            count * getPartialsBytes(patternCount));
+
     int returnCode = BEAGLE_SUCCESS;
 
     if (count == 1) {
@@ -1608,39 +1945,12 @@ BEAGLE_CPU_TEMPLATE
                                                         double* outSumLogLikelihoodByPartition) {
 
 
-    int partitionsPerThreadFloor = partitionCount / kNumThreads;
-    int partitionsRemainder = partitionCount % kNumThreads;
-    int currentPartitionIndex = 0;
-    int threadsUsed = (partitionCount < kNumThreads ? partitionCount : kNumThreads);
-    for (int i=0; i<threadsUsed; i++) {
-        int partitionCountThread = partitionsPerThreadFloor;
-        if (partitionsRemainder) {
-            partitionCountThread++;
-            partitionsRemainder--;
-        }
-
-        std::packaged_task<void()> threadTask(
-            std::bind(&BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcRootLogLikelihoodsByPartition, this,
-                      &bufferIndices[currentPartitionIndex], &categoryWeightsIndices[currentPartitionIndex],
-                      &stateFrequenciesIndices[currentPartitionIndex], &cumulativeScaleIndices[currentPartitionIndex],
-                      &partitionIndices[currentPartitionIndex], partitionCountThread,
-                      &outSumLogLikelihoodByPartition[currentPartitionIndex]));
-
-        gFutures[i] = threadTask.get_future();
-        threadData* td = &gThreads[i];
-
-        std::unique_lock<std::mutex> l(td->m);
-        td->jobs.push(std::move(threadTask));
-        l.unlock();
-
-        gThreads[i].cv.notify_one();
-
-        currentPartitionIndex += partitionCountThread;
-    }
-
-    for (int i=0; i<kNumThreads; i++) {
-        gFutures[i].wait();
-    }
+    runThreadTasks(partitionCount, [&] (int i) {
+        calcRootLogLikelihoodsByPartition(&bufferIndices[i], &categoryWeightsIndices[i],
+                                          &stateFrequenciesIndices[i], &cumulativeScaleIndices[i],
+                                          &partitionIndices[i], 1,
+                                          &outSumLogLikelihoodByPartition[i]);
+    });
 
 }
 
@@ -1653,29 +1963,12 @@ BEAGLE_CPU_TEMPLATE
                                                         const int* partitionIndices,
                                                         double* outSumLogLikelihoodByPartition) {
 
-    for (int i=0; i<kNumThreads; i++) {
-
-        std::packaged_task<void()> threadTask(
-            std::bind(&BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcRootLogLikelihoodsByPartition, this,
-                      bufferIndices, categoryWeightsIndices,
-                      stateFrequenciesIndices, cumulativeScaleIndices,
-                      &partitionIndices[i], 1,
-                      &outSumLogLikelihoodByPartition[i]));
-
-        gFutures[i] = threadTask.get_future();
-        threadData* td = &gThreads[i];
-
-        std::unique_lock<std::mutex> l(td->m);
-        td->jobs.push(std::move(threadTask));
-        l.unlock();
-
-        gThreads[i].cv.notify_one();
-
-    }
-
-    for (int i=0; i<kNumThreads; i++) {
-        gFutures[i].wait();
-    }
+    runThreadTasks(kPartitionCount, [&] (int i) {
+        calcRootLogLikelihoodsByPartition(bufferIndices, categoryWeightsIndices,
+                                          stateFrequenciesIndices, cumulativeScaleIndices,
+                                          &partitionIndices[i], 1,
+                                          &outSumLogLikelihoodByPartition[i]);
+    });
 
 }
 
@@ -1786,6 +2079,7 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcRootLogLikelihoodsMulti(const int* bu
     *outSumLogLikelihood = 0.0;
     for (int i = 0; i < kPatternCount; i++) {
         *outSumLogLikelihood += outLogLikelihoodsTmp[i] * gPatternWeights[i];
+        storeSiteValue(gSiteLogLikelihoodsOutput, i, outLogLikelihoodsTmp[i]);
     }
 
     if (*outSumLogLikelihood != *outSumLogLikelihood)
@@ -1849,6 +2143,7 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcRootLogLikelihoods(const int bufferIn
     *outSumLogLikelihood = 0.0;
     for (int i = 0; i < kPatternCount; i++) {
         *outSumLogLikelihood += outLogLikelihoodsTmp[i] * gPatternWeights[i];
+        storeSiteValue(gSiteLogLikelihoodsOutput, i, outLogLikelihoodsTmp[i]);
     }
 
     if (*outSumLogLikelihood != *outSumLogLikelihood)
@@ -1922,6 +2217,7 @@ void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcRootLogLikelihoodsByPartition(
         outSumLogLikelihoodByPartition[p] = 0.0;
         for (int i = startPattern; i < endPattern; i++) {
             outSumLogLikelihoodByPartition[p] += outLogLikelihoodsTmp[i] * gPatternWeights[i];
+            storeSiteValue(gSiteLogLikelihoodsOutput, i, outLogLikelihoodsTmp[i]);
         }
 
     }
@@ -2096,6 +2392,11 @@ BEAGLE_CPU_TEMPLATE
                                                              double* outSumLogLikelihood,
                                                              double* outSumFirstDerivative,
                                                              double* outSumSecondDerivative) {
+    ScopedKernelTimer timer(gStatistics, traceRecorder, traceInstance,
+                            BEAGLE_STATISTICS_EDGE_INTEGRATION, (long long) count * kPatternCount,
+                            count * (2 * getPartialsBytes(kPatternCount) +
+                                     getMatrixUpdateBytes(firstDerivativeIndices, secondDerivativeIndices, 1)));
+
     // TODO: implement for count > 1
 
     if (count == 1) {
@@ -2193,6 +2494,12 @@ BEAGLE_CPU_TEMPLATE
                                                     double* outSumSecondDerivativeByPartition,
                                                     double* outSumSecondDerivative) {
 
+    long long patternCount = getPartitionPatternCount(partitionIndices, partitionCount);
+    ScopedKernelTimer timer(gStatistics, traceRecorder, traceInstance,
+                            BEAGLE_STATISTICS_EDGE_INTEGRATION, count * patternCount,
+                            count * (2 * getPartialsBytes(patternCount) +
+                                     getMatrixUpdateBytes(firstDerivativeIndices, secondDerivativeIndices, 1)));
+
     int returnCode = BEAGLE_SUCCESS;
 
     if (count == 1) {
@@ -2290,44 +2597,17 @@ BEAGLE_CPU_TEMPLATE
                                                         int partitionCount,
                                                         double* outSumLogLikelihoodByPartition) {
 
-    int partitionsPerThreadFloor = partitionCount / kNumThreads;
-    int partitionsRemainder = partitionCount % kNumThreads;
-    int currentPartitionIndex = 0;
-    int threadsUsed = (partitionCount < kNumThreads ? partitionCount : kNumThreads);
-    for (int i=0; i<threadsUsed; i++) {
-        int partitionCountThread = partitionsPerThreadFloor;
-        if (partitionsRemainder) {
-            partitionCountThread++;
-            partitionsRemainder--;
-        }
-
-        std::packaged_task<void()> threadTask(
-            std::bind(&BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcEdgeLogLikelihoodsByPartition, this,
-                      &parentBufferIndices[currentPartitionIndex],
-                      &childBufferIndices[currentPartitionIndex],
-                      &probabilityIndices[currentPartitionIndex],
-                      &categoryWeightsIndices[currentPartitionIndex],
-                      &stateFrequenciesIndices[currentPartitionIndex],
-                      &cumulativeScaleIndices[currentPartitionIndex],
-                      &partitionIndices[currentPartitionIndex],
-                      partitionCountThread,
-                      &outSumLogLikelihoodByPartition[currentPartitionIndex]));
-
-        gFutures[i] = threadTask.get_future();
-        threadData* td = &gThreads[i];
-
-        std::unique_lock<std::mutex> l(td->m);
-        td->jobs.push(std::move(threadTask));
-        l.unlock();
-
-        gThreads[i].cv.notify_one();
-
-        currentPartitionIndex += partitionCountThread;
-    }
-
-    for (int i=0; i<kNumThreads; i++) {
-        gFutures[i].wait();
-    }
+    runThreadTasks(partitionCount, [&] (int i) {
+        calcEdgeLogLikelihoodsByPartition(&parentBufferIndices[i],
+                                          &childBufferIndices[i],
+                                          &probabilityIndices[i],
+                                          &categoryWeightsIndices[i],
+                                          &stateFrequenciesIndices[i],
+                                          &cumulativeScaleIndices[i],
+                                          &partitionIndices[i],
+                                          1,
+                                          &outSumLogLikelihoodByPartition[i]);
+    });
 
 }
 
@@ -2342,33 +2622,17 @@ BEAGLE_CPU_TEMPLATE
                                                         const int* partitionIndices,
                                                         double* outSumLogLikelihoodByPartition) {
 
-    for (int i=0; i<kNumThreads; i++) {
-
-        std::packaged_task<void()> threadTask(
-            std::bind(&BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcEdgeLogLikelihoodsByPartition, this,
-                      parentBufferIndices,
-                      childBufferIndices,
-                      probabilityIndices,
-                      categoryWeightsIndices,
-                      stateFrequenciesIndices,
-                      cumulativeScaleIndices,
-                      &partitionIndices[i],
-                      1,
-                      &outSumLogLikelihoodByPartition[i]));
-
-        gFutures[i] = threadTask.get_future();
-        threadData* td = &gThreads[i];
-
-        std::unique_lock<std::mutex> l(td->m);
-        td->jobs.push(std::move(threadTask));
-        l.unlock();
-
-        gThreads[i].cv.notify_one();
-    }
-
-    for (int i=0; i<kNumThreads; i++) {
-        gFutures[i].wait();
-    }
+    runThreadTasks(kPartitionCount, [&] (int i) {
+        calcEdgeLogLikelihoodsByPartition(parentBufferIndices,
+                                          childBufferIndices,
+                                          probabilityIndices,
+                                          categoryWeightsIndices,
+                                          stateFrequenciesIndices,
+                                          cumulativeScaleIndices,
+                                          &partitionIndices[i],
+                                          1,
+                                          &outSumLogLikelihoodByPartition[i]);
+    });
 
 }
 
@@ -2482,6 +2746,7 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcEdgeLogLikelihoods(const int parIndex
     *outSumLogLikelihood = 0.0;
     for (int i = 0; i < kPatternCount; i++) {
         *outSumLogLikelihood += outLogLikelihoodsTmp[i] * gPatternWeights[i];
+        storeSiteValue(gSiteLogLikelihoodsOutput, i, outLogLikelihoodsTmp[i]);
     }
 
     if (*outSumLogLikelihood != *outSumLogLikelihood)
@@ -2612,6 +2877,7 @@ void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcEdgeLogLikelihoodsByPartition(
         outSumLogLikelihoodByPartition[p] = 0.0;
         for (int i = startPattern; i < endPattern; i++) {
             outSumLogLikelihoodByPartition[p] += outLogLikelihoodsTmp[i] * gPatternWeights[i];
+            storeSiteValue(gSiteLogLikelihoodsOutput, i, outLogLikelihoodsTmp[i]);
         }
 
     }
@@ -2753,8 +3019,11 @@ void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcEdgeLogLikelihoodsSecondDerivByParti
         outSumSecondDerivativeByPartition[p] = 0.0;
         for (int i = startPattern; i < endPattern; i++) {
             outSumLogLikelihoodByPartition[p]    += outLogLikelihoodsTmp[i]    * gPatternWeights[i];
+            storeSiteValue(gSiteLogLikelihoodsOutput, i, outLogLikelihoodsTmp[i]);
             outSumFirstDerivativeByPartition[p]  += outFirstDerivativesTmp[i]  * gPatternWeights[i];
+            storeSiteValue(gSiteFirstDerivativesOutput, i, outFirstDerivativesTmp[i]);
             outSumSecondDerivativeByPartition[p] += outSecondDerivativesTmp[i] * gPatternWeights[i];
+            storeSiteValue(gSiteSecondDerivativesOutput, i, outSecondDerivativesTmp[i]);
         }
 
     }
@@ -2907,6 +3176,7 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcEdgeLogLikelihoodsMulti(const int* pa
     *outSumLogLikelihood = 0.0;
     for (int i = 0; i < kPatternCount; i++) {
         *outSumLogLikelihood += outLogLikelihoodsTmp[i] * gPatternWeights[i];
+        storeSiteValue(gSiteLogLikelihoodsOutput, i, outLogLikelihoodsTmp[i]);
     }
     
     if (*outSumLogLikelihood != *outSumLogLikelihood)
@@ -3021,8 +3291,10 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcEdgeLogLikelihoodsFirstDeriv(const in
     *outSumFirstDerivative = 0.0;
     for (int i = 0; i < kPatternCount; i++) {
         *outSumLogLikelihood += outLogLikelihoodsTmp[i] * gPatternWeights[i];
+        storeSiteValue(gSiteLogLikelihoodsOutput, i, outLogLikelihoodsTmp[i]);
 
         *outSumFirstDerivative += outFirstDerivativesTmp[i] * gPatternWeights[i];
+        storeSiteValue(gSiteFirstDerivativesOutput, i, outFirstDerivativesTmp[i]);
     }
     
     if (*outSumLogLikelihood != *outSumLogLikelihood)
@@ -3148,10 +3420,13 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcEdgeLogLikelihoodsSecondDeriv(const i
     *outSumSecondDerivative = 0.0;
     for (int i = 0; i < kPatternCount; i++) {
         *outSumLogLikelihood += outLogLikelihoodsTmp[i] * gPatternWeights[i];
+        storeSiteValue(gSiteLogLikelihoodsOutput, i, outLogLikelihoodsTmp[i]);
 
         *outSumFirstDerivative += outFirstDerivativesTmp[i] * gPatternWeights[i];
+        storeSiteValue(gSiteFirstDerivativesOutput, i, outFirstDerivativesTmp[i]);
 
         *outSumSecondDerivative += outSecondDerivativesTmp[i] * gPatternWeights[i];
+        storeSiteValue(gSiteSecondDerivativesOutput, i, outSecondDerivativesTmp[i]);
     }
 
     if (*outSumLogLikelihood != *outSumLogLikelihood)
@@ -3353,6 +3628,7 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::reorderPatternsByPartition() {
 
     for (int tip=0; tip < kTipCount; tip++) {
         if (gTipStates[tip] == NULL) {
+            makePartialsWritable(tip);
             REALTYPE* unsortedPartials = gPartials[tip];
             for (int l=0; l < kCategoryCount; l++) {
                 for (int i=0; i < kPatternCount; i++) {
@@ -3366,6 +3642,8 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::reorderPatternsByPartition() {
             gPartials[tip] = sortedPartials;
             sortedPartials = unsortedPartials;
         } else {
+            gTipStates[tip] = (int*) unshareBuffer(gTipStates[tip], &gTipStatesRefCounts[tip],
+                                                   sizeof(int) * kPaddedPatternCount);
             int* unsortedTips = gTipStates[tip];
             for (int i=0; i < kPatternCount; i++) {
                 int sortIndex = gPatternsNewOrder[i];
@@ -3382,6 +3660,8 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::reorderPatternsByPartition() {
 
     kPatternsReordered = true;
 
+    updateSiteOutputOrder();
+
     return BEAGLE_SUCCESS;
 }
 
@@ -3397,6 +3677,17 @@ void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcStatesStates(REALTYPE* destP,
                                                          const REALTYPE* matrices2,
                                                          int startPattern,
                                                          int endPattern) {
+    calcStatesStatesKernel(destP, states1, matrices1, states2, matrices2, startPattern, endPattern);
+}
+
+BEAGLE_CPU_TEMPLATE
+void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcStatesStatesKernel(REALTYPE* destP,
+                                                               const int* states1,
+                                                               const REALTYPE* matrices1,
+                                                               const int* states2,
+                                                               const REALTYPE* matrices2,
+                                                               int startPattern,
+                                                               int endPattern) {
 
 #pragma omp parallel for num_threads(kCategoryCount)
     for (int l = 0; l < kCategoryCount; l++) {
@@ -3434,6 +3725,19 @@ void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcStatesStatesFixedScaling(REALTYPE* d
                                                                      const REALTYPE* scaleFactors,
                                                                      int startPattern,
                                                                      int endPattern) {
+    calcStatesStatesFixedScalingKernel(destP, child1States, child1TransMat, child2States,
+                                       child2TransMat, scaleFactors, startPattern, endPattern);
+}
+
+BEAGLE_CPU_TEMPLATE
+void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcStatesStatesFixedScalingKernel(REALTYPE* destP,
+                                                                           const int* child1States,
+                                                                           const REALTYPE* child1TransMat,
+                                                                           const int* child2States,
+                                                                           const REALTYPE* child2TransMat,
+                                                                           const REALTYPE* scaleFactors,
+                                                                           int startPattern,
+                                                                           int endPattern) {
 
 #pragma omp parallel for num_threads(kCategoryCount)
     for (int l = 0; l < kCategoryCount; l++) {
@@ -3471,6 +3775,18 @@ void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcStatesPartials(REALTYPE* destP,
                                                            const REALTYPE* matrices2,
                                                            int startPattern,
                                                            int endPattern) {
+    calcStatesPartialsKernel(destP, states1, matrices1, partials2,
+                             matrices2, startPattern, endPattern);
+}
+
+BEAGLE_CPU_TEMPLATE
+void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcStatesPartialsKernel(REALTYPE* destP,
+                                                                 const int* states1,
+                                                                 const REALTYPE* matrices1,
+                                                                 const REALTYPE* partials2,
+                                                                 const REALTYPE* matrices2,
+                                                                 int startPattern,
+                                                                 int endPattern) {
 
     int matrixIncr = kStateCount;
 
@@ -3528,6 +3844,19 @@ void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcStatesPartialsFixedScaling(REALTYPE*
                                                                        const REALTYPE* scaleFactors,
                                                                        int startPattern,
                                                                        int endPattern) {
+    calcStatesPartialsFixedScalingKernel(destP, states1, matrices1, partials2,
+                                         matrices2, scaleFactors, startPattern, endPattern);
+}
+
+BEAGLE_CPU_TEMPLATE
+void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcStatesPartialsFixedScalingKernel(REALTYPE* destP,
+                                                                             const int* states1,
+                                                                             const REALTYPE* matrices1,
+                                                                             const REALTYPE* partials2,
+                                                                             const REALTYPE* matrices2,
+                                                                             const REALTYPE* scaleFactors,
+                                                                             int startPattern,
+                                                                             int endPattern) {
 
     int matrixIncr = kStateCount;
 
@@ -3587,6 +3916,18 @@ void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcPartialsPartials(REALTYPE* destP,
                                                              const REALTYPE* matrices2,
                                                              int startPattern,
                                                              int endPattern) {
+    calcPartialsPartialsKernel(destP, partials1, matrices1, partials2,
+                               matrices2, startPattern, endPattern);
+}
+
+BEAGLE_CPU_TEMPLATE
+void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcPartialsPartialsKernel(REALTYPE* destP,
+                                                                   const REALTYPE* partials1,
+                                                                   const REALTYPE* matrices1,
+                                                                   const REALTYPE* partials2,
+                                                                   const REALTYPE* matrices2,
+                                                                   int startPattern,
+                                                                   int endPattern) {
     int matrixIncr = kStateCount;
 
     // increment for the extra column at the end
@@ -3646,6 +3987,19 @@ void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcPartialsPartialsFixedScaling(REALTYP
                                                                          const REALTYPE* scaleFactors,
                                                                          int startPattern,
                                                                          int endPattern) {
+    calcPartialsPartialsFixedScalingKernel(destP, partials1, matrices1, partials2,
+                                           matrices2, scaleFactors, startPattern, endPattern);
+}
+
+BEAGLE_CPU_TEMPLATE
+void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::calcPartialsPartialsFixedScalingKernel(REALTYPE* destP,
+                                                                               const REALTYPE* partials1,
+                                                                               const REALTYPE* matrices1,
+                                                                               const REALTYPE* partials2,
+                                                                               const REALTYPE* matrices2,
+                                                                               const REALTYPE* scaleFactors,
+                                                                               int startPattern,
+                                                                               int endPattern) {
 
     int matrixIncr = kStateCount;
 
@@ -3745,6 +4099,263 @@ int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::getPaddedPatternsModulus() {
     return 1;  // No padding
 }
 
+BEAGLE_CPU_TEMPLATE
+void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::storeSiteValue(double* outSiteValues,
+                                                      int pattern,
+                                                      REALTYPE value) {
+    if (outSiteValues != NULL)
+        outSiteValues[gSiteOutputOrder == NULL ? pattern : gSiteOutputOrder[pattern]] = value;
+}
+
+/*
+ * Inverts gPatternsNewOrder so that site values can be stored in original pattern
+ * order as they are integrated; only needed once a site output array is set.
+ */
+BEAGLE_CPU_TEMPLATE
+void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::updateSiteOutputOrder() {
+    if (!kPatternsReordered || gSiteOutputOrder != NULL)
+        return;
+    if (gSiteLogLikelihoodsOutput == NULL && gSiteFirstDerivativesOutput == NULL &&
+        gSiteSecondDerivativesOutput == NULL)
+        return;
+
+    gSiteOutputOrder = (int*) malloc(sizeof(int) * kPatternCount);
+    if (gSiteOutputOrder == NULL)
+        throw std::bad_alloc();
+    for (int i = 0; i < kPatternCount; i++)
+        gSiteOutputOrder[gPatternsNewOrder[i]] = i;
+}
+
+// Estimates of the bytes touched by a kernel call, for instance statistics
+BEAGLE_CPU_TEMPLATE
+long long BeagleCPUImpl<BEAGLE_CPU_GENERIC>::getPartialsBytes(long long patternCount) {
+    return patternCount * kCategoryCount * kPartialsPaddedStateCount * sizeof(REALTYPE);
+}
+
+BEAGLE_CPU_TEMPLATE
+long long BeagleCPUImpl<BEAGLE_CPU_GENERIC>::getMatrixUpdateBytes(const int* firstDerivativeIndices,
+                                                                  const int* secondDerivativeIndices,
+                                                                  int count) {
+    int matrixKinds = 1 + (firstDerivativeIndices != NULL) + (secondDerivativeIndices != NULL);
+    return (long long) matrixKinds * count * kMatrixSize * kCategoryCount * sizeof(REALTYPE);
+}
+
+BEAGLE_CPU_TEMPLATE
+long long BeagleCPUImpl<BEAGLE_CPU_GENERIC>::getPartitionPatternCount(const int* partitionIndices,
+                                                                      int partitionCount) {
+    long long patternCount = 0;
+    for (int i = 0; i < partitionCount; i++) {
+        int partition = partitionIndices[i];
+        patternCount += gPatternPartitionsStartPatterns[partition + 1] - gPatternPartitionsStartPatterns[partition];
+    }
+    return patternCount;
+}
+
+BEAGLE_CPU_TEMPLATE
+void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::getCheckpointSections(std::vector<checkpointSection>& sections) {
+    // Pattern partitioning is part of the instance configuration, not its state;
+    // a checkpoint can only be loaded into an identically partitioned instance.
+    checkpointSection partitions = {NULL, NULL, (kPartitionsInitialised ? gPatternPartitions : NULL),
+                                    sizeof(int) * kPatternCount, false, true};
+    sections.push_back(partitions);
+    checkpointSection newOrder = {NULL, NULL, (kPatternsReordered ? gPatternsNewOrder : NULL),
+                                  sizeof(int) * kPatternCount, false, true};
+    sections.push_back(newOrder);
+
+    checkpointSection weights = {NULL, NULL, gPatternWeights, sizeof(double) * kPatternCount, false, false};
+    sections.push_back(weights);
+
+    for (int i = 0; i < kTipCount; i++) {
+        checkpointSection tipStates = {(void**) &gTipStates[i], &gTipStatesRefCounts[i], gTipStates[i],
+                                       sizeof(int) * kPaddedPatternCount, true, false};
+        sections.push_back(tipStates);
+    }
+
+    for (int i = 0; i < kBufferCount; i++) {
+        checkpointSection partials = {(void**) &gPartials[i], &gPartialsRefCounts[i], gPartials[i],
+                                      sizeof(REALTYPE) * kPartialsSize, true, false};
+        sections.push_back(partials);
+    }
+
+    if (kFlags & BEAGLE_FLAG_SCALING_AUTO) {
+        for (int i = 0; i < kScaleBufferCount; i++) {
+            checkpointSection scale = {NULL, NULL, gAutoScaleBuffers[i],
+                                       sizeof(signed short) * kPaddedPatternCount, false, false};
+            sections.push_back(scale);
+        }
+        checkpointSection active = {NULL, NULL, gActiveScalingFactors,
+                                    sizeof(int) * kInternalPartialsBufferCount, false, false};
+        sections.push_back(active);
+        checkpointSection cumulative = {NULL, NULL, gScaleBuffers[0],
+                                        sizeof(REALTYPE) * kPaddedPatternCount, false, false};
+        sections.push_back(cumulative);
+    } else {
+        for (int i = 0; i < kScaleBufferCount; i++) {
+            checkpointSection scale = {NULL, NULL, gScaleBuffers[i],
+                                       sizeof(REALTYPE) * kPaddedPatternCount, false, false};
+            sections.push_back(scale);
+        }
+    }
+
+    for (int i = 0; i < kMatrixCount; i++) {
+        checkpointSection matrix = {(void**) &gTransitionMatrices[i], &gTransitionMatricesRefCounts[i],
+                                    gTransitionMatrices[i],
+                                    sizeof(REALTYPE) * kMatrixSize * kCategoryCount, true, false};
+        sections.push_back(matrix);
+    }
+
+    int eigenBufferCount = gEigenDecomposition->getBufferCount();
+    for (int i = 0; i < kEigenDecompCount; i++) {
+        for (int j = 0; j < eigenBufferCount; j++) {
+            int length;
+            REALTYPE* buffer = gEigenDecomposition->getBuffer(i, j, &length);
+            checkpointSection eigen = {NULL, NULL, buffer, sizeof(REALTYPE) * length, false, false};
+            sections.push_back(eigen);
+        }
+    }
+
+    for (int i = 0; i < kEigenDecompCount; i++) {
+        checkpointSection rates = {(void**) &gCategoryRates[i], NULL, gCategoryRates[i],
+                                   sizeof(double) * kCategoryCount, false, false};
+        sections.push_back(rates);
+        checkpointSection categoryWeights = {(void**) &gCategoryWeights[i], NULL, gCategoryWeights[i],
+                                             sizeof(REALTYPE) * kCategoryCount, false, false};
+        sections.push_back(categoryWeights);
+        checkpointSection frequencies = {(void**) &gStateFrequencies[i], NULL, gStateFrequencies[i],
+                                         sizeof(REALTYPE) * kStateCount, false, false};
+        sections.push_back(frequencies);
+    }
+}
+
+BEAGLE_CPU_TEMPLATE
+void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::fillCheckpointHeader(checkpointHeader* header) {
+    memset(header, 0, sizeof(checkpointHeader));
+    memcpy(header->magic, "BGLCKPT", 8);
+    header->version = BEAGLE_CPU_CHECKPOINT_VERSION;
+    header->realSize = sizeof(REALTYPE);
+    header->transPad = T_PAD;
+    header->partialsPad = P_PAD;
+    header->stateCount = kStateCount;
+    header->patternCount = kPatternCount;
+    header->paddedPatternCount = kPaddedPatternCount;
+    header->categoryCount = kCategoryCount;
+    header->bufferCount = kBufferCount;
+    header->tipCount = kTipCount;
+    header->matrixCount = kMatrixCount;
+    header->eigenDecompCount = kEigenDecompCount;
+    header->scaleBufferCount = kScaleBufferCount;
+    header->eigenBufferCount = gEigenDecomposition->getBufferCount();
+    header->partitionCount = (kPartitionsInitialised ? kPartitionCount : 0);
+    header->patternsReordered = kPatternsReordered;
+    header->flags = kFlags & ~(BEAGLE_FLAG_THREADING_CPP | BEAGLE_FLAG_THREADING_OPENMP | BEAGLE_FLAG_THREADING_NONE);
+}
+
+/*
+ * Gives this instance a private copy of a buffer shared with other instances,
+ * or takes over the buffer if every other instance has already released it.
+ */
+BEAGLE_CPU_TEMPLATE
+void* BeagleCPUImpl<BEAGLE_CPU_GENERIC>::unshareBuffer(void* buffer,
+                                                      std::atomic<int>** refCount,
+                                                      size_t size) {
+    if (*refCount == NULL)
+        return buffer;
+
+    if (*refCount != &gCallerOwned && **refCount == 1) {
+        delete *refCount;
+        *refCount = NULL;
+        return buffer;
+    }
+
+    void* copy = mallocAligned(size);
+    if (copy == NULL)
+        throw std::bad_alloc();
+    memcpy(copy, buffer, size);
+
+    releaseBuffer(buffer, refCount);
+
+    return copy;
+}
+
+BEAGLE_CPU_TEMPLATE
+void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::releaseBuffer(void* buffer,
+                                                     std::atomic<int>** refCount) {
+    if (*refCount == NULL) {
+        free(buffer);
+    } else if (*refCount == &gCallerOwned) {
+        *refCount = NULL;
+    } else {
+        if (--(**refCount) == 0) {
+            delete *refCount;
+            free(buffer);
+        }
+        *refCount = NULL;
+    }
+}
+
+BEAGLE_CPU_TEMPLATE
+void* BeagleCPUImpl<BEAGLE_CPU_GENERIC>::shareBuffer(void* sourceBuffer,
+                                                    std::atomic<int>** sourceRefCount,
+                                                    std::atomic<int>** destRefCount,
+                                                    size_t size) {
+    // caller-owned buffers may be written in place by their instance, so clones get a copy
+    if (*sourceRefCount == &gCallerOwned) {
+        void* copy = mallocAligned(size);
+        if (copy == NULL)
+            throw std::bad_alloc();
+        memcpy(copy, sourceBuffer, size);
+        *destRefCount = NULL;
+        return copy;
+    }
+
+    if (*sourceRefCount == NULL)
+        *sourceRefCount = new std::atomic<int>(1);
+    ++(**sourceRefCount);
+    *destRefCount = *sourceRefCount;
+    return sourceBuffer;
+}
+
+BEAGLE_CPU_TEMPLATE
+void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::makePartialsWritable(int bufferIndex) {
+    if (gPartialsRefCounts[bufferIndex] != NULL)
+        gPartials[bufferIndex] = (REALTYPE*) unshareBuffer(gPartials[bufferIndex],
+                                                           &gPartialsRefCounts[bufferIndex],
+                                                           sizeof(REALTYPE) * kPartialsSize);
+}
+
+BEAGLE_CPU_TEMPLATE
+void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::makeMatrixWritable(int matrixIndex) {
+    if (gTransitionMatricesRefCounts[matrixIndex] != NULL)
+        gTransitionMatrices[matrixIndex] = (REALTYPE*) unshareBuffer(gTransitionMatrices[matrixIndex],
+                                                                     &gTransitionMatricesRefCounts[matrixIndex],
+                                                                     sizeof(REALTYPE) * kMatrixSize * kCategoryCount);
+}
+
+BEAGLE_CPU_TEMPLATE
+void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::makeMatricesWritable(const int* matrixIndices,
+                                                            int count) {
+    if (matrixIndices == NULL)
+        return;
+    for (int i = 0; i < count; i++)
+        makeMatrixWritable(matrixIndices[i]);
+}
+
+/*
+ * Unshares all destination partials of a list of operations; called before any
+ * work is dispatched so that worker threads never reallocate buffers.
+ */
+BEAGLE_CPU_TEMPLATE
+void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::makeOperationsWritable(const int* operations,
+                                                              int count,
+                                                              int numOps) {
+    for (int op = 0; op < count; op++) {
+        int destinationIndex = operations[op * numOps];
+        // results go straight into caller-owned buffers
+        if (gPartialsRefCounts[destinationIndex] != &gCallerOwned)
+            makePartialsWritable(destinationIndex);
+    }
+}
+
 BEAGLE_CPU_TEMPLATE
 void* BeagleCPUImpl<BEAGLE_CPU_GENERIC>::mallocAligned(size_t size) {
     void *ptr = (void *) NULL;
@@ -3761,11 +4372,7 @@ void* BeagleCPUImpl<BEAGLE_CPU_GENERIC>::mallocAligned(size_t size) {
         assert(0);
     }
 #else
-    #if (T_PAD == 1)    
-        const size_t align = 32;
-    #else // T_PAD == 2
-        const size_t align = 32; // Changed from 16 (under SSE) to ensure AVX alignment
-    #endif
+    const size_t align = BEAGLE_CPU_BUFFER_ALIGNMENT; // 32 rather than 16 (under SSE) to ensure AVX alignment
     int res;
     res = posix_memalign(&ptr, align, size);
     if (res != 0) {
@@ -3776,6 +4383,19 @@ void* BeagleCPUImpl<BEAGLE_CPU_GENERIC>::mallocAligned(size_t size) {
     return ptr;
 }
 
+BEAGLE_CPU_TEMPLATE
+void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::waitForThreads() {
+    TraceScope waitTrace(traceRecorder, "waitForThreads", "thread", traceInstance);
+    double waitStartTime = (gStatistics.isEnabled() ? InstanceStatistics::getTime() : 0.0);
+
+    for (int i=0; i<kNumThreads; i++) {
+        gFutures[i].wait();
+    }
+
+    if (gStatistics.isEnabled())
+        gStatistics.addThreadWaitTime(InstanceStatistics::getTime() - waitStartTime);
+}
+
 BEAGLE_CPU_TEMPLATE
 void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::threadWaiting(threadData* tData)
 {
@@ -3784,11 +4404,16 @@ void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::threadWaiting(threadData* tData)
     {
         l.lock();
 
+        double idleStartTime = (gStatistics.isEnabled() ? InstanceStatistics::getTime() : 0.0);
+
         // Wait until the queue won't be empty or stop is signaled
         tData->cv.wait(l, [tData] () {
             return (tData->stop || !tData->jobs.empty()); 
             });
 
+        if (gStatistics.isEnabled())
+            gStatistics.addThreadIdleTime(InstanceStatistics::getTime() - idleStartTime);
+
         // Stop was signaled, let's exit the thread
         if (tData->stop) { return; }
 
@@ -3799,10 +4424,260 @@ void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::threadWaiting(threadData* tData)
         l.unlock();
 
         // Execute the task!
+        TraceScope taskTrace(traceRecorder, "task", "thread", traceInstance);
         j();
     }
 }
 
+BEAGLE_CPU_TEMPLATE
+void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::stopThreads() {
+    if (!kThreadingEnabled)
+        return;
+
+    kThreadingEnabled = false;
+    if (!(kFlags & BEAGLE_FLAG_THREADING_CPP))
+        return;
+
+    // Send stop signal to all threads and join them...
+    for (int i = 0; i < kNumThreads; i++) {
+        threadData* td = &gThreads[i];
+        std::unique_lock<std::mutex> l(td->m);
+        td->stop = true;
+        td->cv.notify_one();
+    }
+
+    // Join all the threads
+    for (int i = 0; i < kNumThreads; i++) {
+        threadData* td = &gThreads[i];
+        td->t.join();
+    }
+
+    delete[] gThreads;
+    delete[] gFutures;
+}
+
+BEAGLE_CPU_TEMPLATE
+void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::runThreadTasks(int taskCount,
+                                                       const std::function<void(int)>& task) {
+    if (kFlags & BEAGLE_FLAG_THREADING_OPENMP) {
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(kNumThreads)
+        for (int t = 0; t < taskCount; t++) {
+            task(t);
+        }
+        return;
+    }
+
+    std::atomic<int> nextTask(0);
+
+    for (int i=0; i<kNumThreads; i++) {
+        std::packaged_task<void()> threadTask([&nextTask, taskCount, &task] () {
+            int t;
+            while ((t = nextTask.fetch_add(1)) < taskCount)
+                task(t);
+        });
+
+        gFutures[i] = threadTask.get_future();
+        threadData* td = &gThreads[i];
+
+        std::unique_lock<std::mutex> l(td->m);
+        td->jobs.push(std::move(threadTask));
+        l.unlock();
+
+        gThreads[i].cv.notify_one();
+    }
+
+    waitForThreads();
+}
+
+BEAGLE_CPU_TEMPLATE
+int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::getHardwareThreadCount() {
+#ifdef _OPENMP
+    if (kFlags & BEAGLE_FLAG_THREADING_OPENMP)
+        return omp_get_max_threads();
+#endif
+    return std::thread::hardware_concurrency();
+}
+
+BEAGLE_CPU_TEMPLATE
+int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::getDefaultAutoPartitionCount(int threadLimit) {
+    int hardwareThreads = getHardwareThreadCount();
+    if (kStateCount <= 4) {
+        kMinPatternCount = BEAGLE_CPU_ASYNC_MIN_PATTERN_COUNT_LOW;
+        if (hardwareThreads < BEAGLE_CPU_ASYNC_HW_THREAD_COUNT_THRESHOLD) {
+            kMinPatternCount = BEAGLE_CPU_ASYNC_MIN_PATTERN_COUNT_HIGH;
+        }
+    } else {
+        // measured values from the autotuner take precedence for higher state counts
+        kMinPatternCount = 2;
+    }
+
+    if (kPatternCount < kMinPatternCount || hardwareThreads <= 2)
+        return 1;
+
+    int partitionCount = kPatternCount/(kMinPatternCount/2);
+    if (partitionCount > threadLimit) {
+        partitionCount = threadLimit;
+    }
+    return partitionCount;
+}
+
+BEAGLE_CPU_TEMPLATE
+bool BeagleCPUImpl<BEAGLE_CPU_GENERIC>::getTunedAutoPartitionCount(bool allowMeasurement,
+                                                                   int* outPartitionCount) {
+    int hardwareThreads = getHardwareThreadCount();
+    if (hardwareThreads <= 2 || !CPUAutotuner::isEnabled())
+        return false;
+
+    CPUAutotuneKey key;
+    key.implName = getName();
+    key.stateCount = kStateCount;
+    key.patternCount = kPatternCount;
+    key.categoryCount = kCategoryCount;
+    key.hardwareThreads = hardwareThreads;
+
+    if (CPUAutotuner::lookup(key, outPartitionCount))
+        return true;
+    if (!allowMeasurement)
+        return false;
+
+    int partitionCount = measureAutoPartitionCount(hardwareThreads);
+    if (partitionCount < 1)
+        return false;
+
+    CPUAutotuner::store(key, partitionCount);
+    *outPartitionCount = partitionCount;
+    return true;
+}
+
+BEAGLE_CPU_TEMPLATE
+int BeagleCPUImpl<BEAGLE_CPU_GENERIC>::measureAutoPartitionCount(int hardwareThreads) {
+    // needs three internal partials buffers and a matrix, and no scaling that
+    // would write to scale buffers as a side effect
+    if (kInternalPartialsBufferCount < 3 || kMatrixCount < 1 || kPatternCount < 2 ||
+        (kFlags & (BEAGLE_FLAG_SCALING_AUTO | BEAGLE_FLAG_SCALING_ALWAYS)))
+        return 0;
+
+    int destination = kTipCount;
+    int child1 = kTipCount + 1;
+    int child2 = kTipCount + 2;
+
+    unsigned int seed = 1;
+    for (int i = 0; i < kPartialsSize; i++) {
+        seed = seed * 1103515245 + 12345;
+        gPartials[child1][i] = (REALTYPE) (((seed >> 16) & 0x7fff) + 1) / 32768;
+        seed = seed * 1103515245 + 12345;
+        gPartials[child2][i] = (REALTYPE) (((seed >> 16) & 0x7fff) + 1) / 32768;
+    }
+    for (int i = 0; i < kMatrixSize * kCategoryCount; i++) {
+        seed = seed * 1103515245 + 12345;
+        gTransitionMatrices[0][i] = (REALTYPE) (((seed >> 16) & 0x7fff) + 1) / 32768;
+    }
+
+    int operation[BEAGLE_OP_COUNT] = {destination, BEAGLE_OP_NONE, BEAGLE_OP_NONE,
+                                      child1, 0, child2, 0};
+
+    int candidateCount = 0;
+    int candidates[64];
+    candidates[candidateCount++] = 1;
+    for (int partitionCount = 2; partitionCount < hardwareThreads && partitionCount <= kPatternCount && candidateCount < 63; partitionCount *= 2)
+        candidates[candidateCount++] = partitionCount;
+    if (hardwareThreads <= kPatternCount)
+        candidates[candidateCount++] = hardwareThreads;
+
+    double times[64];
+    for (int c = 0; c < candidateCount; c++) {
+        if (candidates[c] > 1)
+            enableAutoPartitioning(candidates[c]);
+
+        updatePartials(operation, 1, BEAGLE_OP_NONE);
+        int reps = 0;
+        double startTime = InstanceStatistics::getTime();
+        double elapsed;
+        do {
+            updatePartials(operation, 1, BEAGLE_OP_NONE);
+            reps++;
+            elapsed = InstanceStatistics::getTime() - startTime;
+        } while (elapsed < BEAGLE_CPU_AUTOTUNE_MIN_SECONDS && reps < BEAGLE_CPU_AUTOTUNE_MAX_REPS);
+        times[c] = elapsed / reps;
+    }
+    disableAutoPartitioning();
+
+    double bestTime = times[0];
+    for (int c = 1; c < candidateCount; c++) {
+        if (times[c] < bestTime)
+            bestTime = times[c];
+    }
+    int bestPartitionCount = 1;
+    for (int c = 0; c < candidateCount; c++) {
+        if (times[c] <= bestTime * (1.0 + BEAGLE_CPU_AUTOTUNE_TOLERANCE)) {
+            bestPartitionCount = candidates[c];
+            break;
+        }
+    }
+
+    memset(gPartials[destination], 0, sizeof(REALTYPE) * kPartialsSize);
+    memset(gPartials[child1], 0, sizeof(REALTYPE) * kPartialsSize);
+    memset(gPartials[child2], 0, sizeof(REALTYPE) * kPartialsSize);
+    memset(gTransitionMatrices[0], 0, sizeof(REALTYPE) * kMatrixSize * kCategoryCount);
+    gStatistics.reset();
+
+    return bestPartitionCount;
+}
+
+BEAGLE_CPU_TEMPLATE
+void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::enableAutoPartitioning(int threadCount) {
+    disableAutoPartitioning();
+
+    // measured counts are shared by nearby pattern counts
+    if (threadCount > kPatternCount)
+        threadCount = kPatternCount;
+
+    // several blocks per thread so that threads finishing early take over the remaining work
+    int partitionCount = threadCount * BEAGLE_CPU_ASYNC_PARTITIONS_PER_THREAD;
+    if (partitionCount > kPatternCount / BEAGLE_CPU_ASYNC_MIN_PARTITION_PATTERN_COUNT)
+        partitionCount = kPatternCount / BEAGLE_CPU_ASYNC_MIN_PARTITION_PATTERN_COUNT;
+    if (partitionCount < threadCount)
+        partitionCount = threadCount;
+
+    std::vector<int> patternPartitions(kPatternCount);
+    int partitionSize = kPatternCount/partitionCount;
+    for (int i=0; i<kPatternCount; i++) {
+        int sitePartition = i/partitionSize;
+        if (sitePartition > partitionCount - 1)
+            sitePartition = partitionCount - 1;
+        patternPartitions[i] = sitePartition;
+    }
+    partitionPatterns(partitionCount, &patternPartitions[0], threadCount);
+
+    gAutoPartitionOperations = (int*) malloc(sizeof(int) * kBufferCount * kPartitionCount * BEAGLE_PARTITION_OP_COUNT);
+
+    if (kPatternCount >= kMinPatternCount*4) {
+        gAutoPartitionIndices = (int*) malloc(sizeof(int) * partitionCount);
+        for (int i=0; i<partitionCount; i++) {
+            gAutoPartitionIndices[i] = i;
+        }
+        gAutoPartitionOutSumLogLikelihoods = (double*) malloc(sizeof(double) * partitionCount);
+        kAutoRootPartitioningEnabled = true;
+    }
+
+    kAutoPartitioningEnabled = true;
+}
+
+BEAGLE_CPU_TEMPLATE
+void BeagleCPUImpl<BEAGLE_CPU_GENERIC>::disableAutoPartitioning() {
+    stopThreads();
+
+    if (kAutoPartitioningEnabled) {
+        free(gAutoPartitionOperations);
+        if (kAutoRootPartitioningEnabled) {
+            free(gAutoPartitionIndices);
+            free(gAutoPartitionOutSumLogLikelihoods);
+            kAutoRootPartitioningEnabled = false;
+        }
+        kAutoPartitioningEnabled = false;
+    }
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // BeagleCPUImplFactory public methods
 BEAGLE_CPU_FACTORY_TEMPLATE
@@ -3858,7 +4733,7 @@ BEAGLE_CPU_FACTORY_TEMPLATE
 const long BeagleCPUImplFactory<BEAGLE_CPU_FACTORY_GENERIC>::getFlags() {
     long flags = BEAGLE_FLAG_COMPUTATION_SYNCH |
                  BEAGLE_FLAG_SCALING_MANUAL | BEAGLE_FLAG_SCALING_ALWAYS | BEAGLE_FLAG_SCALING_AUTO | BEAGLE_FLAG_SCALING_DYNAMIC |
-                 BEAGLE_FLAG_THREADING_NONE | BEAGLE_FLAG_THREADING_CPP |
+                 BEAGLE_CPU_THREADING_FLAGS |
                  BEAGLE_FLAG_PROCESSOR_CPU |
                  BEAGLE_FLAG_VECTOR_NONE |
                  BEAGLE_FLAG_SCALERS_LOG | BEAGLE_FLAG_SCALERS_RAW |
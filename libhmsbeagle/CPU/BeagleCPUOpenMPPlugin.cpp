@@ -8,16 +8,14 @@
 #include "libhmsbeagle/CPU/BeagleCPUOpenMPPlugin.h"
 #include "libhmsbeagle/CPU/BeagleCPU4StateImpl.h"
 #include "libhmsbeagle/CPU/BeagleCPUImpl.h"
-#include "libhmsbeagle/CPU/BeagleCPUSSEPlugin.h"
-#include "libhmsbeagle/CPU/BeagleCPU4StateSSEImpl.h"
-#include "libhmsbeagle/CPU/BeagleCPUSSEImpl.h"
+#include "libhmsbeagle/CPU/CPUDispatch.h"
 #include <iostream>
 
 namespace beagle {
 namespace cpu {
 
 BeagleCPUOpenMPPlugin::BeagleCPUOpenMPPlugin() :
-Plugin("CPU-SSE-OpenMP", "CPU-SSE-OpenMP")
+Plugin("CPU-OpenMP", "CPU-OpenMP")
 {
 	BeagleResource resource;
         resource.name = (char*) "CPU";
@@ -32,23 +30,19 @@ Plugin("CPU-SSE-OpenMP", "CPU-SSE-OpenMP")
                                          BEAGLE_FLAG_EIGEN_COMPLEX | BEAGLE_FLAG_EIGEN_REAL |
                                          BEAGLE_FLAG_INVEVEC_STANDARD | BEAGLE_FLAG_INVEVEC_TRANSPOSED |
                                          BEAGLE_FLAG_FRAMEWORK_CPU;
-        resource.supportFlags |= BEAGLE_FLAG_VECTOR_SSE;
         resource.supportFlags |= BEAGLE_FLAG_THREADING_OPENMP;
         resource.requiredFlags = BEAGLE_FLAG_FRAMEWORK_CPU;
-	beagleResources.push_back(resource);
 
-	// Optional for plugins: check if the hardware is compatible and only populate
-	// list with compatible factories
+	// Same implementations as the CPU plugin; OpenMP threads share out blocks of patterns,
+	// each running the vectorised kernels
+	resource.supportFlags |= addSSEFactories(beagleFactories);
 	beagleFactories.push_back(new beagle::cpu::BeagleCPU4StateImplFactory<double>());
 	beagleFactories.push_back(new beagle::cpu::BeagleCPU4StateImplFactory<float>());
 	beagleFactories.push_back(new beagle::cpu::BeagleCPUImplFactory<double>());
 	beagleFactories.push_back(new beagle::cpu::BeagleCPUImplFactory<float>());
+	resource.supportFlags |= addAVXFactories(beagleFactories);
 
-	// FIXME: the SSE plugin currently assumes all hardware is compatible
-	beagleFactories.push_back(new beagle::cpu::BeagleCPU4StateSSEImplFactory<double>());
-//	implFactory->push_back(new beagle::cpu::BeagleCPU4StateSSEImplFactory<float>()); // TODO Not yet written
-	beagleFactories.push_back(new beagle::cpu::BeagleCPUSSEImplFactory<double>()); // TODO In process of writing
-
+	beagleResources.push_back(resource);
 }
 
 }	// namespace cpu
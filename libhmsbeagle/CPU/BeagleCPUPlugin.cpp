@@ -8,6 +8,7 @@
 #include "libhmsbeagle/CPU/BeagleCPUPlugin.h"
 #include "libhmsbeagle/CPU/BeagleCPU4StateImpl.h"
 #include "libhmsbeagle/CPU/BeagleCPUImpl.h"
+#include "libhmsbeagle/CPU/CPUDispatch.h"
 #include <iostream>
 
 namespace beagle {
@@ -30,14 +31,17 @@ Plugin("CPU", "CPU")
                                          BEAGLE_FLAG_INVEVEC_STANDARD | BEAGLE_FLAG_INVEVEC_TRANSPOSED |
                                          BEAGLE_FLAG_FRAMEWORK_CPU;
         resource.requiredFlags = BEAGLE_FLAG_FRAMEWORK_CPU;
-	beagleResources.push_back(resource);
 
-	// Optional for plugins: check if the hardware is compatible and only populate
-	// list with compatible factories
+	// Hand-vectorised implementations are only listed if the processor can run them;
+	// the generic kernels pick their instruction set themselves (see CPUDispatch.h)
+	resource.supportFlags |= addSSEFactories(beagleFactories);
 	beagleFactories.push_back(new beagle::cpu::BeagleCPU4StateImplFactory<double>());
 	beagleFactories.push_back(new beagle::cpu::BeagleCPU4StateImplFactory<float>());
 	beagleFactories.push_back(new beagle::cpu::BeagleCPUImplFactory<double>());
 	beagleFactories.push_back(new beagle::cpu::BeagleCPUImplFactory<float>());
+	resource.supportFlags |= addAVXFactories(beagleFactories);
+
+	beagleResources.push_back(resource);
 }
 
 }	// namespace cpu
@@ -0,0 +1,73 @@
+/*
+ *  BeagleCPUSSEFactories.cpp
+ *  SSE implementations of the CPU plugin
+ *
+ *
+ * Copyright 2009 Phylogenetic Likelihood Working Group
+ *
+ * This file is part of BEAGLE.
+ *
+ * BEAGLE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * BEAGLE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BEAGLE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "libhmsbeagle/config.h"
+#endif
+
+#include "libhmsbeagle/CPU/CPUDispatch.h"
+
+#if !defined(BEAGLE_CPU_NO_SSE) && \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || \
+     defined(BEAGLE_CPU_TARGET_PRAGMA))
+    #define BEAGLE_CPU_BUILD_SSE
+#endif
+
+#ifdef BEAGLE_CPU_BUILD_SSE
+// the shared base classes come first, so that they stay compiled for the baseline
+#include "libhmsbeagle/CPU/BeagleCPU4StateImpl.h"
+#include "libhmsbeagle/CPU/BeagleCPUImpl.h"
+
+#if !defined(__SSE2__) && defined(BEAGLE_CPU_TARGET_PRAGMA)
+    #pragma GCC push_options
+    #pragma GCC target("sse2")
+    #define BEAGLE_CPU_POP_TARGET
+#endif
+
+#include "libhmsbeagle/CPU/BeagleCPU4StateSSEImpl.h"
+#include "libhmsbeagle/CPU/BeagleCPUSSEImpl.h"
+
+#ifdef BEAGLE_CPU_POP_TARGET
+    #pragma GCC pop_options
+#endif
+#endif // BEAGLE_CPU_BUILD_SSE
+
+namespace beagle {
+namespace cpu {
+
+long addSSEFactories(std::list<beagle::BeagleImplFactory*>& factories) {
+#ifdef BEAGLE_CPU_BUILD_SSE
+    if (!cpuSupportsSSE2())
+        return 0;
+
+    factories.push_back(new beagle::cpu::BeagleCPU4StateSSEImplFactory<double>());
+    factories.push_back(new beagle::cpu::BeagleCPUSSEImplFactory<double>());
+    return BEAGLE_FLAG_VECTOR_SSE;
+#else
+    return 0;
+#endif
+}
+
+}   // namespace cpu
+}   // namespace beagle
@@ -644,7 +644,7 @@ template <>
 const long BeagleCPUSSEImplFactory<double>::getFlags() {
     return BEAGLE_FLAG_COMPUTATION_SYNCH |
            BEAGLE_FLAG_SCALING_MANUAL | BEAGLE_FLAG_SCALING_ALWAYS | BEAGLE_FLAG_SCALING_AUTO |
-           BEAGLE_FLAG_THREADING_NONE | BEAGLE_FLAG_THREADING_CPP |
+           BEAGLE_CPU_THREADING_FLAGS |
            BEAGLE_FLAG_PROCESSOR_CPU |
            BEAGLE_FLAG_VECTOR_SSE |
            BEAGLE_FLAG_PRECISION_DOUBLE |
@@ -658,7 +658,7 @@ template <>
 const long BeagleCPUSSEImplFactory<float>::getFlags() {
     return BEAGLE_FLAG_COMPUTATION_SYNCH |
            BEAGLE_FLAG_SCALING_MANUAL | BEAGLE_FLAG_SCALING_ALWAYS | BEAGLE_FLAG_SCALING_AUTO |
-           BEAGLE_FLAG_THREADING_NONE | BEAGLE_FLAG_THREADING_CPP |
+           BEAGLE_CPU_THREADING_FLAGS |
            BEAGLE_FLAG_PROCESSOR_CPU |
            BEAGLE_FLAG_VECTOR_SSE |
            BEAGLE_FLAG_PRECISION_SINGLE |
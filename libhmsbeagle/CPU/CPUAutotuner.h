@@ -0,0 +1,195 @@
+/*
+ *  CPUAutotuner.h
+ *  Persistent cache of measured CPU auto-threading configurations
+ *
+ * Copyright 2009 Phylogenetic Likelihood Working Group
+ *
+ * This file is part of BEAGLE.
+ *
+ * BEAGLE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * BEAGLE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BEAGLE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __beagle_cpu_autotuner__
+#define __beagle_cpu_autotuner__
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+#define BEAGLE_CPU_AUTOTUNE_ENV         "BEAGLE_CPU_AUTOTUNE"   // path of the cache file, or "off" to use the fixed cut-offs
+#define BEAGLE_CPU_AUTOTUNE_FILE        ".beagle-cpu-autotune"  // default cache file, in the home directory
+#define BEAGLE_CPU_AUTOTUNE_HEADER      "# BEAGLE CPU autotune 1"   // first line; change whenever the file format changes
+#define BEAGLE_CPU_AUTOTUNE_MIN_SECONDS 0.02    // time each candidate configuration for at least this long
+#define BEAGLE_CPU_AUTOTUNE_MAX_REPS    64      // but with no more than this many repetitions
+#define BEAGLE_CPU_AUTOTUNE_TOLERANCE   0.05    // prefer fewer partitions unless more are faster by this fraction
+
+namespace beagle {
+namespace cpu {
+
+/*
+ * Problem shape an auto-threading configuration was measured for. Pattern
+ * counts are bucketed by powers of two so that nearby problem sizes share a
+ * measurement.
+ */
+struct CPUAutotuneKey {
+    std::string implName;
+    int stateCount;
+    int patternCount;
+    int categoryCount;
+    int hardwareThreads;
+};
+
+/*
+ * Best pattern partition count for auto-threading, by problem shape and CPU
+ * model. Results are kept in memory and in a tab-separated text file with one
+ * line per shape; a partition count of 1 means auto-threading does not pay off.
+ * This class is header-only because the CPU plugins do not link against the
+ * core library.
+ */
+class CPUAutotuner {
+public:
+    // false if autotuning was switched off through the environment
+    static bool isEnabled() {
+        const char* value = getenv(BEAGLE_CPU_AUTOTUNE_ENV);
+        return (value == NULL || strcmp(value, "off") != 0);
+    }
+
+    // returns false if the shape has not been measured on this CPU model
+    static bool lookup(const CPUAutotuneKey& key,
+                       int* outPartitionCount) {
+        std::lock_guard<std::mutex> lock(getMutex());
+        std::map<std::string, int>& table = getTable();
+        std::map<std::string, int>::const_iterator entry = table.find(getKeyString(key));
+        if (entry == table.end())
+            return false;
+        *outPartitionCount = entry->second;
+        return true;
+    }
+
+    static void store(const CPUAutotuneKey& key,
+                      int partitionCount) {
+        std::lock_guard<std::mutex> lock(getMutex());
+        std::map<std::string, int>& table = getTable();
+        table[getKeyString(key)] = partitionCount;
+
+        std::string path = getCachePath();
+        if (path.empty())
+            return;
+        FILE* file = fopen(path.c_str(), "w");
+        if (file == NULL)
+            return;
+        fprintf(file, "%s\n", BEAGLE_CPU_AUTOTUNE_HEADER);
+        for (std::map<std::string, int>::const_iterator entry = table.begin(); entry != table.end(); ++entry)
+            fprintf(file, "%s\t%d\n", entry->first.c_str(), entry->second);
+        fclose(file);
+    }
+
+    // floor(log2(patternCount)), the pattern dimension of a key
+    static int getPatternBucket(int patternCount) {
+        int bucket = 0;
+        while (patternCount > 1) {
+            patternCount >>= 1;
+            bucket++;
+        }
+        return bucket;
+    }
+
+    static std::string getCPUModel() {
+        std::string model = "unknown";
+        FILE* cpuInfo = fopen("/proc/cpuinfo", "r");
+        if (cpuInfo == NULL)
+            return model;
+        char line[512];
+        while (fgets(line, sizeof(line), cpuInfo) != NULL) {
+            if (strncmp(line, "model name", 10) == 0) {
+                const char* value = strchr(line, ':');
+                if (value != NULL) {
+                    model = value + 1;
+                    size_t first = model.find_first_not_of(" \t");
+                    size_t last = model.find_last_not_of(" \t\r\n");
+                    model = (first == std::string::npos ? "unknown" : model.substr(first, last - first + 1));
+                }
+                break;
+            }
+        }
+        fclose(cpuInfo);
+        return model;
+    }
+
+private:
+    static std::string getCachePath() {
+        const char* value = getenv(BEAGLE_CPU_AUTOTUNE_ENV);
+        if (value != NULL && value[0] != '\0')
+            return value;
+        const char* home = getenv("HOME");
+        if (home == NULL)
+            home = getenv("USERPROFILE");
+        if (home == NULL)
+            return "";
+        return std::string(home) + "/" + BEAGLE_CPU_AUTOTUNE_FILE;
+    }
+
+    // {CPU model, hardware threads, implementation, states, pattern bucket, categories}
+    static std::string getKeyString(const CPUAutotuneKey& key) {
+        static const std::string cpuModel = getCPUModel();
+        std::ostringstream keyString;
+        keyString << cpuModel << '\t' << key.hardwareThreads << '\t' << key.implName << '\t'
+                  << key.stateCount << '\t' << getPatternBucket(key.patternCount) << '\t'
+                  << key.categoryCount;
+        return keyString.str();
+    }
+
+    static std::mutex& getMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    // loaded from the cache file on first use; later lines override earlier ones
+    static std::map<std::string, int>& getTable() {
+        static std::map<std::string, int> table;
+        static bool loaded = false;
+        if (!loaded) {
+            loaded = true;
+            std::string path = getCachePath();
+            FILE* file = (path.empty() ? NULL : fopen(path.c_str(), "r"));
+            if (file != NULL) {
+                char line[1024];
+                bool validHeader = (fgets(line, sizeof(line), file) != NULL &&
+                                    strncmp(line, BEAGLE_CPU_AUTOTUNE_HEADER, strlen(BEAGLE_CPU_AUTOTUNE_HEADER)) == 0);
+                while (validHeader && fgets(line, sizeof(line), file) != NULL) {
+                    std::string entry(line);
+                    size_t end = entry.find_last_not_of("\r\n");
+                    size_t separator = entry.rfind('\t');
+                    if (end == std::string::npos || separator == std::string::npos || separator > end)
+                        continue;
+                    int partitionCount = atoi(entry.substr(separator + 1, end - separator).c_str());
+                    if (partitionCount > 0)
+                        table[entry.substr(0, separator)] = partitionCount;
+                }
+                fclose(file);
+            }
+        }
+        return table;
+    }
+};
+
+}   // namespace cpu
+}   // namespace beagle
+
+#endif // __beagle_cpu_autotuner__
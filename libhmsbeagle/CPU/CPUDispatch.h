@@ -0,0 +1,103 @@
+/*
+ *  CPUDispatch.h
+ *  Run-time selection of CPU kernels by instruction set
+ *
+ * Copyright 2009 Phylogenetic Likelihood Working Group
+ *
+ * This file is part of BEAGLE.
+ *
+ * BEAGLE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * BEAGLE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BEAGLE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __beagle_cpu_dispatch__
+#define __beagle_cpu_dispatch__
+
+#include <cstddef>
+#include <list>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+#include "libhmsbeagle/BeagleImpl.h"
+
+/*
+ * BEAGLE_CPU_MULTIVERSION compiles a kernel once per instruction set level (AVX-512, AVX2, AVX and
+ * the build's baseline); the loader picks the best one for the processor when the plugin is opened.
+ * Multiversioned functions cannot be virtual, so virtual kernels forward to a multiversioned one.
+ * Needs GCC 6 or later and the GNU indirect functions of glibc.
+ */
+#if defined(__GNUC__) && !defined(__clang__) && (__GNUC__ >= 6) && \
+    (defined(__x86_64__) || defined(__i386__)) && defined(__linux__) && defined(__GLIBC__) && \
+    !defined(BEAGLE_CPU_NO_MULTIVERSION)
+    #define BEAGLE_CPU_MULTIVERSION __attribute__((target_clones("avx512f", "avx2", "avx", "default")))
+#else
+    #define BEAGLE_CPU_MULTIVERSION
+#endif
+
+/*
+ * Vectorised implementations needing more than the build's baseline are compiled under
+ * BEAGLE_CPU_TARGET_PRAGMA, in their own translation unit, and registered only if the processor
+ * supports them.
+ */
+#if defined(__GNUC__) && !defined(__clang__) && ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)) && \
+    (defined(__x86_64__) || defined(__i386__))
+    #define BEAGLE_CPU_TARGET_PRAGMA
+#endif
+
+namespace beagle {
+namespace cpu {
+
+inline bool cpuSupportsSSE2() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    return false;
+#endif
+}
+
+/** AVX needs both the processor and the operating system, which must save the YMM registers */
+inline bool cpuSupportsAVX() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuid(info, 1);
+    bool osSaves = (info[2] & (1 << 27)) != 0;   // OSXSAVE
+    bool hasAVX  = (info[2] & (1 << 28)) != 0;
+    return osSaves && hasAVX && (_xgetbv(0) & 6) == 6;
+#else
+    return false;
+#endif
+}
+
+/*
+ * Factories for the hand-vectorised implementations, each in its own translation unit.
+ * Each appends its factories if the processor can run them and returns the BEAGLE_FLAG_VECTOR_*
+ * flag the CPU resource gains, or 0.
+ */
+long addSSEFactories(std::list<beagle::BeagleImplFactory*>& factories);
+long addAVXFactories(std::list<beagle::BeagleImplFactory*>& factories);
+
+}   // namespace cpu
+}   // namespace beagle
+
+#endif // __beagle_cpu_dispatch__
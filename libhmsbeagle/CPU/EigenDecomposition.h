@@ -84,6 +84,14 @@ public:
                                  REALTYPE** transitionMatrices,
                                  int count) = 0;
 
+    // returns the number of internal arrays that hold one decomposition
+    virtual int getBufferCount() = 0;
+
+    // returns internal array bufferIndex of decomposition eigenIndex and its length,
+    // used to checkpoint and restore the decomposition without recomputing it
+    virtual REALTYPE* getBuffer(int eigenIndex,
+                                int bufferIndex,
+                                int* outLength) = 0;
 
 };
 
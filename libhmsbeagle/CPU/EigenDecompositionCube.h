@@ -57,6 +57,12 @@ public:
                                  const double* edgeLengths,
                                  REALTYPE** transitionMatrices,
                                  int count);
+
+    virtual int getBufferCount();
+
+    virtual REALTYPE* getBuffer(int eigenIndex,
+                                int bufferIndex,
+                                int* outLength);
 };
 
 }
@@ -403,6 +403,22 @@ if (T_PAD != 0) {
 	}
 }
 
+BEAGLE_CPU_EIGEN_TEMPLATE
+int EigenDecompositionCube<BEAGLE_CPU_EIGEN_GENERIC>::getBufferCount() {
+    return 2;
+}
+
+BEAGLE_CPU_EIGEN_TEMPLATE
+REALTYPE* EigenDecompositionCube<BEAGLE_CPU_EIGEN_GENERIC>::getBuffer(int eigenIndex,
+                                                                     int bufferIndex,
+                                                                     int* outLength) {
+    if (bufferIndex == 0) {
+        *outLength = kStateCount * kStateCount * kStateCount;
+        return gCMatrices[eigenIndex];
+    }
+    *outLength = kStateCount;
+    return gEigenValues[eigenIndex];
+}
 
 } // cpu
 } // beagle
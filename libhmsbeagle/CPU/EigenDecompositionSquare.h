@@ -58,6 +58,12 @@ public:
                                  const double* edgeLengths,
                                  REALTYPE** transitionMatrices,
                                  int count);
+
+    virtual int getBufferCount();
+
+    virtual REALTYPE* getBuffer(int eigenIndex,
+                                int bufferIndex,
+                                int* outLength);
 };
 
 }
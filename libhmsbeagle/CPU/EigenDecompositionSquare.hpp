@@ -263,6 +263,26 @@ if (T_PAD != 0) {
     }
 }
 
+BEAGLE_CPU_EIGEN_TEMPLATE
+int EigenDecompositionSquare<BEAGLE_CPU_EIGEN_GENERIC>::getBufferCount() {
+    return 3;
+}
+
+BEAGLE_CPU_EIGEN_TEMPLATE
+REALTYPE* EigenDecompositionSquare<BEAGLE_CPU_EIGEN_GENERIC>::getBuffer(int eigenIndex,
+                                                                       int bufferIndex,
+                                                                       int* outLength) {
+    if (bufferIndex == 0) {
+        *outLength = kStateCount * kStateCount;
+        return gEMatrices[eigenIndex];
+    } else if (bufferIndex == 1) {
+        *outLength = kStateCount * kStateCount;
+        return gIMatrices[eigenIndex];
+    }
+    *outLength = kEigenValuesSize;
+    return gEigenValues[eigenIndex];
+}
+
 }
 }
 
@@ -243,6 +243,14 @@ public:
     int getPartials(int bufferIndex,
 				    int scaleIndex,
                     double* outPartials);
+
+    int getBufferLayout(BeagleBufferLayout* returnLayout);
+
+    int setPartialsBuffer(int bufferIndex,
+                          void* inPartials);
+
+    int setTipStatesBuffer(int tipIndex,
+                           int* inStates);
         
     int setEigenDecomposition(int eigenIndex,
                               const double* inEigenVectors,
@@ -404,6 +412,22 @@ public:
     int getSiteDerivatives(double* outFirstDerivatives,
                            double* outSecondDerivatives);
 
+    int setSiteLogLikelihoodsOutput(double* outLogLikelihoods,
+                                    double* outFirstDerivatives,
+                                    double* outSecondDerivatives);
+
+    int setStatisticsEnabled(int enabled);
+
+    int getStatistics(BeagleInstanceStatistics* outStatistics);
+
+    int resetStatistics();
+
+    int saveInstance(const char* fileName);
+
+    int loadInstance(const char* fileName);
+
+    int shareBuffers(BeagleImpl* sourceImpl);
+
 private:
 
     char* getInstanceName();
@@ -1008,6 +1008,24 @@ int BeagleGPUImpl<BEAGLE_GPU_GENERIC>::getPartials(int bufferIndex,
     return BEAGLE_SUCCESS;
 }
 
+BEAGLE_GPU_TEMPLATE
+int BeagleGPUImpl<BEAGLE_GPU_GENERIC>::getBufferLayout(BeagleBufferLayout* returnLayout) {
+    // partials live in device memory, so there is no host layout to expose
+    return BEAGLE_ERROR_NO_IMPLEMENTATION;
+}
+
+BEAGLE_GPU_TEMPLATE
+int BeagleGPUImpl<BEAGLE_GPU_GENERIC>::setPartialsBuffer(int bufferIndex,
+                                                        void* inPartials) {
+    return BEAGLE_ERROR_NO_IMPLEMENTATION;
+}
+
+BEAGLE_GPU_TEMPLATE
+int BeagleGPUImpl<BEAGLE_GPU_GENERIC>::setTipStatesBuffer(int tipIndex,
+                                                         int* inStates) {
+    return BEAGLE_ERROR_NO_IMPLEMENTATION;
+}
+
 BEAGLE_GPU_TEMPLATE
 int BeagleGPUImpl<BEAGLE_GPU_GENERIC>::setEigenDecomposition(int eigenIndex,
                                          const double* inEigenVectors,
@@ -3844,6 +3862,48 @@ int BeagleGPUImpl<BEAGLE_GPU_GENERIC>::getSiteDerivatives(double* outFirstDeriva
     return BEAGLE_SUCCESS;
 }
 
+BEAGLE_GPU_TEMPLATE
+int BeagleGPUImpl<BEAGLE_GPU_GENERIC>::setSiteLogLikelihoodsOutput(double* outLogLikelihoods,
+                                                                  double* outFirstDerivatives,
+                                                                  double* outSecondDerivatives) {
+    // TODO: copy site values to the caller arrays at the end of each integration
+    return BEAGLE_ERROR_NO_IMPLEMENTATION;
+}
+
+BEAGLE_GPU_TEMPLATE
+int BeagleGPUImpl<BEAGLE_GPU_GENERIC>::setStatisticsEnabled(int enabled) {
+    // TODO: time kernel launches with device events
+    return BEAGLE_ERROR_NO_IMPLEMENTATION;
+}
+
+BEAGLE_GPU_TEMPLATE
+int BeagleGPUImpl<BEAGLE_GPU_GENERIC>::getStatistics(BeagleInstanceStatistics* outStatistics) {
+    return BEAGLE_ERROR_NO_IMPLEMENTATION;
+}
+
+BEAGLE_GPU_TEMPLATE
+int BeagleGPUImpl<BEAGLE_GPU_GENERIC>::resetStatistics() {
+    return BEAGLE_ERROR_NO_IMPLEMENTATION;
+}
+
+BEAGLE_GPU_TEMPLATE
+int BeagleGPUImpl<BEAGLE_GPU_GENERIC>::saveInstance(const char* fileName) {
+    // TODO: checkpoint device buffers
+    return BEAGLE_ERROR_NO_IMPLEMENTATION;
+}
+
+BEAGLE_GPU_TEMPLATE
+int BeagleGPUImpl<BEAGLE_GPU_GENERIC>::loadInstance(const char* fileName) {
+    // TODO: restore device buffers
+    return BEAGLE_ERROR_NO_IMPLEMENTATION;
+}
+
+BEAGLE_GPU_TEMPLATE
+int BeagleGPUImpl<BEAGLE_GPU_GENERIC>::shareBuffers(BeagleImpl* sourceImpl) {
+    // TODO: share device buffers between instances on the same device
+    return BEAGLE_ERROR_NO_IMPLEMENTATION;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // BeagleGPUImplFactory public methods
 
@@ -84,11 +84,17 @@ private:
 #elif defined(FW_OPENCL)
     cl_device_id openClDeviceId;             // compute device id 
     cl_context openClContext;                // compute context
-    cl_command_queue* openClCommandQueues;   // compute command queue
-    cl_event* openClEvents;                  // compute events
+    cl_command_queue* openClCommandQueues;   // compute command queues, created as streams are requested
+    cl_event* openClEvents;                  // marker of the latest work on each queue
+    unsigned long* openClQueueWork;          // commands enqueued on each queue
+    unsigned long* openClQueueMarked;        // commands covered by each queue's marker
+    unsigned long* openClQueueWaited;        // [queue][other queue] commands of the other queue already waited for
     cl_program openClProgram;                // compute program
     std::map<int, cl_device_id> openClDeviceMap;
     const char* GetCLErrorDescription(int errorCode);
+    void EnqueueQueueDependency(int queueIndex,
+                                int waitQueueIndex);
+    void PrepareDefaultQueue();
 #endif
 
 public:
@@ -32,6 +32,16 @@
 #include <cstdarg>
 #include <cmath>
 #include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#ifdef _WIN32
+    #include <direct.h>
+    #include <process.h>
+#else
+    #include <unistd.h>
+#endif
 
 #include "libhmsbeagle/beagle.h"
 #include "libhmsbeagle/GPU/GPUImplDefs.h"
@@ -60,8 +70,174 @@
             MULTIPLY_BLOCK_SIZE_##prec##impl3, \
             0,0,0,0);
 
+#define PROGRAM_CACHE_ENV       "BEAGLE_OPENCL_CACHE"           // cache directory, or "off" to always compile from source
+#define PROGRAM_CACHE_DIRECTORY ".beagle-opencl-cache"          // default cache directory, in the home directory
+#define PROGRAM_CACHE_HEADER    "BEAGLE OpenCL program cache 1" // first line; change whenever the file format changes
+
 namespace opencl_device {
 
+/*
+ * Compiled program binaries, keyed by everything that determines the build:
+ * platform, device, driver, kernel source, state count, precision and build
+ * options. Binaries are kept in memory for later instances in this process and
+ * in one file per key for later processes.
+ */
+static std::mutex programCacheMutex;
+static std::map<std::string, std::vector<unsigned char> > programCache;
+
+static unsigned long long HashString(const char* text) {
+    unsigned long long hash = 14695981039346656037ULL;    // 64-bit FNV-1a
+    for (; *text != '\0'; text++) {
+        hash ^= (unsigned char) *text;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static std::string GetProgramCacheKey(cl_device_id deviceId,
+                                      const char* kernelCode,
+                                      int paddedStateCount,
+                                      bool doublePrecision,
+                                      const char* buildDefs) {
+    char info[1024];
+    std::string key;
+    cl_platform_id platform;
+    if (clGetDeviceInfo(deviceId, CL_DEVICE_PLATFORM, sizeof(cl_platform_id), &platform, NULL) == CL_SUCCESS &&
+        clGetPlatformInfo(platform, CL_PLATFORM_NAME, sizeof(info), info, NULL) == CL_SUCCESS)
+        key += info;
+    key += "\t";
+    if (clGetDeviceInfo(deviceId, CL_DEVICE_NAME, sizeof(info), info, NULL) == CL_SUCCESS)
+        key += info;
+    key += "\t";
+    if (clGetDeviceInfo(deviceId, CL_DRIVER_VERSION, sizeof(info), info, NULL) == CL_SUCCESS)
+        key += info;
+    key += "\t";
+    if (clGetDeviceInfo(deviceId, CL_DEVICE_VERSION, sizeof(info), info, NULL) == CL_SUCCESS)
+        key += info;
+
+    char shape[128];
+    snprintf(shape, sizeof(shape), "\t%016llx\t%d\t%s\t", HashString(kernelCode), paddedStateCount,
+             (doublePrecision ? "double" : "single"));
+    key += shape;
+    key += buildDefs;
+
+    for (size_t i = 0; i < key.size(); i++) {
+        if (key[i] == '\n' || key[i] == '\r')
+            key[i] = ' ';
+    }
+    return key;
+}
+
+// returns false if caching on disk is switched off or there is nowhere to keep the files
+static bool GetProgramCachePath(const std::string& key,
+                                std::string& path) {
+    const char* env = getenv(PROGRAM_CACHE_ENV);
+    if (env != NULL && strcmp(env, "off") == 0)
+        return false;
+
+    std::string directory;
+    if (env != NULL && *env != '\0') {
+        directory = env;
+    } else {
+        const char* home = getenv("HOME");
+#ifdef _WIN32
+        if (home == NULL)
+            home = getenv("USERPROFILE");
+#endif
+        if (home == NULL)
+            return false;
+        directory = std::string(home) + "/" + PROGRAM_CACHE_DIRECTORY;
+    }
+#ifdef _WIN32
+    _mkdir(directory.c_str());
+#else
+    mkdir(directory.c_str(), 0755);
+#endif
+
+    char fileName[64];
+    snprintf(fileName, sizeof(fileName), "/%016llx.bin", HashString(key.c_str()));
+    path = directory + fileName;
+    return true;
+}
+
+// {header, key, binary length, binary}
+static bool LoadProgramBinary(const std::string& key,
+                              std::vector<unsigned char>& binary) {
+    std::lock_guard<std::mutex> lock(programCacheMutex);
+    std::map<std::string, std::vector<unsigned char> >::const_iterator cached = programCache.find(key);
+    if (cached != programCache.end()) {
+        binary = cached->second;
+        return true;
+    }
+
+    std::string path;
+    if (!GetProgramCachePath(key, path))
+        return false;
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+        return false;
+
+    bool valid = false;
+    std::vector<char> line(key.size() + 2);
+    unsigned long long length = 0;
+    char header[64];
+    if (fgets(header, sizeof(header), file) != NULL &&
+        strncmp(header, PROGRAM_CACHE_HEADER, strlen(PROGRAM_CACHE_HEADER)) == 0 &&
+        fgets(&line[0], (int) line.size(), file) != NULL &&
+        key + "\n" == &line[0] &&
+        fscanf(file, "%llu", &length) == 1 && fgetc(file) == '\n' && length > 0) {
+        binary.resize((size_t) length);
+        valid = (fread(&binary[0], 1, binary.size(), file) == binary.size());
+    }
+    fclose(file);
+
+    if (valid)
+        programCache[key] = binary;
+    return valid;
+}
+
+static void StoreProgramBinary(const std::string& key,
+                               cl_program program) {
+    size_t length = 0;
+    if (clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(size_t), &length, NULL) != CL_SUCCESS ||
+        length == 0)
+        return;
+    std::vector<unsigned char> binary(length);
+    unsigned char* binaryData = &binary[0];
+    if (clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(unsigned char*), &binaryData, NULL) != CL_SUCCESS)
+        return;
+
+    std::lock_guard<std::mutex> lock(programCacheMutex);
+    programCache[key] = binary;
+
+    std::string path;
+    if (!GetProgramCachePath(key, path))
+        return;
+
+    // written under a temporary name so that concurrent processes never read a partial file
+    char suffix[32];
+#ifdef _WIN32
+    snprintf(suffix, sizeof(suffix), ".%d", _getpid());
+#else
+    snprintf(suffix, sizeof(suffix), ".%d", (int) getpid());
+#endif
+    std::string temporaryPath = path + suffix;
+    FILE* file = fopen(temporaryPath.c_str(), "wb");
+    if (file == NULL)
+        return;
+    bool written = (fprintf(file, "%s\n%s\n%llu\n", PROGRAM_CACHE_HEADER, key.c_str(), (unsigned long long) length) > 0 &&
+                    fwrite(binaryData, 1, length, file) == length);
+    written = (fclose(file) == 0 && written);
+    if (!written || rename(temporaryPath.c_str(), path.c_str()) != 0)
+        remove(temporaryPath.c_str());
+}
+
+static void CL_CALLBACK FreeStagingBuffer(cl_event event,
+                                          cl_int status,
+                                          void* stagingBuffer) {
+    free(stagingBuffer);
+}
+
 GPUInterface::GPUInterface() {    
 #ifdef BEAGLE_DEBUG_FLOW
     fprintf(stderr,"\t\t\tEntering GPUInterface::GPUInterface\n");
@@ -72,7 +248,12 @@ GPUInterface::GPUInterface() {
     openClDeviceId = NULL;
     openClContext = NULL;
     openClCommandQueues = NULL;
+    openClEvents = NULL;
+    openClQueueWork = NULL;
+    openClQueueMarked = NULL;
+    openClQueueWaited = NULL;
     openClProgram = NULL;
+    numStreams = 1;
 
     supportDoublePrecision = true;
     
@@ -93,9 +274,20 @@ GPUInterface::~GPUInterface() {
 
     if (openClCommandQueues != NULL) {
         for (int i=0; i < BEAGLE_STREAM_COUNT; i++) {
-            SAFE_CL(clReleaseCommandQueue(openClCommandQueues[i]));
+            if (openClCommandQueues[i] != NULL)
+                SAFE_CL(clFinish(openClCommandQueues[i]));
+        }
+        for (int i=0; i < BEAGLE_STREAM_COUNT; i++) {
+            if (openClEvents[i] != NULL)
+                SAFE_CL(clReleaseEvent(openClEvents[i]));
+            if (openClCommandQueues[i] != NULL)
+                SAFE_CL(clReleaseCommandQueue(openClCommandQueues[i]));
         }
         free(openClCommandQueues);
+        free(openClEvents);
+        free(openClQueueWork);
+        free(openClQueueMarked);
+        free(openClQueueWaited);
     }
     
     if (openClContext != NULL)
@@ -323,17 +515,18 @@ void GPUInterface::SetDevice(int deviceNumber,
     openClContext = clCreateContext(NULL, 1, &openClDeviceId, NULL, NULL, &err);
     SAFE_CL(err);
     
-    openClCommandQueues = (cl_command_queue*) malloc(sizeof(cl_command_queue) * BEAGLE_STREAM_COUNT);
-    openClEvents = (cl_event*) malloc(sizeof(cl_event) * BEAGLE_STREAM_COUNT);
+    // further queues are created by ResizeStreamCount
+    openClCommandQueues = (cl_command_queue*) calloc(BEAGLE_STREAM_COUNT, sizeof(cl_command_queue));
+    openClEvents = (cl_event*) calloc(BEAGLE_STREAM_COUNT, sizeof(cl_event));
+    openClQueueWork = (unsigned long*) calloc(BEAGLE_STREAM_COUNT, sizeof(unsigned long));
+    openClQueueMarked = (unsigned long*) calloc(BEAGLE_STREAM_COUNT, sizeof(unsigned long));
+    openClQueueWaited = (unsigned long*) calloc(BEAGLE_STREAM_COUNT * BEAGLE_STREAM_COUNT, sizeof(unsigned long));
 
     cl_command_queue_properties queueProperties = 0;//CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
-    for (int i=0; i < BEAGLE_STREAM_COUNT; i++) {
-        openClCommandQueues[i] = clCreateCommandQueue(openClContext, openClDeviceId,
-                                              queueProperties, &err);
-        SAFE_CL(err);
-        openClEvents[i] = clCreateUserEvent(openClContext, &err);
-        SAFE_CL(err);
-    }
+    openClCommandQueues[0] = clCreateCommandQueue(openClContext, openClDeviceId,
+                                                  queueProperties, &err);
+    SAFE_CL(err);
+    numStreams = 1;
 
     InitializeKernelResource(paddedStateCount, flags & BEAGLE_FLAG_PRECISION_DOUBLE);
 
@@ -347,6 +540,30 @@ void GPUInterface::SetDevice(int deviceNumber,
     kernelResource->unpaddedPatternCount = unpaddedPatternCount;
     kernelResource->flags = flags;
 
+    char buildDefs[1024] = "-w -D FW_OPENCL -D OPENCL_KERNEL_BUILD ";
+#ifdef DLS_MACOS
+    strcat(buildDefs, "-D DLS_MACOS ");
+#elif defined(FW_OPENCL_PROFILING)
+	strcat(buildDefs, "-profiling -s \"C:\\developer\\beagle-lib\\project\\beagle-vs-2012\\x64\\Release\\kernels.cl\" ");
+#endif
+
+    BeagleDeviceImplementationCodes deviceCode = GetDeviceImplementationCode(deviceNumber);
+    if (deviceCode == BEAGLE_OPENCL_DEVICE_INTEL_CPU ||
+        deviceCode == BEAGLE_OPENCL_DEVICE_INTEL_MIC ||
+        deviceCode == BEAGLE_OPENCL_DEVICE_AMD_CPU) {
+        strcat(buildDefs, "-D FW_OPENCL_CPU");
+    } else if (deviceCode == BEAGLE_OPENCL_DEVICE_APPLE_CPU) {
+        strcat(buildDefs, "-D FW_OPENCL_CPU -D FW_OPENCL_APPLECPU");
+    } else if (deviceCode == BEAGLE_OPENCL_DEVICE_AMD_GPU) {
+        strcat(buildDefs, "-D FW_OPENCL_AMDGPU");
+    } else if (deviceCode == BEAGLE_OPENCL_DEVICE_APPLE_AMD_GPU) {
+        strcat(buildDefs, "-D FW_OPENCL_AMDGPU -D FW_OPENCL_APPLEAMDGPU");
+    }  else if (deviceCode == BEAGLE_OPENCL_DEVICE_APPLE_INTEL_GPU) {
+        strcat(buildDefs, "-D FW_OPENCL_INTELGPU -D FW_OPENCL_APPLEINTELGPU");
+    }
+
+    bool programFromCache = false;
+
 #if defined(FW_OPENCL_BINARY) || defined(FW_OPENCL_PROFILING)
     //=========================================================================================================
     FILE *fp = NULL;
@@ -390,9 +607,30 @@ void GPUInterface::SetDevice(int deviceNumber,
     #endif
 	//=========================================================================================================
 #else
-	openClProgram = clCreateProgramWithSource(openClContext, 1,
-		                                      (const char**) &kernelResource->kernelCode, NULL,
-		                                      &err);
+    // a cached binary still needs clBuildProgram, but that only links it
+    std::string programCacheKey = GetProgramCacheKey(openClDeviceId, kernelResource->kernelCode, paddedStateCount,
+                                                     flags & BEAGLE_FLAG_PRECISION_DOUBLE, buildDefs);
+    std::vector<unsigned char> programBinary;
+    if (LoadProgramBinary(programCacheKey, programBinary)) {
+        const unsigned char* binaryData = &programBinary[0];
+        size_t binaryLength = programBinary.size();
+        cl_int binaryStatus;
+        openClProgram = clCreateProgramWithBinary(openClContext, 1, &openClDeviceId, &binaryLength,
+                                                  &binaryData, &binaryStatus, &err);
+        if (err == CL_SUCCESS && binaryStatus == CL_SUCCESS &&
+            clBuildProgram(openClProgram, 0, NULL, buildDefs, NULL, NULL) == CL_SUCCESS) {
+            programFromCache = true;
+        } else if (openClProgram != NULL) {
+            clReleaseProgram(openClProgram);
+            openClProgram = NULL;
+        }
+    }
+
+    if (!programFromCache) {
+        openClProgram = clCreateProgramWithSource(openClContext, 1,
+                                                  (const char**) &kernelResource->kernelCode, NULL,
+                                                  &err);
+    }
 #endif
 
     SAFE_CL(err);
@@ -401,29 +639,9 @@ void GPUInterface::SetDevice(int deviceNumber,
         exit(-1);
     }
 
-    char buildDefs[1024] = "-w -D FW_OPENCL -D OPENCL_KERNEL_BUILD ";
-#ifdef DLS_MACOS
-    strcat(buildDefs, "-D DLS_MACOS ");
-#elif defined(FW_OPENCL_PROFILING)
-	strcat(buildDefs, "-profiling -s \"C:\\developer\\beagle-lib\\project\\beagle-vs-2012\\x64\\Release\\kernels.cl\" ");
-#endif
-
-    BeagleDeviceImplementationCodes deviceCode = GetDeviceImplementationCode(deviceNumber);
-    if (deviceCode == BEAGLE_OPENCL_DEVICE_INTEL_CPU ||
-        deviceCode == BEAGLE_OPENCL_DEVICE_INTEL_MIC ||
-        deviceCode == BEAGLE_OPENCL_DEVICE_AMD_CPU) {
-        strcat(buildDefs, "-D FW_OPENCL_CPU");
-    } else if (deviceCode == BEAGLE_OPENCL_DEVICE_APPLE_CPU) {
-        strcat(buildDefs, "-D FW_OPENCL_CPU -D FW_OPENCL_APPLECPU");
-    } else if (deviceCode == BEAGLE_OPENCL_DEVICE_AMD_GPU) {
-        strcat(buildDefs, "-D FW_OPENCL_AMDGPU");
-    } else if (deviceCode == BEAGLE_OPENCL_DEVICE_APPLE_AMD_GPU) {
-        strcat(buildDefs, "-D FW_OPENCL_AMDGPU -D FW_OPENCL_APPLEAMDGPU");
-    }  else if (deviceCode == BEAGLE_OPENCL_DEVICE_APPLE_INTEL_GPU) {
-        strcat(buildDefs, "-D FW_OPENCL_INTELGPU -D FW_OPENCL_APPLEINTELGPU");
+    if (!programFromCache) {
+        err = clBuildProgram(openClProgram, 0, NULL, buildDefs, NULL, NULL);
     }
-
-    err = clBuildProgram(openClProgram, 0, NULL, buildDefs, NULL, NULL);
     if (err != CL_SUCCESS) {
         size_t len;
         char buffer[16384];
@@ -438,6 +656,11 @@ void GPUInterface::SetDevice(int deviceNumber,
         exit(-1);
     }
 
+#if !defined(FW_OPENCL_BINARY) && !defined(FW_OPENCL_PROFILING)
+    if (!programFromCache)
+        StoreProgramBinary(programCacheKey, openClProgram);
+#endif
+
 // TODO unloading compiler to free resources is causing seg fault for Intel and NVIDIA platforms
 // #ifdef CL_VERSION_1_2
 //     cl_platform_id platform;
@@ -456,22 +679,87 @@ void GPUInterface::ResizeStreamCount(int newStreamCount) {
 #ifdef BEAGLE_DEBUG_FLOW
     fprintf(stderr,"\t\t\tEntering GPUInterface::ResizeStreamCount\n");
 #endif                
-    
-    // TODO: write function if using more than one opencl queue
+
+    // independent operations only go to separate queues if streams were asked for
+    if (!(kernelResource->flags & BEAGLE_FLAG_PARALLELOPS_STREAMS))
+        newStreamCount = 1;
+    if (newStreamCount > BEAGLE_STREAM_COUNT)
+        newStreamCount = BEAGLE_STREAM_COUNT;
+    if (newStreamCount < 1)
+        newStreamCount = 1;
+
+    // queues beyond the new count are kept, but joined so no work on them is left unordered
+    SynchronizeDevice();
+
+    int err;
+    for (int i=numStreams; i < newStreamCount; i++) {
+        if (openClCommandQueues[i] == NULL) {
+            openClCommandQueues[i] = clCreateCommandQueue(openClContext, openClDeviceId, 0, &err);
+            SAFE_CL(err);
+        }
+    }
+    numStreams = newStreamCount;
     
 #ifdef BEAGLE_DEBUG_FLOW
     fprintf(stderr,"\t\t\tLeaving  GPUInterface::ResizeStreamCount\n");
 #endif                
 }
 
+/*
+ * Queues are in order, but there is no ordering between queues. Before work is
+ * enqueued on one queue it is made to wait, on the device, for everything
+ * enqueued so far on the queues it depends on: a marker event is taken on the
+ * other queue and a barrier on that event is enqueued. Nothing is enqueued if
+ * the dependency is already covered.
+ */
+void GPUInterface::EnqueueQueueDependency(int queueIndex,
+                                          int waitQueueIndex) {
+    if (queueIndex == waitQueueIndex || openClCommandQueues[waitQueueIndex] == NULL)
+        return;
+
+    unsigned long& waited = openClQueueWaited[queueIndex * BEAGLE_STREAM_COUNT + waitQueueIndex];
+    if (waited == openClQueueWork[waitQueueIndex])
+        return;
+
+    if (openClQueueMarked[waitQueueIndex] != openClQueueWork[waitQueueIndex]) {
+        if (openClEvents[waitQueueIndex] != NULL)
+            SAFE_CL(clReleaseEvent(openClEvents[waitQueueIndex]));
+#ifdef CL_VERSION_1_2
+        SAFE_CL(clEnqueueMarkerWithWaitList(openClCommandQueues[waitQueueIndex], 0, NULL,
+                                            &openClEvents[waitQueueIndex]));
+#else
+        SAFE_CL(clEnqueueMarker(openClCommandQueues[waitQueueIndex], &openClEvents[waitQueueIndex]));
+#endif
+        openClQueueMarked[waitQueueIndex] = openClQueueWork[waitQueueIndex];
+    }
+
+#ifdef CL_VERSION_1_2
+    SAFE_CL(clEnqueueBarrierWithWaitList(openClCommandQueues[queueIndex], 1,
+                                         &openClEvents[waitQueueIndex], NULL));
+#else
+    SAFE_CL(clEnqueueWaitForEvents(openClCommandQueues[queueIndex], 1, &openClEvents[waitQueueIndex]));
+#endif
+    waited = openClQueueMarked[waitQueueIndex];
+
+    // counted as work, so that queues waiting on this one also wait on its dependencies
+    openClQueueWork[queueIndex]++;
+}
+
+// work on the default queue follows all work on the stream queues
+void GPUInterface::PrepareDefaultQueue() {
+    for (int i=1; i < numStreams; i++) {
+        EnqueueQueueDependency(0, i);
+    }
+}
+
 void GPUInterface::SynchronizeHost() {
 #ifdef BEAGLE_DEBUG_FLOW
     fprintf(stderr,"\t\t\tEntering GPUInterface::SynchronizeHost\n");
 #endif                
     
-    // for(int i=0; i<BEAGLE_STREAM_COUNT; i++) {
-    //     SAFE_CL(clFinish(openClCommandQueues[i]));
-    // }
+    for(int i=1; i<numStreams; i++) {
+        SAFE_CL(clFinish(openClCommandQueues[i]));
+    }
 
     SAFE_CL(clFinish(openClCommandQueues[0]));
     
@@ -485,9 +773,7 @@ void GPUInterface::SynchronizeDevice() {
     fprintf(stderr,"\t\t\tEntering GPUInterface::SynchronizeDevice\n");
 #endif                
 
-    // TODO: synchronize on device only
-
-    // SAFE_CL(clFinish(openClCommandQueues[0]));
+    PrepareDefaultQueue();
     
 #ifdef BEAGLE_DEBUG_FLOW
     fprintf(stderr,"\t\t\tLeaving  GPUInterface::SynchronizeDevice\n");
@@ -499,9 +785,9 @@ void GPUInterface::SynchronizeDeviceWithIndex(int streamRecordIndex, int streamW
     fprintf(stderr,"\t\t\tEntering GPUInterface::SynchronizeDeviceWithIndex\n");
 #endif                
 
-    // TODO: synchronize on device only
-
-    // SAFE_CL(clFinish(openClCommandQueues[0]));
+    int recordQueue = (streamRecordIndex >= 0 ? streamRecordIndex % numStreams : 0);
+    int waitQueue   = (streamWaitIndex   >= 0 ? streamWaitIndex   % numStreams : 0);
+    EnqueueQueueDependency(waitQueue, recordQueue);
     
 #ifdef BEAGLE_DEBUG_FLOW
     fprintf(stderr,"\t\t\tLeaving  GPUInterface::SynchronizeDeviceWithIndex\n");
@@ -576,6 +862,8 @@ void GPUInterface::LaunchKernel(GPUFunction deviceFunction,
     printf("local = %lu\n\n", local);
 #endif
 
+    PrepareDefaultQueue();
+
     if (globalWorkSize[1] == 1 && globalWorkSize[2] == 1) {
         SAFE_CL(clEnqueueNDRangeKernel(openClCommandQueues[0], deviceFunction, 1, NULL,
                                        globalWorkSize, localWorkSize, 0, NULL, NULL));
@@ -586,6 +874,7 @@ void GPUInterface::LaunchKernel(GPUFunction deviceFunction,
         SAFE_CL(clEnqueueNDRangeKernel(openClCommandQueues[0], deviceFunction, 3, NULL,
                                        globalWorkSize, localWorkSize, 0, NULL, NULL));
     }
+    openClQueueWork[0]++;
 
 #ifdef BEAGLE_DEBUG_FLOW
     fprintf(stderr,"\t\t\tLeaving  GPUInterface::LaunchKernel\n");
@@ -646,45 +935,21 @@ void GPUInterface::LaunchKernelConcurrent(GPUFunction deviceFunction,
         dims = 2;
     }
      
-    // if (streamIndex != -1) {
-    //     streamIndex /= 2;
-    //     // if (waitIndex != -1) {
-    //     //     SAFE_CL(clFinish(openClCommandQueues[streamIndex % BEAGLE_STREAM_COUNT]));
-    //     //     return;
-    //     // }
-
-    //     int streamIndexMod = streamIndex % BEAGLE_STREAM_COUNT;
-
-    //     cl_command_queue commandQueue;
-    //     commandQueue = openClCommandQueues[streamIndexMod];
-
-    //     // printf("streamIndexMod:  %d; waitIndexMod %d\n",
-    //     //        streamIndexMod, waitIndex % BEAGLE_STREAM_COUNT);
-
-    //     if (waitIndex != -1) {
-    //         waitIndex /= 2;
-    //         int waitIndexMod = waitIndex % BEAGLE_STREAM_COUNT;
-    //         // SAFE_CL(clFinish(openClCommandQueues[waitIndexMod]));
-    //         SAFE_CL(clEnqueueBarrierWithWaitList(commandQueue, 1, &openClEvents[waitIndexMod], NULL));
-    //         // SAFE_CL(clWaitForEvents(1, &openClEvents[waitIndexMod]));
-    //     } else if (streamIndex==0) {
-    //         SAFE_CL(clFinish(commandQueue)); // unclear why this is needed for OpenCL CPU
-    //     }
-
-    //     SAFE_CL(clEnqueueNDRangeKernel(commandQueue, deviceFunction, dims, NULL,
-    //                                    globalWorkSize, localWorkSize,
-    //                                    0, NULL, &openClEvents[streamIndexMod]));
-
-    //     // SAFE_CL(clEnqueueNDRangeKernel(commandQueue, deviceFunction, dims, NULL,
-    //     //                                globalWorkSize, localWorkSize,
-    //     //                                0, NULL, NULL));
-    //     // SAFE_CL(clEnqueueBarrierWithWaitList(commandQueue, 0, NULL, &openClEvents[streamIndexMod]));
-
-    // } else {
-        SAFE_CL(clEnqueueNDRangeKernel(openClCommandQueues[0], deviceFunction, dims, NULL,
-                                       globalWorkSize, localWorkSize,
-                                       0, NULL, NULL));
-    // }
+    // a kernel on a stream queue follows the default queue and the queue it waits for
+    int queueIndex = 0;
+    if (streamIndex >= 0) {
+        queueIndex = streamIndex % numStreams;
+        EnqueueQueueDependency(queueIndex, 0);
+        if (waitIndex >= 0)
+            EnqueueQueueDependency(queueIndex, waitIndex % numStreams);
+    }
+    if (queueIndex == 0)
+        PrepareDefaultQueue();
+
+    SAFE_CL(clEnqueueNDRangeKernel(openClCommandQueues[queueIndex], deviceFunction, dims, NULL,
+                                   globalWorkSize, localWorkSize,
+                                   0, NULL, NULL));
+    openClQueueWork[queueIndex]++;
 #ifdef BEAGLE_DEBUG_FLOW
     fprintf(stderr,"\t\t\tLeaving  GPUInterface::LaunchKernel\n");
 #endif                
@@ -755,6 +1020,8 @@ void* GPUInterface::AllocatePinnedHostMemory(size_t memSize, bool writeCombined,
 }
 
 void* GPUInterface::MapMemory(GPUPtr dPtr, size_t memSize) {
+    PrepareDefaultQueue();
+
     int err;
     void* hostPtr = clEnqueueMapBuffer(openClCommandQueues[0], dPtr, CL_TRUE,
                                         CL_MAP_WRITE_INVALIDATE_REGION, 0, memSize, 0, NULL, NULL, &err);
@@ -769,6 +1036,7 @@ void GPUInterface::UnmapMemory(GPUPtr dPtr, void* hPtr) {
 #endif
 
     SAFE_CL(clEnqueueUnmapMemObject(openClCommandQueues[0], dPtr, hPtr, 0, NULL, NULL));
+    openClQueueWork[0]++;
 
 #ifdef BEAGLE_DEBUG_FLOW
     fprintf(stderr,"\t\t\tLeaving GPUInterface::UnmapMemory\n");
@@ -920,8 +1188,23 @@ void GPUInterface::MemcpyHostToDevice(GPUPtr dest,
     fprintf(stderr, "\t\t\tEntering GPUInterface::MemcpyHostToDevice\n");
 #endif    
     
-    SAFE_CL(clEnqueueWriteBuffer(openClCommandQueues[0], dest, CL_TRUE, 0, memSize, src, 0,
-                                 NULL, NULL));
+    // the source is copied to a staging buffer so that the caller may reuse it at once;
+    // the buffer is freed when the transfer completes
+    PrepareDefaultQueue();
+
+    void* stagingBuffer = malloc(memSize);
+    if (stagingBuffer == NULL) {
+        SAFE_CL(clEnqueueWriteBuffer(openClCommandQueues[0], dest, CL_TRUE, 0, memSize, src, 0,
+                                     NULL, NULL));
+    } else {
+        memcpy(stagingBuffer, src, memSize);
+        cl_event transferEvent;
+        SAFE_CL(clEnqueueWriteBuffer(openClCommandQueues[0], dest, CL_FALSE, 0, memSize, stagingBuffer, 0,
+                                     NULL, &transferEvent));
+        SAFE_CL(clSetEventCallback(transferEvent, CL_COMPLETE, FreeStagingBuffer, stagingBuffer));
+        SAFE_CL(clReleaseEvent(transferEvent));
+    }
+    openClQueueWork[0]++;
     
 #ifdef BEAGLE_DEBUG_FLOW
     fprintf(stderr, "\t\t\tLeaving  GPUInterface::MemcpyHostToDevice\n");
@@ -935,8 +1218,12 @@ void GPUInterface::MemcpyDeviceToHost(void* dest,
     fprintf(stderr, "\t\t\tEntering GPUInterface::MemcpyDeviceToHost\n");
 #endif        
     
+    // blocking, as the caller reads the result at once, but only on the work it depends on
+    PrepareDefaultQueue();
+
     SAFE_CL(clEnqueueReadBuffer(openClCommandQueues[0], src, CL_TRUE, 0, memSize, dest, 0,
                                 NULL, NULL));
+    openClQueueWork[0]++;
     
 #ifdef BEAGLE_DEBUG_FLOW
     fprintf(stderr, "\t\t\tLeaving  GPUInterface::MemcpyDeviceToHost\n");
@@ -952,8 +1239,11 @@ void GPUInterface::MemcpyDeviceToDevice(GPUPtr dest,
     fprintf(stderr, "\t\t\tEntering GPUInterface::MemcpyDeviceToDevice\n");
 #endif    
 
+    PrepareDefaultQueue();
+
     SAFE_CL(clEnqueueCopyBuffer(openClCommandQueues[0], src, dest, 0, 0, memSize, 0,
                                  NULL, NULL));
+    openClQueueWork[0]++;
     
 #ifdef BEAGLE_DEBUG_FLOW
     fprintf(stderr, "\t\t\tLeaving  GPUInterface::MemcpyDeviceToDevice\n");
@@ -0,0 +1,127 @@
+/*
+ *  IncrementalTree.cpp
+ *  Tree-aware dirty tracking for incremental partials updates
+ *
+ * Copyright 2009 Phylogenetic Likelihood Working Group
+ *
+ * This file is part of BEAGLE.
+ *
+ * BEAGLE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * BEAGLE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BEAGLE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include "libhmsbeagle/IncrementalTree.h"
+
+namespace beagle {
+
+IncrementalTree::IncrementalTree() {
+    cumulativeScaleIndex = BEAGLE_OP_NONE;
+    allDirty = true;
+}
+
+int IncrementalTree::setTree(const BeagleOperation* inOperations,
+                             int operationCount,
+                             int inCumulativeScaleIndex) {
+    if (operationCount < 0 || (operationCount > 0 && inOperations == NULL))
+        return BEAGLE_ERROR_OUT_OF_RANGE;
+
+    operations.assign(inOperations, inOperations + operationCount);
+    cumulativeScaleIndex = inCumulativeScaleIndex;
+    invalidateAll();
+
+    return BEAGLE_SUCCESS;
+}
+
+void IncrementalTree::invalidatePartials(const int* bufferIndices,
+                                         int count) {
+    if (bufferIndices == NULL)
+        return;
+    dirtyPartials.insert(bufferIndices, bufferIndices + count);
+}
+
+void IncrementalTree::invalidateTransitionMatrices(const int* matrixIndices,
+                                                   int count) {
+    if (matrixIndices == NULL)
+        return;
+    dirtyMatrices.insert(matrixIndices, matrixIndices + count);
+}
+
+void IncrementalTree::invalidateAll() {
+    allDirty = true;
+    dirtyPartials.clear();
+    dirtyMatrices.clear();
+}
+
+int IncrementalTree::update(BeagleImpl* impl) {
+    // operations are in post-order, so a single pass marks every ancestor
+    // of a changed buffer or matrix
+    std::vector<BeagleOperation> updateOperations;
+    std::vector<int> scaleIndices;
+    std::set<int> changedPartials(dirtyPartials);
+
+    for (size_t i = 0; i < operations.size(); i++) {
+        const BeagleOperation& op = operations[i];
+        if (allDirty ||
+            changedPartials.count(op.child1Partials) ||
+            changedPartials.count(op.child2Partials) ||
+            dirtyMatrices.count(op.child1TransitionMatrix) ||
+            dirtyMatrices.count(op.child2TransitionMatrix)) {
+            updateOperations.push_back(op);
+            changedPartials.insert(op.destinationPartials);
+            if (op.destinationScaleWrite != BEAGLE_OP_NONE)
+                scaleIndices.push_back(op.destinationScaleWrite);
+        }
+    }
+
+    int operationCount = updateOperations.size();
+    int scaleCount = scaleIndices.size();
+    bool fullUpdate = allDirty;
+
+    // on failure the cached partials and scale factors are in an unknown state
+    allDirty = true;
+    dirtyPartials.clear();
+    dirtyMatrices.clear();
+
+    if (operationCount == 0) {
+        allDirty = false;
+        return 0;
+    }
+
+    int returnCode = BEAGLE_SUCCESS;
+    if (cumulativeScaleIndex != BEAGLE_OP_NONE) {
+        // scale factors of unchanged nodes stay in the cumulative buffer
+        if (fullUpdate)
+            returnCode = impl->resetScaleFactors(cumulativeScaleIndex);
+        else if (scaleCount > 0)
+            returnCode = impl->removeScaleFactors(&scaleIndices[0], scaleCount, cumulativeScaleIndex);
+        if (returnCode != BEAGLE_SUCCESS)
+            return returnCode;
+    }
+
+    returnCode = impl->updatePartials((const int*) &updateOperations[0], operationCount, BEAGLE_OP_NONE);
+    if (returnCode != BEAGLE_SUCCESS)
+        return returnCode;
+
+    if (cumulativeScaleIndex != BEAGLE_OP_NONE && scaleCount > 0) {
+        returnCode = impl->accumulateScaleFactors(&scaleIndices[0], scaleCount, cumulativeScaleIndex);
+        if (returnCode != BEAGLE_SUCCESS)
+            return returnCode;
+    }
+
+    allDirty = false;
+
+    return operationCount;
+}
+
+}   // end namespace beagle
@@ -0,0 +1,72 @@
+/*
+ *  IncrementalTree.h
+ *  Tree-aware dirty tracking for incremental partials updates
+ *
+ * Copyright 2009 Phylogenetic Likelihood Working Group
+ *
+ * This file is part of BEAGLE.
+ *
+ * BEAGLE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * BEAGLE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BEAGLE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __beagle_incremental_tree__
+#define __beagle_incremental_tree__
+
+#include <cstddef>
+#include <set>
+#include <vector>
+
+#include "libhmsbeagle/beagle.h"
+#include "libhmsbeagle/BeagleImpl.h"
+
+namespace beagle {
+
+/*
+ * Holds the post-order operations of a tree for one instance and the set of
+ * partials buffers and transition matrices that changed since the last update,
+ * so that only the operations on paths from changed buffers to the root are
+ * recomputed.
+ */
+class IncrementalTree {
+public:
+    IncrementalTree();
+
+    int setTree(const BeagleOperation* operations,
+                int operationCount,
+                int cumulativeScaleIndex);
+
+    void invalidatePartials(const int* bufferIndices,
+                            int count);
+
+    void invalidateTransitionMatrices(const int* matrixIndices,
+                                      int count);
+
+    void invalidateAll();
+
+    // returns the number of operations recomputed, or an error code
+    int update(BeagleImpl* impl);
+
+private:
+    std::vector<BeagleOperation> operations;
+    int cumulativeScaleIndex;
+    bool allDirty;
+
+    std::set<int> dirtyPartials;
+    std::set<int> dirtyMatrices;
+};
+
+}   // end namespace beagle
+
+#endif // __beagle_incremental_tree__
@@ -0,0 +1,145 @@
+/*
+ *  InstanceStatistics.h
+ *  Runtime profiling counters of an instance
+ *
+ * Copyright 2009 Phylogenetic Likelihood Working Group
+ *
+ * This file is part of BEAGLE.
+ *
+ * BEAGLE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * BEAGLE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BEAGLE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __beagle_instance_statistics__
+#define __beagle_instance_statistics__
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+
+#include "libhmsbeagle/beagle.h"
+#include "libhmsbeagle/TraceRecorder.h"
+
+namespace beagle {
+
+inline const char* getKernelName(int kernel) {
+    static const char* names[BEAGLE_STATISTICS_KERNEL_COUNT] = {
+        "statesStates", "statesPartials", "partialsPartials", "rescale",
+        "matrixUpdate", "rootIntegration", "edgeIntegration"
+    };
+    return names[kernel];
+}
+
+/*
+ * Per-instance kernel counters. Collection is switched on and off at runtime;
+ * when off, the only cost to callers is the isEnabled() check. Counters may be
+ * updated from worker threads, so updates are serialized.
+ */
+class InstanceStatistics {
+public:
+    InstanceStatistics() : enabled(false) {
+        reset();
+    }
+
+    void setEnabled(bool inEnabled) {
+        enabled.store(inEnabled, std::memory_order_relaxed);
+    }
+
+    bool isEnabled() const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    // wall-clock time in seconds from an arbitrary origin
+    static double getTime() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void addKernel(int kernel,
+                   double time,
+                   long long patterns,
+                   long long bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        BeagleKernelStatistics& counters = statistics.kernels[kernel];
+        counters.calls++;
+        counters.time += time;
+        counters.patterns += patterns;
+        counters.bytes += bytes;
+    }
+
+    void addThreadIdleTime(double time) {
+        std::lock_guard<std::mutex> lock(mutex);
+        statistics.threadIdleTime += time;
+    }
+
+    void addThreadWaitTime(double time) {
+        std::lock_guard<std::mutex> lock(mutex);
+        statistics.threadWaitTime += time;
+    }
+
+    void get(BeagleInstanceStatistics* outStatistics) {
+        std::lock_guard<std::mutex> lock(mutex);
+        *outStatistics = statistics;
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex);
+        memset(&statistics, 0, sizeof(BeagleInstanceStatistics));
+    }
+
+private:
+    std::atomic<bool> enabled;
+    std::mutex mutex;
+    BeagleInstanceStatistics statistics;
+};
+
+/*
+ * Adds the time from construction to destruction to the counters of one kernel
+ * family if collection was enabled at construction, and records it as a trace
+ * event if a recorder is given.
+ */
+class ScopedKernelTimer {
+public:
+    ScopedKernelTimer(InstanceStatistics& inStatistics,
+                      TraceRecorder* inRecorder,
+                      int inInstance,
+                      int inKernel,
+                      long long inPatterns,
+                      long long inBytes)
+    : trace(inRecorder, getKernelName(inKernel), "kernel", inInstance) {
+        statistics = (inStatistics.isEnabled() ? &inStatistics : NULL);
+        kernel = inKernel;
+        patterns = inPatterns;
+        bytes = inBytes;
+        startTime = (statistics != NULL ? InstanceStatistics::getTime() : 0.0);
+    }
+
+    ~ScopedKernelTimer() {
+        if (statistics != NULL)
+            statistics->addKernel(kernel, InstanceStatistics::getTime() - startTime, patterns, bytes);
+    }
+
+private:
+    TraceScope trace;
+    InstanceStatistics* statistics;
+    int kernel;
+    long long patterns;
+    long long bytes;
+    double startTime;
+};
+
+}   // end namespace beagle
+
+#endif // __beagle_instance_statistics__
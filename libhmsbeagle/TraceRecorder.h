@@ -0,0 +1,213 @@
+/*
+ *  TraceRecorder.h
+ *  Timeline of library activity in Chrome trace format
+ *
+ * Copyright 2009 Phylogenetic Likelihood Working Group
+ *
+ * This file is part of BEAGLE.
+ *
+ * BEAGLE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * BEAGLE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BEAGLE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __beagle_trace_recorder__
+#define __beagle_trace_recorder__
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include "libhmsbeagle/beagle.h"
+
+#define BEAGLE_TRACE_ENV            "BEAGLE_TRACE"  // path of the trace file; tracing is off if unset
+#define BEAGLE_TRACE_MAX_THREADS    256             // events of further threads are dropped
+#define BEAGLE_TRACE_RING_SIZE      (1 << 16)       // events kept per thread, oldest are overwritten
+
+namespace beagle {
+
+struct TraceEvent {
+    const char* name;       // must outlive the recorder, normally a string literal
+    const char* category;
+    long long start;        // nanoseconds since the recorder was created
+    long long duration;
+    int instance;
+    int partition;
+    int operation;
+};
+
+/*
+ * Records complete (begin and duration) events into one ring buffer per
+ * thread and writes them as Chrome trace JSON, viewable in chrome://tracing or
+ * Perfetto. Recording is lock-free: each thread claims its own ring on first use
+ * and is the only writer to it. Everything is inline, so that plugins record
+ * through the pointer handed to them by the library without linking against it.
+ */
+class TraceRecorder {
+public:
+    TraceRecorder(const char* inFileName) {
+        fileName = inFileName;
+        origin = std::chrono::steady_clock::now();
+        recorderId = origin.time_since_epoch().count();
+        ringCount.store(0);
+        for (int i = 0; i < BEAGLE_TRACE_MAX_THREADS; i++)
+            rings[i].events.store(NULL);
+    }
+
+    ~TraceRecorder() {
+        for (int i = 0; i < BEAGLE_TRACE_MAX_THREADS; i++)
+            delete[] rings[i].events.load();
+    }
+
+    long long getTime() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - origin).count();
+    }
+
+    void record(const char* name,
+                const char* category,
+                long long start,
+                int instance,
+                int partition,
+                int operation) {
+        long long end = getTime();
+        TraceRing* ring = getRing();
+        if (ring == NULL)
+            return;
+        TraceEvent* events = ring->events.load(std::memory_order_relaxed);
+        unsigned long long index = ring->count.load(std::memory_order_relaxed);
+        TraceEvent& event = events[index % BEAGLE_TRACE_RING_SIZE];
+        event.name = name;
+        event.category = category;
+        event.start = start;
+        event.duration = end - start;
+        event.instance = instance;
+        event.partition = partition;
+        event.operation = operation;
+        ring->count.store(index + 1, std::memory_order_release);
+    }
+
+    // writes all events kept so far, returns an error code
+    int write() {
+        FILE* file = fopen(fileName.c_str(), "w");
+        if (file == NULL)
+            return BEAGLE_ERROR_GENERAL;
+
+        fprintf(file, "{\"traceEvents\":[\n");
+        bool first = true;
+        int claimed = ringCount.load(std::memory_order_acquire);
+        if (claimed > BEAGLE_TRACE_MAX_THREADS)
+            claimed = BEAGLE_TRACE_MAX_THREADS;
+        for (int r = 0; r < claimed; r++) {
+            TraceRing& ring = rings[r];
+            TraceEvent* events = ring.events.load(std::memory_order_acquire);
+            if (events == NULL)
+                continue;
+            unsigned long long count = ring.count.load(std::memory_order_acquire);
+            unsigned long long begin = (count > BEAGLE_TRACE_RING_SIZE ? count - BEAGLE_TRACE_RING_SIZE : 0);
+            for (unsigned long long i = begin; i < count; i++) {
+                const TraceEvent& event = events[i % BEAGLE_TRACE_RING_SIZE];
+                fprintf(file, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                              "\"pid\":0,\"tid\":%u,\"args\":{\"instance\":%d",
+                        (first ? "" : ",\n"), event.name, event.category,
+                        event.start / 1000.0, event.duration / 1000.0, ring.threadId, event.instance);
+                if (event.partition >= 0)
+                    fprintf(file, ",\"partition\":%d", event.partition);
+                if (event.operation >= 0)
+                    fprintf(file, ",\"operation\":%d", event.operation);
+                fprintf(file, "}}");
+                first = false;
+            }
+        }
+        fprintf(file, "\n],\"displayTimeUnit\":\"ns\"}\n");
+
+        return (fclose(file) == 0 ? BEAGLE_SUCCESS : BEAGLE_ERROR_GENERAL);
+    }
+
+private:
+    struct TraceRing {
+        std::atomic<TraceEvent*> events;
+        std::atomic<unsigned long long> count;
+        unsigned int threadId;
+    };
+
+    TraceRing* getRing() {
+        // one ring per thread and recorder; a thread that records from several
+        // modules may own one ring per module, which share its thread id
+        static thread_local long long cachedRecorderId = 0;
+        static thread_local TraceRing* cachedRing = NULL;
+        if (cachedRecorderId == recorderId)
+            return cachedRing;
+
+        int index = ringCount.fetch_add(1);
+        TraceRing* ring = NULL;
+        if (index < BEAGLE_TRACE_MAX_THREADS) {
+            ring = &rings[index];
+            ring->threadId = (unsigned int) std::hash<std::thread::id>()(std::this_thread::get_id());
+            ring->count.store(0, std::memory_order_relaxed);
+            ring->events.store(new TraceEvent[BEAGLE_TRACE_RING_SIZE], std::memory_order_release);
+        }
+        cachedRecorderId = recorderId;
+        cachedRing = ring;
+        return ring;
+    }
+
+    std::string fileName;
+    std::chrono::steady_clock::time_point origin;
+    long long recorderId;
+    std::atomic<int> ringCount;
+    TraceRing rings[BEAGLE_TRACE_MAX_THREADS];
+};
+
+/*
+ * Records one event covering its own lifetime, if a recorder is given.
+ */
+class TraceScope {
+public:
+    TraceScope(TraceRecorder* inRecorder,
+               const char* inName,
+               const char* inCategory,
+               int inInstance,
+               int inPartition = -1,
+               int inOperation = -1) {
+        recorder = inRecorder;
+        name = inName;
+        category = inCategory;
+        instance = inInstance;
+        partition = inPartition;
+        operation = inOperation;
+        start = (recorder != NULL ? recorder->getTime() : 0);
+    }
+
+    ~TraceScope() {
+        if (recorder != NULL)
+            recorder->record(name, category, start, instance, partition, operation);
+    }
+
+private:
+    TraceRecorder* recorder;
+    const char* name;
+    const char* category;
+    int instance;
+    int partition;
+    int operation;
+    long long start;
+};
+
+}   // end namespace beagle
+
+#endif // __beagle_trace_recorder__
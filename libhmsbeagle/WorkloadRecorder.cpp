@@ -0,0 +1,247 @@
+/*
+ *  WorkloadRecorder.cpp
+ *  Binary log of the API call stream of a client, for offline replay
+ *
+ * Copyright 2009 Phylogenetic Likelihood Working Group
+ *
+ * This file is part of BEAGLE.
+ *
+ * BEAGLE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * BEAGLE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BEAGLE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include "libhmsbeagle/beagle.h"
+#include "libhmsbeagle/WorkloadRecorder.h"
+
+namespace beagle {
+
+const char* getWorkloadCallName(int call) {
+    static const char* names[WORKLOAD_CALL_COUNT] = {
+        "createInstance", "finalizeInstance", "cloneInstance", "setCPUThreadCount",
+        "setTipStates", "setTipPartials", "setPartials", "getPartials",
+        "setEigenDecomposition", "setStateFrequencies", "setCategoryWeights",
+        "setPatternWeights", "setPatternPartitions", "setCategoryRates",
+        "setCategoryRatesWithIndex", "setTransitionMatrix", "setTransitionMatrices",
+        "getTransitionMatrix", "convolveTransitionMatrices", "updateTransitionMatrices",
+        "updateTransitionMatricesWithModelCategories", "updateTransitionMatricesWithMultipleModels",
+        "updatePartials", "updatePartialsByPartition", "setTree", "invalidatePartials",
+        "invalidateTransitionMatrices", "updateTree", "waitForPartials",
+        "accumulateScaleFactors", "accumulateScaleFactorsByPartition",
+        "removeScaleFactors", "removeScaleFactorsByPartition",
+        "resetScaleFactors", "resetScaleFactorsByPartition", "copyScaleFactors",
+        "getScaleFactors", "calculateRootLogLikelihoods",
+        "calculateRootLogLikelihoodsByPartition", "calculateEdgeLogLikelihoods",
+        "calculateEdgeLogLikelihoodsByPartition", "getLogLikelihood", "getDerivatives",
+        "getSiteLogLikelihoods", "getSiteDerivatives"
+    };
+    if (call < 0 || call >= WORKLOAD_CALL_COUNT)
+        return "unknown";
+    return names[call];
+}
+
+WorkloadCall::WorkloadCall(int inCall,
+                           int inInstance,
+                           int inReturnValue) {
+    call = inCall;
+    instance = inInstance;
+    returnValue = inReturnValue;
+    readPosition = 0;
+}
+
+WorkloadCall::WorkloadCall() {
+    call = -1;
+    instance = -1;
+    returnValue = BEAGLE_SUCCESS;
+    readPosition = 0;
+}
+
+void WorkloadCall::addInt(int value) {
+    const char* bytes = (const char*) &value;
+    arguments.insert(arguments.end(), bytes, bytes + sizeof(int));
+}
+
+void WorkloadCall::addLong(long long value) {
+    const char* bytes = (const char*) &value;
+    arguments.insert(arguments.end(), bytes, bytes + sizeof(long long));
+}
+
+void WorkloadCall::addDouble(double value) {
+    const char* bytes = (const char*) &value;
+    arguments.insert(arguments.end(), bytes, bytes + sizeof(double));
+}
+
+void WorkloadCall::addInts(const int* values,
+                           int length,
+                           bool storeValues) {
+    if (values == NULL)
+        length = -1;
+    addInt(length);
+    addInt(storeValues && length > 0);
+    if (storeValues && length > 0) {
+        const char* bytes = (const char*) values;
+        arguments.insert(arguments.end(), bytes, bytes + sizeof(int) * length);
+    }
+}
+
+void WorkloadCall::addDoubles(const double* values,
+                              int length,
+                              bool storeValues) {
+    if (values == NULL)
+        length = -1;
+    addInt(length);
+    addInt(storeValues && length > 0);
+    if (storeValues && length > 0) {
+        const char* bytes = (const char*) values;
+        arguments.insert(arguments.end(), bytes, bytes + sizeof(double) * length);
+    }
+}
+
+bool WorkloadCall::readBytes(void* data,
+                             size_t size) {
+    if (readPosition + size > arguments.size())
+        return false;
+    memcpy(data, &arguments[readPosition], size);
+    readPosition += size;
+    return true;
+}
+
+bool WorkloadCall::readInt(int* value) {
+    return readBytes(value, sizeof(int));
+}
+
+bool WorkloadCall::readLong(long long* value) {
+    return readBytes(value, sizeof(long long));
+}
+
+bool WorkloadCall::readDouble(double* value) {
+    return readBytes(value, sizeof(double));
+}
+
+bool WorkloadCall::readInts(std::vector<int>& values,
+                            int* length,
+                            bool* stored) {
+    int storedFlag;
+    if (!readInt(length) || !readInt(&storedFlag))
+        return false;
+    *stored = (storedFlag != 0);
+    values.assign(*length > 0 ? *length : 0, 0);
+    if (*stored && !values.empty())
+        return readBytes(&values[0], sizeof(int) * values.size());
+    return true;
+}
+
+bool WorkloadCall::readDoubles(std::vector<double>& values,
+                               int* length,
+                               bool* stored) {
+    int storedFlag;
+    if (!readInt(length) || !readInt(&storedFlag))
+        return false;
+    *stored = (storedFlag != 0);
+    values.assign(*length > 0 ? *length : 0, 0.0);
+    if (*stored && !values.empty())
+        return readBytes(&values[0], sizeof(double) * values.size());
+    return true;
+}
+
+WorkloadRecorder::WorkloadRecorder(const char* fileName,
+                                   bool inStoreData) {
+    storeData = inStoreData;
+    file = fopen(fileName, "wb");
+    if (file != NULL) {
+        char magic[8] = WORKLOAD_MAGIC;
+        int header[2] = {WORKLOAD_VERSION, (int) storeData};
+        fwrite(magic, sizeof(magic), 1, file);
+        fwrite(header, sizeof(header), 1, file);
+    }
+}
+
+WorkloadRecorder::~WorkloadRecorder() {
+    if (file != NULL)
+        fclose(file);
+}
+
+bool WorkloadRecorder::isOpen() const {
+    return file != NULL;
+}
+
+bool WorkloadRecorder::storesData() const {
+    return storeData;
+}
+
+void WorkloadRecorder::write(const WorkloadCall& call) {
+    if (file == NULL)
+        return;
+    // {call, instance, return value, argument bytes}
+    int header[4] = {call.call, call.instance, call.returnValue, (int) call.arguments.size()};
+    std::lock_guard<std::mutex> lock(mutex);
+    fwrite(header, sizeof(header), 1, file);
+    if (!call.arguments.empty())
+        fwrite(&call.arguments[0], 1, call.arguments.size(), file);
+}
+
+void WorkloadRecorder::flush() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (file != NULL)
+        fflush(file);
+}
+
+WorkloadReader::WorkloadReader() {
+    file = NULL;
+}
+
+WorkloadReader::~WorkloadReader() {
+    if (file != NULL)
+        fclose(file);
+}
+
+int WorkloadReader::open(const char* fileName) {
+    if (file != NULL)
+        fclose(file);
+    file = fopen(fileName, "rb");
+    if (file == NULL)
+        return BEAGLE_ERROR_GENERAL;
+
+    char magic[8];
+    int header[2];
+    if (fread(magic, sizeof(magic), 1, file) != 1 ||
+        memcmp(magic, WORKLOAD_MAGIC, sizeof(magic)) != 0 ||
+        fread(header, sizeof(header), 1, file) != 1 ||
+        header[0] != WORKLOAD_VERSION) {
+        fclose(file);
+        file = NULL;
+        return BEAGLE_ERROR_GENERAL;
+    }
+
+    return BEAGLE_SUCCESS;
+}
+
+bool WorkloadReader::next(WorkloadCall* outCall) {
+    if (file == NULL)
+        return false;
+
+    int header[4];
+    if (fread(header, sizeof(header), 1, file) != 1 || header[3] < 0)
+        return false;
+
+    *outCall = WorkloadCall(header[0], header[1], header[2]);
+    outCall->arguments.resize(header[3]);
+    if (header[3] > 0 && fread(&outCall->arguments[0], 1, header[3], file) != (size_t) header[3])
+        return false;
+
+    return true;
+}
+
+}   // end namespace beagle
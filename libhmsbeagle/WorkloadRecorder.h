@@ -0,0 +1,176 @@
+/*
+ *  WorkloadRecorder.h
+ *  Binary log of the API call stream of a client, for offline replay
+ *
+ * Copyright 2009 Phylogenetic Likelihood Working Group
+ *
+ * This file is part of BEAGLE.
+ *
+ * BEAGLE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * BEAGLE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BEAGLE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __beagle_workload_recorder__
+#define __beagle_workload_recorder__
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define BEAGLE_RECORD_ENV       "BEAGLE_RECORD"         // path of the workload file; recording is off if unset
+#define BEAGLE_RECORD_DATA_ENV  "BEAGLE_RECORD_DATA"    // if set, tip data, partials and pattern weights are stored too
+#define WORKLOAD_MAGIC          "BGLWKLD"               // first 8 bytes of a workload file, including the terminator
+#define WORKLOAD_VERSION        1                       // increment whenever the file format changes
+
+namespace beagle {
+
+/*
+ * Calls in a workload file. Values are part of the file format: new calls are
+ * appended and existing values never change.
+ */
+enum WorkloadCallId {
+    WORKLOAD_CREATE_INSTANCE                        = 0,
+    WORKLOAD_FINALIZE_INSTANCE                      = 1,
+    WORKLOAD_CLONE_INSTANCE                         = 2,
+    WORKLOAD_SET_CPU_THREAD_COUNT                   = 3,
+    WORKLOAD_SET_TIP_STATES                         = 4,
+    WORKLOAD_SET_TIP_PARTIALS                       = 5,
+    WORKLOAD_SET_PARTIALS                           = 6,
+    WORKLOAD_GET_PARTIALS                           = 7,
+    WORKLOAD_SET_EIGEN_DECOMPOSITION                = 8,
+    WORKLOAD_SET_STATE_FREQUENCIES                  = 9,
+    WORKLOAD_SET_CATEGORY_WEIGHTS                   = 10,
+    WORKLOAD_SET_PATTERN_WEIGHTS                    = 11,
+    WORKLOAD_SET_PATTERN_PARTITIONS                 = 12,
+    WORKLOAD_SET_CATEGORY_RATES                     = 13,
+    WORKLOAD_SET_CATEGORY_RATES_WITH_INDEX          = 14,
+    WORKLOAD_SET_TRANSITION_MATRIX                  = 15,
+    WORKLOAD_SET_TRANSITION_MATRICES                = 16,
+    WORKLOAD_GET_TRANSITION_MATRIX                  = 17,
+    WORKLOAD_CONVOLVE_TRANSITION_MATRICES           = 18,
+    WORKLOAD_UPDATE_TRANSITION_MATRICES             = 19,
+    WORKLOAD_UPDATE_TRANSITION_MATRICES_CATEGORIES  = 20,
+    WORKLOAD_UPDATE_TRANSITION_MATRICES_MODELS      = 21,
+    WORKLOAD_UPDATE_PARTIALS                        = 22,
+    WORKLOAD_UPDATE_PARTIALS_BY_PARTITION           = 23,
+    WORKLOAD_SET_TREE                               = 24,
+    WORKLOAD_INVALIDATE_PARTIALS                    = 25,
+    WORKLOAD_INVALIDATE_TRANSITION_MATRICES         = 26,
+    WORKLOAD_UPDATE_TREE                            = 27,
+    WORKLOAD_WAIT_FOR_PARTIALS                      = 28,
+    WORKLOAD_ACCUMULATE_SCALE_FACTORS               = 29,
+    WORKLOAD_ACCUMULATE_SCALE_FACTORS_BY_PARTITION  = 30,
+    WORKLOAD_REMOVE_SCALE_FACTORS                   = 31,
+    WORKLOAD_REMOVE_SCALE_FACTORS_BY_PARTITION      = 32,
+    WORKLOAD_RESET_SCALE_FACTORS                    = 33,
+    WORKLOAD_RESET_SCALE_FACTORS_BY_PARTITION       = 34,
+    WORKLOAD_COPY_SCALE_FACTORS                     = 35,
+    WORKLOAD_GET_SCALE_FACTORS                      = 36,
+    WORKLOAD_CALCULATE_ROOT                         = 37,
+    WORKLOAD_CALCULATE_ROOT_BY_PARTITION            = 38,
+    WORKLOAD_CALCULATE_EDGE                         = 39,
+    WORKLOAD_CALCULATE_EDGE_BY_PARTITION            = 40,
+    WORKLOAD_GET_LOG_LIKELIHOOD                     = 41,
+    WORKLOAD_GET_DERIVATIVES                        = 42,
+    WORKLOAD_GET_SITE_LOG_LIKELIHOODS               = 43,
+    WORKLOAD_GET_SITE_DERIVATIVES                   = 44,
+    WORKLOAD_CALL_COUNT                             = 45
+};
+
+const char* getWorkloadCallName(int call);
+
+/*
+ * One recorded call: its id, the instance it was made on, the value it
+ * returned and its arguments, followed by its outputs where they are useful to
+ * check a replay. Arrays are stored with their length, -1 for a NULL pointer,
+ * and a flag telling whether their elements follow; elements of bulk data may
+ * be left out, in which case a replay substitutes synthetic values. All values
+ * are stored in native byte order.
+ */
+class WorkloadCall {
+public:
+    WorkloadCall(int inCall, int inInstance, int inReturnValue);
+    WorkloadCall();
+
+    void addInt(int value);
+    void addLong(long long value);
+    void addDouble(double value);
+    void addInts(const int* values, int length, bool storeValues = true);
+    void addDoubles(const double* values, int length, bool storeValues = true);
+
+    // readers return false once the arguments are exhausted or malformed
+    bool readInt(int* value);
+    bool readLong(long long* value);
+    bool readDouble(double* value);
+    // length is -1 for a NULL pointer; stored is false if the values were left out
+    bool readInts(std::vector<int>& values, int* length, bool* stored);
+    bool readDoubles(std::vector<double>& values, int* length, bool* stored);
+
+    int call;
+    int instance;
+    int returnValue;
+    std::vector<char> arguments;
+
+private:
+    bool readBytes(void* data, size_t size);
+    size_t readPosition;
+};
+
+/*
+ * Appends calls to a workload file. Calls may be written from several client
+ * threads; each call is written whole.
+ */
+class WorkloadRecorder {
+public:
+    WorkloadRecorder(const char* fileName,
+                     bool inStoreData);
+    ~WorkloadRecorder();
+
+    bool isOpen() const;
+
+    // whether bulk data (tip states, partials, pattern weights) is stored
+    bool storesData() const;
+
+    void write(const WorkloadCall& call);
+
+    void flush();
+
+private:
+    FILE* file;
+    bool storeData;
+    std::mutex mutex;
+};
+
+/*
+ * Reads the calls of a workload file in the order they were recorded.
+ */
+class WorkloadReader {
+public:
+    WorkloadReader();
+    ~WorkloadReader();
+
+    // returns an error code
+    int open(const char* fileName);
+
+    // returns false at the end of the file or if the next call is truncated
+    bool next(WorkloadCall* outCall);
+
+private:
+    FILE* file;
+};
+
+}   // end namespace beagle
+
+#endif // __beagle_workload_recorder__
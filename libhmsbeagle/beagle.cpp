@@ -39,6 +39,7 @@
 #include <cstring>
 #include <exception>    // for exception, bad_exception
 #include <stdexcept>    // for std exception hierarchy
+#include <algorithm>
 #include <list>
 #include <utility>
 #include <vector>
@@ -46,7 +47,12 @@
 
 #include "libhmsbeagle/beagle.h"
 #include "libhmsbeagle/BeagleImpl.h"
+#include "libhmsbeagle/IncrementalTree.h"
+#include "libhmsbeagle/TraceRecorder.h"
+#include "libhmsbeagle/WorkloadRecorder.h"
 #include "libhmsbeagle/benchmark/BeagleBenchmark.h"
+#include "libhmsbeagle/benchmark/BenchmarkCache.h"
+#include "libhmsbeagle/benchmark/PerformanceModel.h"
 
 #include "libhmsbeagle/plugin/Plugin.h"
 
@@ -61,6 +67,23 @@ typedef std::pair<int, std::pair<int, beagle::BeagleImplFactory*> > RsrcImpl;
 typedef std::list<RsrcImpl> RsrcImplList;
 typedef std::list<BeagleBenchmarkedResource> RsrcBenchPairList;
 
+// Arguments an instance was created with, kept so that it can be cloned
+typedef struct {
+    beagle::BeagleImplFactory* factory;
+    int tipCount;
+    int partialsBufferCount;
+    int compactBufferCount;
+    int stateCount;
+    int patternCount;
+    int eigenBufferCount;
+    int matrixBufferCount;
+    int categoryCount;
+    int scaleBufferCount;
+    int resource;
+    long preferenceFlags;
+    long requirementFlags;
+} InstanceArguments;
+
 //#define BEAGLE_DEBUG_TIME
 #ifdef BEAGLE_DEBUG_TIME
 #include <sys/time.h>
@@ -81,6 +104,13 @@ double debugGetTime() {
 #define DEBUG_FINALIZE_TIME()
 #endif
 
+// Opt-in timeline of API calls, kernels and thread pool activity, see TraceRecorder.h
+#define TRACE_API_CALL(instance) beagle::TraceScope apiTrace(traceRecorder, __func__, "api", instance)
+
+// Operations are recorded as plain arrays of this many indices each, see WorkloadRecorder.h
+const int operationLength = sizeof(BeagleOperation) / sizeof(int);
+const int partitionOperationLength = sizeof(BeagleOperationByPartition) / sizeof(int);
+
 // #define BEAGLE_DEBUG_FP_REDUCED_PRECISION
 #ifdef BEAGLE_DEBUG_FP_REDUCED_PRECISION
 #define FP_REDUCED_PRECISION_MASK 0xFFFFFFFFFFFFFFE0 // throwing away last 5 bits of significand
@@ -90,6 +120,12 @@ int debugPatternCount;
 
 //@CHANGED make this a std::vector<BeagleImpl *> and use at to reference.
 std::vector<beagle::BeagleImpl*> *instances = NULL;
+std::vector<InstanceArguments> *instanceArguments = NULL;
+std::map<int, beagle::IncrementalTree*> IncrementalTreeMap;
+beagle::TraceRecorder* traceRecorder = NULL;
+bool traceChecked = false;
+beagle::WorkloadRecorder* workloadRecorder = NULL;
+bool workloadChecked = false;
 
 /// returns an initialized instance or NULL if the index refers to an invalid instance
 namespace beagle {
@@ -102,6 +138,69 @@ BeagleImpl* getBeagleInstance(int instanceIndex) {
     return (*instances)[instanceIndex];
 }
 
+IncrementalTree* getIncrementalTree(int instanceIndex) {
+    std::map<int, IncrementalTree*>::iterator it = IncrementalTreeMap.find(instanceIndex);
+    if (it == IncrementalTreeMap.end())
+        return NULL;
+    return it->second;
+}
+
+// Records buffers written through the API as changed for an instance's tree, if it has one
+void invalidateTreePartials(int instanceIndex, const int* bufferIndices, int count) {
+    IncrementalTree* tree = getIncrementalTree(instanceIndex);
+    if (tree != NULL)
+        tree->invalidatePartials(bufferIndices, count);
+}
+
+void invalidateTreeMatrices(int instanceIndex, const int* matrixIndices, int count) {
+    IncrementalTree* tree = getIncrementalTree(instanceIndex);
+    if (tree != NULL)
+        tree->invalidateTransitionMatrices(matrixIndices, count);
+}
+
+// Starts tracing the first time an instance is created if BEAGLE_TRACE names a trace file
+void initializeTrace(BeagleImpl* impl, int instanceIndex) {
+    if (!traceChecked) {
+        traceChecked = true;
+        const char* fileName = getenv(BEAGLE_TRACE_ENV);
+        if (fileName != NULL && *fileName != '\0')
+            traceRecorder = new TraceRecorder(fileName);
+    }
+    impl->traceRecorder = traceRecorder;
+    impl->traceInstance = instanceIndex;
+}
+
+// Starts recording the call stream the first time an instance is created if BEAGLE_RECORD names a file
+void initializeWorkloadRecorder() {
+    if (workloadChecked)
+        return;
+    workloadChecked = true;
+    const char* fileName = getenv(BEAGLE_RECORD_ENV);
+    if (fileName == NULL || *fileName == '\0')
+        return;
+    const char* storeData = getenv(BEAGLE_RECORD_DATA_ENV);
+    workloadRecorder = new WorkloadRecorder(fileName, storeData != NULL && *storeData != '\0' &&
+                                                      strcmp(storeData, "0") != 0);
+    if (!workloadRecorder->isOpen()) {
+        fprintf(stderr, "BEAGLE: could not write workload file %s\n", fileName);
+        delete workloadRecorder;
+        workloadRecorder = NULL;
+    }
+}
+
+void writeTrace() {
+    if (traceRecorder != NULL && traceRecorder->write() != BEAGLE_SUCCESS)
+        fprintf(stderr, "BEAGLE: could not write trace file %s\n", getenv(BEAGLE_TRACE_ENV));
+}
+
+void deleteIncrementalTree(int instanceIndex) {
+    std::map<int, IncrementalTree*>::iterator it = IncrementalTreeMap.find(instanceIndex);
+    if (it != IncrementalTreeMap.end()) {
+        delete it->second;
+        IncrementalTreeMap.erase(it);
+    }
+}
+
 }   // end namespace beagle
 
 
@@ -132,51 +231,83 @@ int loaded = 0; // Indicates is the initial library constructors have been run
 /** The list of plugins that provide implementations of likelihood calculators */
 std::list<beagle::plugin::Plugin*>* plugins;
 
-void beagleLoadPlugins(void) {
+/** Plugins by manifest entry; NULL where not yet tried, excluded or unavailable */
+std::vector<beagle::plugin::Plugin*> pluginSlots;
+std::vector<bool> pluginTried;
+bool allPluginsLoaded = false;
+
+/**
+ * Loads the plugins not yet tried, or only those with CPU implementations if cpuOnly
+ *
+ * Plugins are listed in manifest order whatever order they were loaded in, so resource
+ * numbers do not depend on which calls came first. Resource and factory lists built
+ * from an earlier, smaller set of plugins are discarded.
+ */
+void beagleLoadPlugins(bool cpuOnly) {
     if(plugins==NULL){
         plugins = new std::list<beagle::plugin::Plugin*>();
     }
 
     beagle::plugin::PluginManager& pm = beagle::plugin::PluginManager::instance();
+    const std::vector<beagle::plugin::PluginManifest>& manifests = pm.manifests();
+    if (pluginTried.empty()) {
+        pluginSlots.assign(manifests.size(), NULL);
+        pluginTried.assign(manifests.size(), false);
+    }
 
-    try{
-        beagle::plugin::Plugin* sseplug = pm.findPlugin("hmsbeagle-cpu-sse");
-        plugins->push_back(sseplug);
-    }catch(beagle::plugin::SharedLibraryException sle){}
-
-    try{
-        beagle::plugin::Plugin* cpuplug = pm.findPlugin("hmsbeagle-cpu");
-        plugins->push_back(cpuplug);
-    }catch(beagle::plugin::SharedLibraryException sle){
-        // this one should always work
-        std::cerr << "Unable to load CPU plugin!\n";
-        std::cerr << "Please check for proper libhmsbeagle installation.\n";
-    }
-
-    try{
-        beagle::plugin::Plugin* cudaplug = pm.findPlugin("hmsbeagle-cuda");
-        plugins->push_back(cudaplug);
-    }catch(beagle::plugin::SharedLibraryException sle){}
-
-    try{
-        beagle::plugin::Plugin* openclplug = pm.findPlugin("hmsbeagle-opencl");
-        plugins->push_back(openclplug);
-    }catch(beagle::plugin::SharedLibraryException sle){}
-
-    try{
-        beagle::plugin::Plugin* openclalteraplug = pm.findPlugin("hmsbeagle-opencl-altera");
-        plugins->push_back(openclalteraplug);
-    }catch(beagle::plugin::SharedLibraryException sle){}
-    
-    try{
-        beagle::plugin::Plugin* avxplug = pm.findPlugin("hmsbeagle-cpu-avx");
-        plugins->push_back(avxplug);
-    }catch(beagle::plugin::SharedLibraryException sle){}    
+    bool changed = false;
+    for (size_t i = 0; i < manifests.size(); i++) {
+        const char* name = manifests[i].name;
+        if (pluginTried[i] || (cpuOnly && !(manifests[i].flags & BEAGLE_FLAG_FRAMEWORK_CPU)))
+            continue;
+        pluginTried[i] = true;
+        if (!pm.isPluginAllowed(name))
+            continue;
+        try{
+            pluginSlots[i] = pm.findPlugin(name);
+            changed = true;
+        }catch(beagle::plugin::SharedLibraryException sle){
+            if (strcmp(name, "hmsbeagle-cpu") == 0) {
+                // this one should always work
+                std::cerr << "Unable to load CPU plugin!\n";
+                std::cerr << "Please check for proper libhmsbeagle installation.\n";
+            }
+        }
+    }
+    if (!cpuOnly)
+        allPluginsLoaded = true;
+
+    if (changed) {
+        plugins->clear();
+        for (size_t i = 0; i < pluginSlots.size(); i++) {
+            if (pluginSlots[i] != NULL)
+                plugins->push_back(pluginSlots[i]);
+        }
+        // the factories and resources are owned by the plugins, only the lists are freed
+        delete implFactory;
+        implFactory = NULL;
+        if (rsrcList != NULL) {
+            free(rsrcList->list);
+            free(rsrcList);
+            rsrcList = NULL;
+        }
+        ResourceMap.clear();
+    }
+}
 
-    try{
-        beagle::plugin::Plugin* openmpplug = pm.findPlugin("hmsbeagle-cpu-openmp");
-        plugins->push_back(openmpplug);
-    }catch(beagle::plugin::SharedLibraryException sle){}
+/**
+ * Whether an instance can only be created by a CPU plugin: it asks for CPU implementations,
+ * or lists resource 0 alone, which is the CPU whichever plugins are loaded
+ */
+bool requiresOnlyCPUPlugins(const int* resourceList, int resourceCount, long requirementFlags) {
+    if (resourceList != NULL && resourceCount > 0) {
+        for (int i = 0; i < resourceCount; i++) {
+            if (resourceList[i] != 0)
+                return false;
+        }
+        return true;
+    }
+    return (requirementFlags & BEAGLE_FLAG_FRAMEWORK_CPU) != 0;
 }
 
 std::list<beagle::BeagleImplFactory*>* beagleGetFactoryList(void) {
@@ -208,6 +339,16 @@ void beagle_library_finalize(void) {
     plugins.clear();    
 */
 
+    // event names may live in plugins, so the trace is written before they are unloaded
+    beagle::writeTrace();
+    delete traceRecorder;
+    traceRecorder = NULL;
+    traceChecked = false;
+
+    delete workloadRecorder;
+    workloadRecorder = NULL;
+    workloadChecked = false;
+
     if(plugins!=NULL && loaded){
         delete plugins;
     }
@@ -238,6 +379,14 @@ void beagle_library_finalize(void) {
     if (instances && loaded) {
         delete instances;
     }
+    if (instanceArguments && loaded) {
+        delete instanceArguments;
+    }
+    for (std::map<int, beagle::IncrementalTree*>::iterator it = IncrementalTreeMap.begin();
+         it != IncrementalTreeMap.end(); ++it) {
+        delete it->second;
+    }
+    IncrementalTreeMap.clear();
     loaded = 0;
 }
 
@@ -278,10 +427,7 @@ const char* beagleGetCitation() {
     return BEAGLE_CITATION;
 }
 
-BeagleResourceList* beagleGetResourceList() {
-    // plugins must be loaded before resources
-    if (plugins==NULL)
-        beagleLoadPlugins();
+BeagleResourceList* beagleBuildResourceList() {
 
     if (rsrcList == NULL) {
         // count the total resources across plugins
@@ -323,6 +469,14 @@ BeagleResourceList* beagleGetResourceList() {
     return rsrcList;
 }
 
+BeagleResourceList* beagleGetResourceList() {
+    // plugins must be loaded before resources
+    if (!allPluginsLoaded)
+        beagleLoadPlugins(false);
+
+    return beagleBuildResourceList();
+}
+
 int scoreFlags(long flags1, long flags2) {
     int score = 0;
     int trait = 1;
@@ -444,6 +598,90 @@ int rankResourceImplementationPairs(long preferenceFlags,
     return BEAGLE_SUCCESS;
 }
 
+// Estimated seconds per likelihood evaluation of a resource-implementation pair. If C++
+// threading is only preferred, it is used only where the model expects it to pay off.
+double estimatePairSeconds(int resource,
+                           beagle::BeagleImplFactory* factory,
+                           int tipCount,
+                           int stateCount,
+                           int patternCount,
+                           int categoryCount,
+                           long preferenceFlags,
+                           long requirementFlags,
+                           bool* outThreaded) {
+    long resourceFlags = rsrcList->list[resource].supportFlags;
+    long factoryFlags = factory->getFlags();
+    bool threaded = (((preferenceFlags | requirementFlags) & BEAGLE_FLAG_THREADING_CPP) &&
+                     (factoryFlags & BEAGLE_FLAG_THREADING_CPP));
+    double seconds = beagle::benchmark::estimateEvaluationSeconds(resourceFlags, factoryFlags, threaded,
+                                                                  tipCount, stateCount, patternCount,
+                                                                  categoryCount);
+    if (threaded && !(requirementFlags & BEAGLE_FLAG_THREADING_CPP)) {
+        double serialSeconds = beagle::benchmark::estimateEvaluationSeconds(resourceFlags, factoryFlags, false,
+                                                                            tipCount, stateCount, patternCount,
+                                                                            categoryCount);
+        if (serialSeconds <= seconds) {
+            seconds = serialSeconds;
+            threaded = false;
+        }
+    }
+    if (outThreaded != NULL)
+        *outThreaded = threaded;
+    return seconds;
+}
+
+// Reorders flag-ranked resource-implementation pairs by estimated run time: pairs
+// estimated far slower than the fastest drop below all others whatever their flag
+// score, and pairs with equal scores are tried fastest first
+void rankByPerformanceModel(RsrcImplList* possibleResourceImplementations,
+                            int tipCount,
+                            int stateCount,
+                            int patternCount,
+                            int categoryCount,
+                            long preferenceFlags,
+                            long requirementFlags) {
+    struct RankedPair {
+        int score;
+        double seconds;
+        RsrcImpl pair;
+        bool operator<(const RankedPair& other) const {
+            return (score != other.score ? score < other.score : seconds < other.seconds);
+        }
+    };
+
+    std::vector<RankedPair> ranked;
+    double fastest = 0.0;
+    for (RsrcImplList::iterator it = possibleResourceImplementations->begin();
+         it != possibleResourceImplementations->end(); ++it) {
+        RankedPair rankedPair;
+        rankedPair.pair = *it;
+        rankedPair.score = (*it).first;
+        rankedPair.seconds = estimatePairSeconds((*it).second.first, (*it).second.second, tipCount,
+                                                 stateCount, patternCount, categoryCount,
+                                                 preferenceFlags, requirementFlags, NULL);
+        if (ranked.empty() || rankedPair.seconds < fastest)
+            fastest = rankedPair.seconds;
+        ranked.push_back(rankedPair);
+    }
+
+    for (size_t i = 0; i < ranked.size(); i++) {
+        if (ranked[i].seconds > fastest * PERFORMANCE_MODEL_DEMOTION)
+            ranked[i].score += 32; // below any flag score
+    }
+
+    std::stable_sort(ranked.begin(), ranked.end());
+
+    possibleResourceImplementations->clear();
+    for (size_t i = 0; i < ranked.size(); i++) {
+        possibleResourceImplementations->push_back(ranked[i].pair);
+#ifdef BEAGLE_DEBUG_FLOW
+        fprintf(stderr,"\t %s on resource %d: %g s per evaluation (%d)\n",
+                ranked[i].pair.second.second->getName(), ranked[i].pair.second.first,
+                ranked[i].seconds, ranked[i].score);
+#endif
+    }
+}
+
 BeagleBenchmarkedResourceList* beagleGetBenchmarkedResourceList(int tipCount,
                                                                 int compactBufferCount,
                                                                 int stateCount,
@@ -462,8 +700,8 @@ BeagleBenchmarkedResourceList* beagleGetBenchmarkedResourceList(int tipCount,
     debugPatternCount = patternCount;
 #endif
 
-    if (rsrcList == NULL)
-        beagleGetResourceList();
+    // a list built for CPU-only instances would be incomplete
+    beagleGetResourceList();
 
     if (implFactory == NULL)
         beagleGetFactoryList();
@@ -512,7 +750,7 @@ BeagleBenchmarkedResourceList* beagleGetBenchmarkedResourceList(int tipCount,
 
     bool instOnly = false;
     
-    errorCode = beagle::benchmark::benchmarkResource(0,
+    errorCode = beagle::benchmark::benchmarkResourceCached(0,
                                   stateCount,
                                   tipCount,
                                   patternCount,
@@ -548,7 +786,7 @@ BeagleBenchmarkedResourceList* beagleGetBenchmarkedResourceList(int tipCount,
 
         double itBenchmarkResult;
 
-        (*it).returnCode = beagle::benchmark::benchmarkResource((*it).number,
+        (*it).returnCode = beagle::benchmark::benchmarkResourceCached((*it).number,
                                                      stateCount,
                                                      tipCount,
                                                      patternCount,
@@ -614,6 +852,10 @@ BeagleBenchmarkedResourceList* beagleGetBenchmarkedResourceList(int tipCount,
     return rsrcBenchList;
 }
 
+int beagleClearBenchmarkCache() {
+    return beagle::benchmark::clearBenchmarkCache();
+}
+
 int beagleCreateInstance(int tipCount,
                          int partialsBufferCount,
                          int compactBufferCount,
@@ -633,8 +875,17 @@ int beagleCreateInstance(int tipCount,
         if (instances == NULL)
             instances = new std::vector<beagle::BeagleImpl*>;
 
-        if (rsrcList == NULL)
-            beagleGetResourceList();
+        if (instanceArguments == NULL)
+            instanceArguments = new std::vector<InstanceArguments>;
+
+        // CPU-only instances leave GPU plugins, and their drivers, unloaded
+        if (!allPluginsLoaded)
+            beagleLoadPlugins(requiresOnlyCPUPlugins(resourceList, resourceCount, requirementFlags));
+
+        if (beagleBuildResourceList()->length == 0 && !allPluginsLoaded) {
+            beagleLoadPlugins(false);
+            beagleBuildResourceList();
+        }
         
         if (implFactory == NULL)
             beagleGetFactoryList();
@@ -670,12 +921,34 @@ int beagleCreateInstance(int tipCount,
             return errorCode;
         }
 
+        bool useModel = beagle::benchmark::isPerformanceModelEnabled();
+        if (useModel)
+            rankByPerformanceModel(possibleResourceImplementations, tipCount, stateCount, patternCount,
+                                   categoryCount, preferenceFlags, requirementFlags);
+
         beagle::BeagleImpl* bestBeagle = NULL;
+        InstanceArguments arguments = {NULL, tipCount, partialsBufferCount, compactBufferCount,
+                                       stateCount, patternCount, eigenBufferCount,
+                                       matrixBufferCount, categoryCount, scaleBufferCount,
+                                       0, preferenceFlags, requirementFlags};
         errorCode = BEAGLE_ERROR_NO_RESOURCE;
 
         for(RsrcImplList::iterator it = possibleResourceImplementations->begin(); it != possibleResourceImplementations->end(); ++it) {
             int resource = (*it).second.first;
             beagle::BeagleImplFactory* factory = (*it).second.second;
+            arguments.factory = factory;
+            arguments.resource = resource;
+
+            // drop a preference for threading that would slow this problem down
+            long implPreferenceFlags = preferenceFlags;
+            bool threaded = true;
+            if (useModel && (preferenceFlags & BEAGLE_FLAG_THREADING_CPP)) {
+                estimatePairSeconds(resource, factory, tipCount, stateCount, patternCount, categoryCount,
+                                    preferenceFlags, requirementFlags, &threaded);
+                if (!threaded)
+                    implPreferenceFlags = (preferenceFlags & ~BEAGLE_FLAG_THREADING_CPP) | BEAGLE_FLAG_THREADING_NONE;
+            }
+            arguments.preferenceFlags = implPreferenceFlags;
             
             bestBeagle = factory->createImpl(tipCount, partialsBufferCount,
                                                                 compactBufferCount, stateCount,
@@ -684,7 +957,7 @@ int beagleCreateInstance(int tipCount,
                                                                 scaleBufferCount,
                                                                 resource,
                                                                 ResourceMap[resource],
-                                                                preferenceFlags,
+                                                                implPreferenceFlags,
                                                                 requirementFlags,
                                                                 &errorCode);
             
@@ -697,6 +970,9 @@ int beagleCreateInstance(int tipCount,
         if (bestBeagle != NULL) {
             int instance = instances->size();
             instances->push_back(bestBeagle);
+            beagle::initializeTrace(bestBeagle, instance);
+            beagle::initializeWorkloadRecorder();
+            instanceArguments->push_back(arguments);
             
             int returnValue = bestBeagle->getInstanceDetails(returnInfo);
             if (returnValue == BEAGLE_SUCCESS) {
@@ -706,6 +982,22 @@ int beagleCreateInstance(int tipCount,
                 
                 returnValue = instance;
             }
+            if (workloadRecorder != NULL) {
+                beagle::WorkloadCall call(beagle::WORKLOAD_CREATE_INSTANCE, instance, returnValue);
+                call.addInt(tipCount);
+                call.addInt(partialsBufferCount);
+                call.addInt(compactBufferCount);
+                call.addInt(stateCount);
+                call.addInt(patternCount);
+                call.addInt(eigenBufferCount);
+                call.addInt(matrixBufferCount);
+                call.addInt(categoryCount);
+                call.addInt(scaleBufferCount);
+                call.addLong(preferenceFlags);
+                call.addLong(requirementFlags);
+                call.addLong(returnValue == instance ? returnInfo->flags : 0);
+                workloadRecorder->write(call);
+            }
             return returnValue;
         }   
         
@@ -733,6 +1025,13 @@ int beagleFinalizeInstance(int instance) {
             return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
         delete beagleInstance;
         (*instances)[instance] = NULL;
+        beagle::deleteIncrementalTree(instance);
+        beagle::writeTrace();
+        if (workloadRecorder != NULL) {
+            workloadRecorder->write(beagle::WorkloadCall(beagle::WORKLOAD_FINALIZE_INSTANCE, instance,
+                                                         BEAGLE_SUCCESS));
+            workloadRecorder->flush();
+        }
         return BEAGLE_SUCCESS;
     }
     catch (std::bad_alloc &) {
@@ -746,13 +1045,79 @@ int beagleFinalizeInstance(int instance) {
     }
 }
 
+int beagleCloneInstance(int instance,
+                        BeagleInstanceDetails* returnInfo) {
+    TRACE_API_CALL(instance);
+    try {
+        beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
+        if (beagleInstance == NULL)
+            return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
+
+        const InstanceArguments& arguments = (*instanceArguments)[instance];
+        int errorCode = BEAGLE_SUCCESS;
+        beagle::BeagleImpl* clone = arguments.factory->createImpl(arguments.tipCount,
+                                                                  arguments.partialsBufferCount,
+                                                                  arguments.compactBufferCount,
+                                                                  arguments.stateCount,
+                                                                  arguments.patternCount,
+                                                                  arguments.eigenBufferCount,
+                                                                  arguments.matrixBufferCount,
+                                                                  arguments.categoryCount,
+                                                                  arguments.scaleBufferCount,
+                                                                  arguments.resource,
+                                                                  ResourceMap[arguments.resource],
+                                                                  arguments.preferenceFlags,
+                                                                  arguments.requirementFlags,
+                                                                  &errorCode);
+        if (clone == NULL)
+            return errorCode;
+
+        errorCode = clone->shareBuffers(beagleInstance);
+        if (errorCode != BEAGLE_SUCCESS) {
+            delete clone;
+            return errorCode;
+        }
+
+        int cloneInstance = instances->size();
+        instances->push_back(clone);
+        beagle::initializeTrace(clone, cloneInstance);
+        instanceArguments->push_back(arguments);
+
+        int returnValue = clone->getInstanceDetails(returnInfo);
+        if (returnValue == BEAGLE_SUCCESS) {
+            returnInfo->resourceName = rsrcList->list[returnInfo->resourceNumber].name;
+            returnInfo->implDescription = (char*) "none";
+
+            returnValue = cloneInstance;
+        }
+        if (workloadRecorder != NULL)
+            workloadRecorder->write(beagle::WorkloadCall(beagle::WORKLOAD_CLONE_INSTANCE, instance, returnValue));
+        return returnValue;
+    }
+    catch (std::bad_alloc &) {
+        return BEAGLE_ERROR_OUT_OF_MEMORY;
+    }
+    catch (std::out_of_range &) {
+        return BEAGLE_ERROR_OUT_OF_RANGE;
+    }
+    catch (...) {
+        return BEAGLE_ERROR_UNIDENTIFIED_EXCEPTION;
+    }
+}
+
 int beagleSetCPUThreadCount(int instance,
                             int threadCount) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
     beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
     if (beagleInstance == NULL)
         return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
     int returnValue = beagleInstance->setCPUThreadCount(threadCount);
+    if (workloadRecorder != NULL) {
+        beagle::WorkloadCall call(beagle::WORKLOAD_SET_CPU_THREAD_COUNT, instance, returnValue);
+        call.addInt(threadCount);
+        workloadRecorder->write(call);
+    }
     DEBUG_END_TIME();
     return returnValue;
 }
@@ -761,11 +1126,20 @@ int beagleSetTipStates(int instance,
                  int tipIndex,
                  const int* inStates) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
     try {
         beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
         if (beagleInstance == NULL)
             return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
         int returnValue = beagleInstance->setTipStates(tipIndex, inStates);
+        beagle::invalidateTreePartials(instance, &tipIndex, 1);
+        if (workloadRecorder != NULL) {
+            const InstanceArguments& dims = (*instanceArguments)[instance];
+            beagle::WorkloadCall call(beagle::WORKLOAD_SET_TIP_STATES, instance, returnValue);
+            call.addInt(tipIndex);
+            call.addInts(inStates, dims.patternCount, workloadRecorder->storesData());
+            workloadRecorder->write(call);
+        }
         DEBUG_END_TIME();
         return returnValue;
     }
@@ -784,11 +1158,20 @@ int beagleSetTipPartials(int instance,
                    int tipIndex,
                    const double* inPartials) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
     try {
         beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
         if (beagleInstance == NULL)
             return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
         int returnValue = beagleInstance->setTipPartials(tipIndex, inPartials);
+        beagle::invalidateTreePartials(instance, &tipIndex, 1);
+        if (workloadRecorder != NULL) {
+            const InstanceArguments& dims = (*instanceArguments)[instance];
+            beagle::WorkloadCall call(beagle::WORKLOAD_SET_TIP_PARTIALS, instance, returnValue);
+            call.addInt(tipIndex);
+            call.addDoubles(inPartials, dims.patternCount * dims.stateCount, workloadRecorder->storesData());
+            workloadRecorder->write(call);
+        }
         DEBUG_END_TIME();
         return returnValue;
     }
@@ -807,11 +1190,21 @@ int beagleSetPartials(int instance,
                 int bufferIndex,
                 const double* inPartials) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
     try {
         beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
         if (beagleInstance == NULL)
             return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
         int returnValue = beagleInstance->setPartials(bufferIndex, inPartials);
+        beagle::invalidateTreePartials(instance, &bufferIndex, 1);
+        if (workloadRecorder != NULL) {
+            const InstanceArguments& dims = (*instanceArguments)[instance];
+            beagle::WorkloadCall call(beagle::WORKLOAD_SET_PARTIALS, instance, returnValue);
+            call.addInt(bufferIndex);
+            call.addDoubles(inPartials, dims.patternCount * dims.stateCount * dims.categoryCount,
+                            workloadRecorder->storesData());
+            workloadRecorder->write(call);
+        }
         DEBUG_END_TIME();
         return returnValue;
     }
@@ -828,11 +1221,91 @@ int beagleSetPartials(int instance,
 
 int beagleGetPartials(int instance, int bufferIndex, int scaleIndex, double* outPartials) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
     try {
         beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
         if (beagleInstance == NULL)
             return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
         int returnValue = beagleInstance->getPartials(bufferIndex, scaleIndex, outPartials);
+        if (workloadRecorder != NULL) {
+            beagle::WorkloadCall call(beagle::WORKLOAD_GET_PARTIALS, instance, returnValue);
+            call.addInt(bufferIndex);
+            call.addInt(scaleIndex);
+            workloadRecorder->write(call);
+        }
+        DEBUG_END_TIME();
+        return returnValue;
+    }
+    catch (std::bad_alloc &) {
+        return BEAGLE_ERROR_OUT_OF_MEMORY;
+    }
+    catch (std::out_of_range &) {
+        return BEAGLE_ERROR_OUT_OF_RANGE;
+    }
+    catch (...) {
+        return BEAGLE_ERROR_UNIDENTIFIED_EXCEPTION;
+    }
+}
+
+int beagleGetBufferLayout(int instance, BeagleBufferLayout* returnLayout) {
+    DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
+    beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
+    if (beagleInstance == NULL)
+        return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
+    int returnValue = beagleInstance->getBufferLayout(returnLayout);
+    DEBUG_END_TIME();
+    return returnValue;
+}
+
+int beagleSetPartialsBuffer(int instance, int bufferIndex, void* inPartials) {
+    DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
+    try {
+        beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
+        if (beagleInstance == NULL)
+            return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
+        int returnValue = beagleInstance->setPartialsBuffer(bufferIndex, inPartials);
+        beagle::invalidateTreePartials(instance, &bufferIndex, 1);
+        if (workloadRecorder != NULL) {
+            const InstanceArguments& dims = (*instanceArguments)[instance];
+            beagle::WorkloadCall call(beagle::WORKLOAD_SET_PARTIALS, instance, returnValue);
+            // caller-owned arrays are in native precision and layout, so only their size is kept
+            call.addInt(bufferIndex);
+            call.addDoubles((const double*) inPartials, dims.patternCount * dims.stateCount * dims.categoryCount,
+                            false);
+            workloadRecorder->write(call);
+        }
+        DEBUG_END_TIME();
+        return returnValue;
+    }
+    catch (std::bad_alloc &) {
+        return BEAGLE_ERROR_OUT_OF_MEMORY;
+    }
+    catch (std::out_of_range &) {
+        return BEAGLE_ERROR_OUT_OF_RANGE;
+    }
+    catch (...) {
+        return BEAGLE_ERROR_UNIDENTIFIED_EXCEPTION;
+    }
+}
+
+int beagleSetTipStatesBuffer(int instance, int tipIndex, int* inStates) {
+    DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
+    try {
+        beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
+        if (beagleInstance == NULL)
+            return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
+        int returnValue = beagleInstance->setTipStatesBuffer(tipIndex, inStates);
+        beagle::invalidateTreePartials(instance, &tipIndex, 1);
+        if (workloadRecorder != NULL) {
+            const InstanceArguments& dims = (*instanceArguments)[instance];
+            beagle::WorkloadCall call(beagle::WORKLOAD_SET_TIP_STATES, instance, returnValue);
+            call.addInt(tipIndex);
+            call.addInts(inStates, dims.patternCount, false);
+            workloadRecorder->write(call);
+        }
         DEBUG_END_TIME();
         return returnValue;
     }
@@ -853,12 +1326,24 @@ int beagleSetEigenDecomposition(int instance,
                           const double* inInverseEigenVectors,
                           const double* inEigenValues) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
     try {
         beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
         if (beagleInstance == NULL)
             return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
         int returnValue = beagleInstance->setEigenDecomposition(eigenIndex, inEigenVectors,
                                                      inInverseEigenVectors, inEigenValues);
+        if (workloadRecorder != NULL) {
+            const InstanceArguments& dims = (*instanceArguments)[instance];
+            beagle::WorkloadCall call(beagle::WORKLOAD_SET_EIGEN_DECOMPOSITION, instance, returnValue);
+            int eigenValueCount = ((dims.preferenceFlags | dims.requirementFlags) & BEAGLE_FLAG_EIGEN_COMPLEX ?
+                                   2 * dims.stateCount : dims.stateCount);
+            call.addInt(eigenIndex);
+            call.addDoubles(inEigenVectors, dims.stateCount * dims.stateCount);
+            call.addDoubles(inInverseEigenVectors, dims.stateCount * dims.stateCount);
+            call.addDoubles(inEigenValues, eigenValueCount);
+            workloadRecorder->write(call);
+        }
         DEBUG_END_TIME();
         return returnValue;
     }
@@ -877,10 +1362,18 @@ int beagleSetStateFrequencies(int instance,
                               int stateFrequenciesIndex,
                               const double* inStateFrequencies) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
     beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
     if (beagleInstance == NULL)
         return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
     int returnValue = beagleInstance->setStateFrequencies(stateFrequenciesIndex, inStateFrequencies);
+    if (workloadRecorder != NULL) {
+        const InstanceArguments& dims = (*instanceArguments)[instance];
+        beagle::WorkloadCall call(beagle::WORKLOAD_SET_STATE_FREQUENCIES, instance, returnValue);
+        call.addInt(stateFrequenciesIndex);
+        call.addDoubles(inStateFrequencies, dims.stateCount);
+        workloadRecorder->write(call);
+    }
     DEBUG_END_TIME();
     return returnValue;
 }
@@ -889,10 +1382,18 @@ int beagleSetCategoryWeights(int instance,
                              int categoryWeightsIndex,
                              const double* inCategoryWeights) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
     beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
     if (beagleInstance == NULL)
         return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
     int returnValue = beagleInstance->setCategoryWeights(categoryWeightsIndex, inCategoryWeights);
+    if (workloadRecorder != NULL) {
+        const InstanceArguments& dims = (*instanceArguments)[instance];
+        beagle::WorkloadCall call(beagle::WORKLOAD_SET_CATEGORY_WEIGHTS, instance, returnValue);
+        call.addInt(categoryWeightsIndex);
+        call.addDoubles(inCategoryWeights, dims.categoryCount);
+        workloadRecorder->write(call);
+    }
     DEBUG_END_TIME();
     return returnValue;
 }
@@ -900,10 +1401,17 @@ int beagleSetCategoryWeights(int instance,
 int beagleSetPatternWeights(int instance,
                             const double* inPatternWeights) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
     beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
     if (beagleInstance == NULL)
         return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
     int returnValue = beagleInstance->setPatternWeights(inPatternWeights);
+    if (workloadRecorder != NULL) {
+        const InstanceArguments& dims = (*instanceArguments)[instance];
+        beagle::WorkloadCall call(beagle::WORKLOAD_SET_PATTERN_WEIGHTS, instance, returnValue);
+        call.addDoubles(inPatternWeights, dims.patternCount, workloadRecorder->storesData());
+        workloadRecorder->write(call);
+    }
     DEBUG_END_TIME();
     return returnValue;
 }
@@ -912,10 +1420,18 @@ int beagleSetPatternPartitions(int instance,
                                int partitionCount,
                                const int* inPatternPartitions) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
     beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
     if (beagleInstance == NULL)
         return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
     int returnValue = beagleInstance->setPatternPartitions(partitionCount, inPatternPartitions);
+    if (workloadRecorder != NULL) {
+        const InstanceArguments& dims = (*instanceArguments)[instance];
+        beagle::WorkloadCall call(beagle::WORKLOAD_SET_PATTERN_PARTITIONS, instance, returnValue);
+        call.addInt(partitionCount);
+        call.addInts(inPatternPartitions, dims.patternCount);
+        workloadRecorder->write(call);
+    }
     DEBUG_END_TIME();
     return returnValue;
 }
@@ -923,11 +1439,18 @@ int beagleSetPatternPartitions(int instance,
 int beagleSetCategoryRates(int instance,
                      const double* inCategoryRates) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
 //    try {
         beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
         if (beagleInstance == NULL)
             return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
         int returnValue = beagleInstance->setCategoryRates(inCategoryRates);
+        if (workloadRecorder != NULL) {
+            const InstanceArguments& dims = (*instanceArguments)[instance];
+            beagle::WorkloadCall call(beagle::WORKLOAD_SET_CATEGORY_RATES, instance, returnValue);
+            call.addDoubles(inCategoryRates, dims.categoryCount);
+            workloadRecorder->write(call);
+        }
         DEBUG_END_TIME();
         return returnValue;
 //    }
@@ -946,10 +1469,18 @@ int beagleSetCategoryRatesWithIndex(int instance,
                                     int categoryRatesIndex,
                                     const double* inCategoryRates) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
     beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
     if (beagleInstance == NULL)
         return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
     int returnValue = beagleInstance->setCategoryRatesWithIndex(categoryRatesIndex, inCategoryRates);
+    if (workloadRecorder != NULL) {
+        const InstanceArguments& dims = (*instanceArguments)[instance];
+        beagle::WorkloadCall call(beagle::WORKLOAD_SET_CATEGORY_RATES_WITH_INDEX, instance, returnValue);
+        call.addInt(categoryRatesIndex);
+        call.addDoubles(inCategoryRates, dims.categoryCount);
+        workloadRecorder->write(call);
+    }
     DEBUG_END_TIME();
     return returnValue;
 }
@@ -959,11 +1490,21 @@ int beagleSetTransitionMatrix(int instance,
                         const double* inMatrix,
                         double paddedValue) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
 //    try {
         beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
         if (beagleInstance == NULL)
             return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
         int returnValue = beagleInstance->setTransitionMatrix(matrixIndex, inMatrix, paddedValue);
+        beagle::invalidateTreeMatrices(instance, &matrixIndex, 1);
+        if (workloadRecorder != NULL) {
+            const InstanceArguments& dims = (*instanceArguments)[instance];
+            beagle::WorkloadCall call(beagle::WORKLOAD_SET_TRANSITION_MATRIX, instance, returnValue);
+            call.addInt(matrixIndex);
+            call.addDoubles(inMatrix, dims.stateCount * dims.stateCount * dims.categoryCount);
+            call.addDouble(paddedValue);
+            workloadRecorder->write(call);
+        }
         DEBUG_END_TIME();
         return returnValue;
 //    }
@@ -984,11 +1525,22 @@ int beagleSetTransitionMatrices(int instance,
                               const double* paddedValues,
                               int count) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
     //    try {
     beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
     if (beagleInstance == NULL)
         return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
     int returnValue = beagleInstance->setTransitionMatrices(matrixIndices, inMatrices, paddedValues, count);
+    beagle::invalidateTreeMatrices(instance, matrixIndices, count);
+    if (workloadRecorder != NULL) {
+        const InstanceArguments& dims = (*instanceArguments)[instance];
+        beagle::WorkloadCall call(beagle::WORKLOAD_SET_TRANSITION_MATRICES, instance, returnValue);
+        call.addInt(count);
+        call.addInts(matrixIndices, count);
+        call.addDoubles(inMatrices, dims.stateCount * dims.stateCount * dims.categoryCount * count);
+        call.addDoubles(paddedValues, count);
+        workloadRecorder->write(call);
+    }
     DEBUG_END_TIME();
     return returnValue;
     //    }
@@ -1007,10 +1559,16 @@ int beagleGetTransitionMatrix(int instance,
                               int matrixIndex,
                               double* outMatrix) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
     beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
     if (beagleInstance == NULL)
         return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
     int returnValue = beagleInstance->getTransitionMatrix(matrixIndex,outMatrix);
+    if (workloadRecorder != NULL) {
+        beagle::WorkloadCall call(beagle::WORKLOAD_GET_TRANSITION_MATRIX, instance, returnValue);
+        call.addInt(matrixIndex);
+        workloadRecorder->write(call);
+    }
     DEBUG_END_TIME();
     return returnValue;
 }
@@ -1025,6 +1583,7 @@ int beagleConvolveTransitionMatrices(int instance,
                                      const int* resultIndices,
                                      const int matrixCount) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
     beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
 
     if (beagleInstance == NULL) {
@@ -1032,6 +1591,15 @@ int beagleConvolveTransitionMatrices(int instance,
     } else {
         int returnValue = beagleInstance->convolveTransitionMatrices(firstIndices,
                                            secondIndices, resultIndices, matrixCount);
+        beagle::invalidateTreeMatrices(instance, resultIndices, matrixCount);
+        if (workloadRecorder != NULL) {
+            beagle::WorkloadCall call(beagle::WORKLOAD_CONVOLVE_TRANSITION_MATRICES, instance, returnValue);
+            call.addInt(matrixCount);
+            call.addInts(firstIndices, matrixCount);
+            call.addInts(secondIndices, matrixCount);
+            call.addInts(resultIndices, matrixCount);
+            workloadRecorder->write(call);
+        }
         DEBUG_END_TIME();
         return returnValue;
     }
@@ -1046,6 +1614,7 @@ int beagleUpdateTransitionMatrices(int instance,
                              const double* edgeLengths,
                              int count) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
 //    try {
         beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
         if (beagleInstance == NULL)
@@ -1053,6 +1622,17 @@ int beagleUpdateTransitionMatrices(int instance,
         int returnValue = beagleInstance->updateTransitionMatrices(eigenIndex, probabilityIndices,
                                                         firstDerivativeIndices,
                                                         secondDerivativeIndices, edgeLengths, count);
+        beagle::invalidateTreeMatrices(instance, probabilityIndices, count);
+        if (workloadRecorder != NULL) {
+            beagle::WorkloadCall call(beagle::WORKLOAD_UPDATE_TRANSITION_MATRICES, instance, returnValue);
+            call.addInt(eigenIndex);
+            call.addInt(count);
+            call.addInts(probabilityIndices, count);
+            call.addInts(firstDerivativeIndices, count);
+            call.addInts(secondDerivativeIndices, count);
+            call.addDoubles(edgeLengths, count);
+            workloadRecorder->write(call);
+        }
         DEBUG_END_TIME();
         return returnValue;
 //    }
@@ -1075,6 +1655,7 @@ int beagleUpdateTransitionMatricesWithModelCategories(int instance,
                              const double* edgeLengths,
                              int count) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
 //    try {
         beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
         if (beagleInstance == NULL)
@@ -1082,6 +1663,18 @@ int beagleUpdateTransitionMatricesWithModelCategories(int instance,
         int returnValue = beagleInstance->updateTransitionMatricesWithModelCategories(eigenIndices, probabilityIndices,
                                                         firstDerivativeIndices,
                                                         secondDerivativeIndices, edgeLengths, count);
+        beagle::invalidateTreeMatrices(instance, probabilityIndices, count);
+        if (workloadRecorder != NULL) {
+            const InstanceArguments& dims = (*instanceArguments)[instance];
+            beagle::WorkloadCall call(beagle::WORKLOAD_UPDATE_TRANSITION_MATRICES_CATEGORIES, instance, returnValue);
+            call.addInt(count);
+            call.addInts(eigenIndices, dims.categoryCount);
+            call.addInts(probabilityIndices, count);
+            call.addInts(firstDerivativeIndices, count);
+            call.addInts(secondDerivativeIndices, count);
+            call.addDoubles(edgeLengths, count);
+            workloadRecorder->write(call);
+        }
         DEBUG_END_TIME();
         return returnValue;
 //    }
@@ -1106,12 +1699,25 @@ int beagleUpdateTransitionMatricesWithMultipleModels(int instance,
                                                      const double* edgeLengths,
                                                      int count) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
     beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
     if (beagleInstance == NULL)
         return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
     int returnValue = beagleInstance->updateTransitionMatricesWithMultipleModels(eigenIndices, categoryRateIndices,
                                                                                  probabilityIndices, firstDerivativeIndices,
                                                                                  secondDerivativeIndices, edgeLengths, count);
+    beagle::invalidateTreeMatrices(instance, probabilityIndices, count);
+    if (workloadRecorder != NULL) {
+        beagle::WorkloadCall call(beagle::WORKLOAD_UPDATE_TRANSITION_MATRICES_MODELS, instance, returnValue);
+        call.addInt(count);
+        call.addInts(eigenIndices, count);
+        call.addInts(categoryRateIndices, count);
+        call.addInts(probabilityIndices, count);
+        call.addInts(firstDerivativeIndices, count);
+        call.addInts(secondDerivativeIndices, count);
+        call.addDoubles(edgeLengths, count);
+        workloadRecorder->write(call);
+    }
     DEBUG_END_TIME();
     return returnValue;
 }
@@ -1122,11 +1728,19 @@ int beagleUpdatePartials(const int instance,
                    int operationCount,
                    int cumulativeScalingIndex) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
 //    try {
         beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
         if (beagleInstance == NULL)
             return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
         int returnValue = beagleInstance->updatePartials((const int*)operations, operationCount, cumulativeScalingIndex);
+        if (workloadRecorder != NULL) {
+            beagle::WorkloadCall call(beagle::WORKLOAD_UPDATE_PARTIALS, instance, returnValue);
+            call.addInt(operationCount);
+            call.addInt(cumulativeScalingIndex);
+            call.addInts((const int*) operations, operationCount * operationLength);
+            workloadRecorder->write(call);
+        }
         DEBUG_END_TIME();
         return returnValue;
 //    }
@@ -1145,24 +1759,160 @@ int beagleUpdatePartialsByPartition(const int instance,
                                     const BeagleOperationByPartition* operations,
                                     int operationCount) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
     beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
     if (beagleInstance == NULL)
         return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
     int returnValue = beagleInstance->updatePartialsByPartition((const int*)operations, operationCount);
+    if (workloadRecorder != NULL) {
+        beagle::WorkloadCall call(beagle::WORKLOAD_UPDATE_PARTIALS_BY_PARTITION, instance, returnValue);
+        call.addInt(operationCount);
+        call.addInts((const int*) operations, operationCount * partitionOperationLength);
+        workloadRecorder->write(call);
+    }
     DEBUG_END_TIME();
     return returnValue;
 }
 
+int beagleSetTree(int instance,
+                  const BeagleOperation* operations,
+                  int operationCount,
+                  int cumulativeScaleIndex) {
+    DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
+    try {
+        beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
+        if (beagleInstance == NULL)
+            return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
+        if (operations == NULL || operationCount == 0) {
+            beagle::deleteIncrementalTree(instance);
+            if (workloadRecorder != NULL) {
+                beagle::WorkloadCall call(beagle::WORKLOAD_SET_TREE, instance, BEAGLE_SUCCESS);
+                call.addInt(0);
+                call.addInt(cumulativeScaleIndex);
+                call.addInts(NULL, 0);
+                workloadRecorder->write(call);
+            }
+            return BEAGLE_SUCCESS;
+        }
+        beagle::IncrementalTree* tree = beagle::getIncrementalTree(instance);
+        if (tree == NULL) {
+            tree = new beagle::IncrementalTree();
+            IncrementalTreeMap[instance] = tree;
+        }
+        int returnValue = tree->setTree(operations, operationCount, cumulativeScaleIndex);
+        if (workloadRecorder != NULL) {
+            beagle::WorkloadCall call(beagle::WORKLOAD_SET_TREE, instance, returnValue);
+            call.addInt(operationCount);
+            call.addInt(cumulativeScaleIndex);
+            call.addInts((const int*) operations, operationCount * operationLength);
+            workloadRecorder->write(call);
+        }
+        DEBUG_END_TIME();
+        return returnValue;
+    }
+    catch (std::bad_alloc &) {
+        return BEAGLE_ERROR_OUT_OF_MEMORY;
+    }
+    catch (...) {
+        return BEAGLE_ERROR_UNIDENTIFIED_EXCEPTION;
+    }
+}
+
+int beagleInvalidatePartials(int instance,
+                             const int* bufferIndices,
+                             int count) {
+    TRACE_API_CALL(instance);
+    if (beagle::getBeagleInstance(instance) == NULL)
+        return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
+    beagle::IncrementalTree* tree = beagle::getIncrementalTree(instance);
+    if (tree == NULL)
+        return BEAGLE_ERROR_GENERAL;
+    try {
+        tree->invalidatePartials(bufferIndices, count);
+        if (workloadRecorder != NULL) {
+            beagle::WorkloadCall call(beagle::WORKLOAD_INVALIDATE_PARTIALS, instance, BEAGLE_SUCCESS);
+            call.addInt(count);
+            call.addInts(bufferIndices, count);
+            workloadRecorder->write(call);
+        }
+        return BEAGLE_SUCCESS;
+    }
+    catch (std::bad_alloc &) {
+        return BEAGLE_ERROR_OUT_OF_MEMORY;
+    }
+}
+
+int beagleInvalidateTransitionMatrices(int instance,
+                                       const int* matrixIndices,
+                                       int count) {
+    TRACE_API_CALL(instance);
+    if (beagle::getBeagleInstance(instance) == NULL)
+        return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
+    beagle::IncrementalTree* tree = beagle::getIncrementalTree(instance);
+    if (tree == NULL)
+        return BEAGLE_ERROR_GENERAL;
+    try {
+        tree->invalidateTransitionMatrices(matrixIndices, count);
+        if (workloadRecorder != NULL) {
+            beagle::WorkloadCall call(beagle::WORKLOAD_INVALIDATE_TRANSITION_MATRICES, instance, BEAGLE_SUCCESS);
+            call.addInt(count);
+            call.addInts(matrixIndices, count);
+            workloadRecorder->write(call);
+        }
+        return BEAGLE_SUCCESS;
+    }
+    catch (std::bad_alloc &) {
+        return BEAGLE_ERROR_OUT_OF_MEMORY;
+    }
+}
+
+int beagleUpdateTree(int instance) {
+    DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
+    try {
+        beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
+        if (beagleInstance == NULL)
+            return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
+        beagle::IncrementalTree* tree = beagle::getIncrementalTree(instance);
+        if (tree == NULL)
+            return BEAGLE_ERROR_GENERAL;
+        int returnValue = tree->update(beagleInstance);
+        if (workloadRecorder != NULL) {
+            beagle::WorkloadCall call(beagle::WORKLOAD_UPDATE_TREE, instance, returnValue);
+            workloadRecorder->write(call);
+        }
+        DEBUG_END_TIME();
+        return returnValue;
+    }
+    catch (std::bad_alloc &) {
+        return BEAGLE_ERROR_OUT_OF_MEMORY;
+    }
+    catch (std::out_of_range &) {
+        return BEAGLE_ERROR_OUT_OF_RANGE;
+    }
+    catch (...) {
+        return BEAGLE_ERROR_UNIDENTIFIED_EXCEPTION;
+    }
+}
+
 int beagleWaitForPartials(const int instance,
                     const int* destinationPartials,
                     int destinationPartialsCount) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
 //    try {
         beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
         if (beagleInstance == NULL)
             return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
         int returnValue = beagleInstance->waitForPartials(destinationPartials,
                                                   destinationPartialsCount);
+        if (workloadRecorder != NULL) {
+            beagle::WorkloadCall call(beagle::WORKLOAD_WAIT_FOR_PARTIALS, instance, returnValue);
+            call.addInt(destinationPartialsCount);
+            call.addInts(destinationPartials, destinationPartialsCount);
+            workloadRecorder->write(call);
+        }
         DEBUG_END_TIME();
         return returnValue;
 //    }
@@ -1182,11 +1932,19 @@ int beagleAccumulateScaleFactors(int instance,
                            int count,
                            int cumulativeScalingIndex) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
 //    try {
         beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
         if (beagleInstance == NULL)
          return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
         int returnValue = beagleInstance->accumulateScaleFactors(scalingIndices, count, cumulativeScalingIndex);
+        if (workloadRecorder != NULL) {
+            beagle::WorkloadCall call(beagle::WORKLOAD_ACCUMULATE_SCALE_FACTORS, instance, returnValue);
+            call.addInt(count);
+            call.addInt(cumulativeScalingIndex);
+            call.addInts(scalingIndices, count);
+            workloadRecorder->write(call);
+        }
         DEBUG_END_TIME();
         return returnValue;
 //    }
@@ -1207,11 +1965,20 @@ int beagleAccumulateScaleFactorsByPartition(int instance,
                                             int cumulativeScalingIndex,
                                             int partitionIndex) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
 //    try {
         beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
         if (beagleInstance == NULL)
          return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
         int returnValue = beagleInstance->accumulateScaleFactorsByPartition(scalingIndices, count, cumulativeScalingIndex, partitionIndex);
+        if (workloadRecorder != NULL) {
+            beagle::WorkloadCall call(beagle::WORKLOAD_ACCUMULATE_SCALE_FACTORS_BY_PARTITION, instance, returnValue);
+            call.addInt(count);
+            call.addInt(cumulativeScalingIndex);
+            call.addInt(partitionIndex);
+            call.addInts(scalingIndices, count);
+            workloadRecorder->write(call);
+        }
         DEBUG_END_TIME();
         return returnValue;
 //    }
@@ -1231,11 +1998,19 @@ int beagleRemoveScaleFactors(int instance,
                            int count,
                            int cumulativeScalingIndex) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
 //    try {
         beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
         if (beagleInstance == NULL)
             return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
         int returnValue = beagleInstance->removeScaleFactors(scalingIndices, count, cumulativeScalingIndex);
+        if (workloadRecorder != NULL) {
+            beagle::WorkloadCall call(beagle::WORKLOAD_REMOVE_SCALE_FACTORS, instance, returnValue);
+            call.addInt(count);
+            call.addInt(cumulativeScalingIndex);
+            call.addInts(scalingIndices, count);
+            workloadRecorder->write(call);
+        }
         DEBUG_END_TIME();
         return returnValue;
 //    }
@@ -1256,11 +2031,20 @@ int beagleRemoveScaleFactorsByPartition(int instance,
                                         int cumulativeScalingIndex,
                                         int partitionIndex) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
 //    try {
         beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
         if (beagleInstance == NULL)
             return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
         int returnValue = beagleInstance->removeScaleFactorsByPartition(scalingIndices, count, cumulativeScalingIndex, partitionIndex);
+        if (workloadRecorder != NULL) {
+            beagle::WorkloadCall call(beagle::WORKLOAD_REMOVE_SCALE_FACTORS_BY_PARTITION, instance, returnValue);
+            call.addInt(count);
+            call.addInt(cumulativeScalingIndex);
+            call.addInt(partitionIndex);
+            call.addInts(scalingIndices, count);
+            workloadRecorder->write(call);
+        }
         DEBUG_END_TIME();
         return returnValue;
 //    }
@@ -1278,11 +2062,17 @@ int beagleRemoveScaleFactorsByPartition(int instance,
 int beagleResetScaleFactors(int instance,
                       int cumulativeScalingIndex) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
 //    try {
         beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
         if (beagleInstance == NULL)
             return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
         int returnValue = beagleInstance->resetScaleFactors(cumulativeScalingIndex);
+        if (workloadRecorder != NULL) {
+            beagle::WorkloadCall call(beagle::WORKLOAD_RESET_SCALE_FACTORS, instance, returnValue);
+            call.addInt(cumulativeScalingIndex);
+            workloadRecorder->write(call);
+        }
         DEBUG_END_TIME();
         return returnValue;
 //    }
@@ -1301,11 +2091,18 @@ int beagleResetScaleFactorsByPartition(int instance,
                                        int cumulativeScalingIndex,
                                        int partitionIndex) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
 //    try {
         beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
         if (beagleInstance == NULL)
             return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
         int returnValue = beagleInstance->resetScaleFactorsByPartition(cumulativeScalingIndex, partitionIndex);
+        if (workloadRecorder != NULL) {
+            beagle::WorkloadCall call(beagle::WORKLOAD_RESET_SCALE_FACTORS_BY_PARTITION, instance, returnValue);
+            call.addInt(cumulativeScalingIndex);
+            call.addInt(partitionIndex);
+            workloadRecorder->write(call);
+        }
         DEBUG_END_TIME();
         return returnValue;
 //    }
@@ -1324,11 +2121,18 @@ int beagleCopyScaleFactors(int instance,
                            int destScalingIndex,
                            int srcScalingIndex) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
     //    try {
     beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
     if (beagleInstance == NULL)
         return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
     int returnValue = beagleInstance->copyScaleFactors(destScalingIndex, srcScalingIndex);
+    if (workloadRecorder != NULL) {
+        beagle::WorkloadCall call(beagle::WORKLOAD_COPY_SCALE_FACTORS, instance, returnValue);
+        call.addInt(destScalingIndex);
+        call.addInt(srcScalingIndex);
+        workloadRecorder->write(call);
+    }
     DEBUG_END_TIME();
     return returnValue;
     //    }
@@ -1347,11 +2151,17 @@ int beagleGetScaleFactors(int instance,
                            int srcScalingIndex,
                            double* scaleFactors) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
     //    try {
     beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
     if (beagleInstance == NULL)
         return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
     int returnValue = beagleInstance->getScaleFactors(srcScalingIndex, scaleFactors);
+    if (workloadRecorder != NULL) {
+        beagle::WorkloadCall call(beagle::WORKLOAD_GET_SCALE_FACTORS, instance, returnValue);
+        call.addInt(srcScalingIndex);
+        workloadRecorder->write(call);
+    }
     DEBUG_END_TIME();
     return returnValue;
     //    }
@@ -1374,6 +2184,7 @@ int beagleCalculateRootLogLikelihoods(int instance,
                                       int count,
                                       double* outSumLogLikelihood) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
 //    try {
         beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
         if (beagleInstance == NULL)
@@ -1383,6 +2194,16 @@ int beagleCalculateRootLogLikelihoods(int instance,
                                                            cumulativeScaleIndices,
                                                            count,
                                                            outSumLogLikelihood);
+        if (workloadRecorder != NULL) {
+            beagle::WorkloadCall call(beagle::WORKLOAD_CALCULATE_ROOT, instance, returnValue);
+            call.addInt(count);
+            call.addInts(bufferIndices, count);
+            call.addInts(categoryWeightsIndices, count);
+            call.addInts(stateFrequenciesIndices, count);
+            call.addInts(cumulativeScaleIndices, count);
+            call.addDouble(*outSumLogLikelihood);
+            workloadRecorder->write(call);
+        }
         DEBUG_END_TIME();
 
 #ifdef BEAGLE_DEBUG_FP_REDUCED_PRECISION
@@ -1418,6 +2239,7 @@ int beagleCalculateRootLogLikelihoodsByPartition(int instance,
                                                  double* outSumLogLikelihoodByPartition,
                                                  double* outSumLogLikelihood) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
 //    try {
         beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
         if (beagleInstance == NULL)
@@ -1431,6 +2253,20 @@ int beagleCalculateRootLogLikelihoodsByPartition(int instance,
                                                                                  count,
                                                                                  outSumLogLikelihoodByPartition,
                                                                                  outSumLogLikelihood);
+        if (workloadRecorder != NULL) {
+            beagle::WorkloadCall call(beagle::WORKLOAD_CALCULATE_ROOT_BY_PARTITION, instance, returnValue);
+            int length = partitionCount * count;
+            call.addInt(count);
+            call.addInt(partitionCount);
+            call.addInts(bufferIndices, length);
+            call.addInts(categoryWeightsIndices, length);
+            call.addInts(stateFrequenciesIndices, length);
+            call.addInts(cumulativeScaleIndices, length);
+            call.addInts(partitionIndices, partitionCount);
+            call.addDoubles(outSumLogLikelihoodByPartition, partitionCount);
+            call.addDouble(*outSumLogLikelihood);
+            workloadRecorder->write(call);
+        }
         DEBUG_END_TIME();
 
 #ifdef BEAGLE_DEBUG_FP_REDUCED_PRECISION
@@ -1475,6 +2311,7 @@ int beagleCalculateEdgeLogLikelihoods(int instance,
                                       double* outSumFirstDerivative,
                                       double* outSumSecondDerivative) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
 //    try {
         beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
         if (beagleInstance == NULL)
@@ -1487,6 +2324,20 @@ int beagleCalculateEdgeLogLikelihoods(int instance,
                                                            count,
                                                            outSumLogLikelihood, outSumFirstDerivative,
                                                            outSumSecondDerivative);
+        if (workloadRecorder != NULL) {
+            beagle::WorkloadCall call(beagle::WORKLOAD_CALCULATE_EDGE, instance, returnValue);
+            call.addInt(count);
+            call.addInts(parentBufferIndices, count);
+            call.addInts(childBufferIndices, count);
+            call.addInts(probabilityIndices, count);
+            call.addInts(firstDerivativeIndices, count);
+            call.addInts(secondDerivativeIndices, count);
+            call.addInts(categoryWeightsIndices, count);
+            call.addInts(stateFrequenciesIndices, count);
+            call.addInts(cumulativeScaleIndices, count);
+            call.addDouble(*outSumLogLikelihood);
+            workloadRecorder->write(call);
+        }
         DEBUG_END_TIME();
 
 #ifdef BEAGLE_DEBUG_FP_REDUCED_PRECISION
@@ -1534,6 +2385,7 @@ int beagleCalculateEdgeLogLikelihoodsByPartition(int instance,
                                                  double* outSumSecondDerivativeByPartition,
                                                  double* outSumSecondDerivative) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
 //    try {
         beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
         if (beagleInstance == NULL)
@@ -1556,6 +2408,24 @@ int beagleCalculateEdgeLogLikelihoodsByPartition(int instance,
                                                         outSumFirstDerivative,
                                                         outSumSecondDerivativeByPartition,
                                                         outSumSecondDerivative);
+        if (workloadRecorder != NULL) {
+            beagle::WorkloadCall call(beagle::WORKLOAD_CALCULATE_EDGE_BY_PARTITION, instance, returnValue);
+            int length = partitionCount * count;
+            call.addInt(count);
+            call.addInt(partitionCount);
+            call.addInts(parentBufferIndices, length);
+            call.addInts(childBufferIndices, length);
+            call.addInts(probabilityIndices, length);
+            call.addInts(firstDerivativeIndices, length);
+            call.addInts(secondDerivativeIndices, length);
+            call.addInts(categoryWeightsIndices, length);
+            call.addInts(stateFrequenciesIndices, length);
+            call.addInts(cumulativeScaleIndices, length);
+            call.addInts(partitionIndices, partitionCount);
+            call.addDoubles(outSumLogLikelihoodByPartition, partitionCount);
+            call.addDouble(*outSumLogLikelihood);
+            workloadRecorder->write(call);
+        }
         DEBUG_END_TIME();
 
 #ifdef BEAGLE_DEBUG_FP_REDUCED_PRECISION
@@ -1593,10 +2463,15 @@ int beagleCalculateEdgeLogLikelihoodsByPartition(int instance,
 int beagleGetLogLikelihood(int instance,
                             double* outSumLogLikelihood) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
     beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
     if (beagleInstance == NULL)
         return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
     int returnValue = beagleInstance->getLogLikelihood(outSumLogLikelihood);
+    if (workloadRecorder != NULL) {
+        beagle::WorkloadCall call(beagle::WORKLOAD_GET_LOG_LIKELIHOOD, instance, returnValue);
+        workloadRecorder->write(call);
+    }
     DEBUG_END_TIME();
 
 #ifdef BEAGLE_DEBUG_FP_REDUCED_PRECISION
@@ -1613,11 +2488,16 @@ int beagleGetDerivatives(int instance,
                             double* outSumFirstDerivative,
                             double* outSumSecondDerivative) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
     beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
     if (beagleInstance == NULL)
         return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
     int returnValue = beagleInstance->getDerivatives(outSumFirstDerivative,
                                                      outSumSecondDerivative);
+    if (workloadRecorder != NULL) {
+        beagle::WorkloadCall call(beagle::WORKLOAD_GET_DERIVATIVES, instance, returnValue);
+        workloadRecorder->write(call);
+    }
     DEBUG_END_TIME();
 
 #ifdef BEAGLE_DEBUG_FP_REDUCED_PRECISION
@@ -1636,10 +2516,15 @@ int beagleGetDerivatives(int instance,
 int beagleGetSiteLogLikelihoods(int instance,
                                 double* outLogLikelihoods) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
     beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
     if (beagleInstance == NULL)
         return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
     int returnValue = beagleInstance->getSiteLogLikelihoods(outLogLikelihoods);
+    if (workloadRecorder != NULL) {
+        beagle::WorkloadCall call(beagle::WORKLOAD_GET_SITE_LOG_LIKELIHOODS, instance, returnValue);
+        workloadRecorder->write(call);
+    }
     DEBUG_END_TIME();
 
 #ifdef BEAGLE_DEBUG_FP_REDUCED_PRECISION
@@ -1658,10 +2543,15 @@ int beagleGetSiteDerivatives(int instance,
                              double* outFirstDerivatives,
                              double* outSecondDerivatives) {
     DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
     beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
     if (beagleInstance == NULL)
         return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
     int returnValue = beagleInstance->getSiteDerivatives(outFirstDerivatives, outSecondDerivatives);
+    if (workloadRecorder != NULL) {
+        beagle::WorkloadCall call(beagle::WORKLOAD_GET_SITE_DERIVATIVES, instance, returnValue);
+        workloadRecorder->write(call);
+    }
     DEBUG_END_TIME();
 
 #ifdef BEAGLE_DEBUG_FP_REDUCED_PRECISION
@@ -1679,3 +2569,112 @@ int beagleGetSiteDerivatives(int instance,
     return returnValue;
 }
 
+int beagleSetSiteLogLikelihoodsOutput(int instance,
+                                      double* outLogLikelihoods,
+                                      double* outFirstDerivatives,
+                                      double* outSecondDerivatives) {
+    DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
+    try {
+        beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
+        if (beagleInstance == NULL)
+            return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
+        int returnValue = beagleInstance->setSiteLogLikelihoodsOutput(outLogLikelihoods,
+                                                                      outFirstDerivatives,
+                                                                      outSecondDerivatives);
+        DEBUG_END_TIME();
+        return returnValue;
+    }
+    catch (std::bad_alloc &) {
+        return BEAGLE_ERROR_OUT_OF_MEMORY;
+    }
+    catch (...) {
+        return BEAGLE_ERROR_UNIDENTIFIED_EXCEPTION;
+    }
+}
+
+int beagleSetInstanceStatisticsEnabled(int instance,
+                                       int enabled) {
+    DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
+    try {
+        beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
+        if (beagleInstance == NULL)
+            return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
+        int returnValue = beagleInstance->setStatisticsEnabled(enabled);
+        DEBUG_END_TIME();
+        return returnValue;
+    }
+    catch (std::bad_alloc &) {
+        return BEAGLE_ERROR_OUT_OF_MEMORY;
+    }
+    catch (...) {
+        return BEAGLE_ERROR_UNIDENTIFIED_EXCEPTION;
+    }
+}
+
+int beagleGetInstanceStatistics(int instance,
+                                BeagleInstanceStatistics* outStatistics) {
+    DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
+    try {
+        beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
+        if (beagleInstance == NULL)
+            return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
+        int returnValue = beagleInstance->getStatistics(outStatistics);
+        DEBUG_END_TIME();
+        return returnValue;
+    }
+    catch (std::bad_alloc &) {
+        return BEAGLE_ERROR_OUT_OF_MEMORY;
+    }
+    catch (...) {
+        return BEAGLE_ERROR_UNIDENTIFIED_EXCEPTION;
+    }
+}
+
+int beagleResetInstanceStatistics(int instance) {
+    DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
+    try {
+        beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
+        if (beagleInstance == NULL)
+            return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
+        int returnValue = beagleInstance->resetStatistics();
+        DEBUG_END_TIME();
+        return returnValue;
+    }
+    catch (std::bad_alloc &) {
+        return BEAGLE_ERROR_OUT_OF_MEMORY;
+    }
+    catch (...) {
+        return BEAGLE_ERROR_UNIDENTIFIED_EXCEPTION;
+    }
+}
+
+int beagleSaveInstance(int instance,
+                       const char* fileName) {
+    DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
+    beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
+    if (beagleInstance == NULL)
+        return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
+    int returnValue = beagleInstance->saveInstance(fileName);
+    DEBUG_END_TIME();
+    return returnValue;
+}
+
+int beagleLoadInstance(int instance,
+                       const char* fileName) {
+    DEBUG_START_TIME();
+    TRACE_API_CALL(instance);
+    beagle::BeagleImpl* beagleInstance = beagle::getBeagleInstance(instance);
+    if (beagleInstance == NULL)
+        return BEAGLE_ERROR_UNINITIALIZED_INSTANCE;
+    int returnValue = beagleInstance->loadInstance(fileName);
+    beagle::IncrementalTree* tree = beagle::getIncrementalTree(instance);
+    if (tree != NULL)
+        tree->invalidateAll();
+    DEBUG_END_TIME();
+    return returnValue;
+}
@@ -211,6 +211,42 @@ enum BeagleOpCodes {
     BEAGLE_OP_NONE               = -1 /**< Specify no use for indexed buffer */
 };
 
+/**
+ * @brief Kernel families timed by instance statistics
+ *
+ * This enumerates the groups of kernels with separate counters in BeagleInstanceStatistics.
+ */
+enum BeagleStatisticsKernels {
+    BEAGLE_STATISTICS_STATES_STATES     = 0, /**< Partials from two compact tips */
+    BEAGLE_STATISTICS_STATES_PARTIALS   = 1, /**< Partials from a compact tip and a partials buffer */
+    BEAGLE_STATISTICS_PARTIALS_PARTIALS = 2, /**< Partials from two partials buffers */
+    BEAGLE_STATISTICS_RESCALE           = 3, /**< Rescaling of partials */
+    BEAGLE_STATISTICS_MATRIX_UPDATE     = 4, /**< Transition matrix updates */
+    BEAGLE_STATISTICS_ROOT_INTEGRATION  = 5, /**< Root log likelihood integration */
+    BEAGLE_STATISTICS_EDGE_INTEGRATION  = 6, /**< Edge log likelihood and derivative integration */
+    BEAGLE_STATISTICS_KERNEL_COUNT      = 7  /**< Number of kernel families */
+};
+
+/**
+ * @brief Counters for one kernel family
+ */
+typedef struct {
+    long long calls;    /**< Number of kernel calls */
+    double    time;     /**< Wall-clock time in seconds spent in the kernels */
+    long long patterns; /**< Number of site patterns processed, summed over calls */
+    long long bytes;    /**< Estimated number of bytes read and written, summed over calls */
+} BeagleKernelStatistics;
+
+/**
+ * @brief Runtime profiling counters of a specific instance
+ */
+typedef struct {
+    BeagleKernelStatistics kernels[BEAGLE_STATISTICS_KERNEL_COUNT]; /**< Counters indexed by
+                                                                     *   BeagleStatisticsKernels */
+    double threadIdleTime;  /**< Seconds worker threads spent waiting for work, summed over threads */
+    double threadWaitTime;  /**< Seconds the calling thread spent waiting for worker threads */
+} BeagleInstanceStatistics;
+
 /**
  * @brief Information about a specific instance
  */
@@ -225,6 +261,24 @@ typedef struct {
                          *   capabilities of the resource and implementation for this instance */
 } BeagleInstanceDetails;
 
+/**
+ * @brief Memory layout of the buffers of a specific instance
+ *
+ * Partials for category l, pattern k and state i are found at element
+ * (l * paddedPatternCount + k) * paddedStateCount + i of a partials buffer.
+ */
+typedef struct {
+    int elementSize;        /**< Size in bytes of each partials element (4 for single, 8 for double precision) */
+    int stateCount;         /**< Number of states */
+    int paddedStateCount;   /**< Number of states including padding */
+    int patternCount;       /**< Number of site patterns */
+    int paddedPatternCount; /**< Number of site patterns including padding */
+    int categoryCount;      /**< Number of rate categories */
+    int partialsLength;     /**< Number of elements in a partials buffer */
+    int tipStatesLength;    /**< Number of integers in a tip states buffer */
+    int alignment;          /**< Required alignment in bytes of caller-owned buffers */
+} BeagleBufferLayout;
+
 /**
  * @brief Description of a hardware resource
  */
@@ -315,6 +369,12 @@ BEAGLE_DLLEXPORT BeagleResourceList* beagleGetResourceList(void);
  * benchmark times and CPU performance ratios for each resource. Resources are benchmarked
  * with the given analysis parameters and the array is ordered from fastest to slowest.
  * If there is an error the function returns NULL.
+ *
+ * Benchmark results are cached on disk and reused by later calls and processes with the
+ * same library version, resource and parameters; tip and pattern counts of a similar
+ * magnitude are estimated from cached results. The cache file is $HOME/.beagle-benchmark-cache
+ * unless the BEAGLE_BENCHMARK_CACHE environment variable gives another path or is set to
+ * "off". Setting BEAGLE_BENCHMARK_CACHE_CLEAR discards the cache on first use.
  * 
  * @param tipCount              Number of tip data elements (input)
  * @param compactBufferCount    Number of compact state representation tips (input)
@@ -351,6 +411,16 @@ BEAGLE_DLLEXPORT BeagleBenchmarkedResourceList* beagleGetBenchmarkedResourceList
                                                     int calculateDerivatives,
                                                     long benchmarkFlags);
 
+/**
+ * @brief Clear the benchmark cache
+ *
+ * This function discards all cached benchmark results used by
+ * beagleGetBenchmarkedResourceList, so that resources are benchmarked again.
+ *
+ * @return error code
+ */
+BEAGLE_DLLEXPORT int beagleClearBenchmarkCache(void);
+
 /**
  * @brief Create a single instance
  *
@@ -358,6 +428,35 @@ BEAGLE_DLLEXPORT BeagleBenchmarkedResourceList* beagleGetBenchmarkedResourceList
  * multiple times to create multiple data partition instances each returning a unique
  * identifier.
  *
+ * If the environment variable BEAGLE_TRACE is set to a file name when the first instance is
+ * created, API calls, kernels and thread pool activity of all instances are recorded and
+ * written to that file in Chrome trace JSON format whenever an instance is finalized and when
+ * the library is finalized.
+ *
+ * If the environment variable BEAGLE_RECORD is set to a file name when the first instance is
+ * created, the calls made on all instances are logged with their arguments to that file, for
+ * replay with examples/workloadreplay. Tip data, partials and pattern weights are only logged if
+ * BEAGLE_RECORD_DATA is also set; otherwise a replay substitutes synthetic data.
+ *
+ * Resource-implementation pairs are ranked by how many preferenceFlags they match, and then by
+ * an analytical estimate of their run time for this problem size, calibrated once per machine
+ * and kept in ~/.beagle-performance-model. Pairs estimated to be several times slower than the
+ * fastest, such as GPU implementations for small problems, are tried last whatever their flags,
+ * and BEAGLE_FLAG_THREADING_CPP is ignored when only preferred and threading is not expected to
+ * pay off. Precision is never changed by the estimate. Setting the environment variable
+ * BEAGLE_PERFORMANCE_MODEL to "off" ranks by flags alone; any other value names the calibration
+ * file.
+ *
+ * OpenCL implementations keep compiled kernel programs in ~/.beagle-opencl-cache, keyed by
+ * device, driver, state count, precision and build options, so that only the first instance of
+ * each kind compiles its kernels. The environment variable BEAGLE_OPENCL_CACHE sets another
+ * directory, or switches the cache off if set to "off".
+ *
+ * Plugins are loaded when first needed. An instance restricted to resource 0, or requiring
+ * BEAGLE_FLAG_FRAMEWORK_CPU, loads only the CPU plugins; listing resources loads all of them.
+ * The environment variable BEAGLE_PLUGINS, a comma-separated list such as "cpu,cuda",
+ * restricts which plugins may be loaded at all.
+ *
  * @param tipCount              Number of tip data elements (input)
  * @param partialsBufferCount   Number of partials buffers to create (input)
  * @param compactBufferCount    Number of compact state representation buffers to create (input)
@@ -418,6 +517,24 @@ BEAGLE_DLLEXPORT int beagleFinalizeInstance(int instance);
  */
 BEAGLE_DLLEXPORT int beagleFinalize(void);
 
+/**
+ * @brief Clone an instance
+ *
+ * This function creates a new instance with the same dimensions, resource and flags as an
+ * existing instance and the same contents. Partials, tip states and transition matrices are
+ * shared copy-on-write between the instances: a buffer is only duplicated when either instance
+ * first writes to it, so the clone is cheap to create when it will only modify a few buffers.
+ * Other buffers, and caller-owned buffers (see beagleSetPartialsBuffer), are copied. No other call
+ * may be in progress on the source instance while it is being cloned. Either instance may be finalized first.
+ *
+ * @param instance      Instance number of the instance to clone (input)
+ * @param returnInfo    Pointer to return implementation and resource details (output)
+ *
+ * @return the new instance number (>= 0) on success, or an error code (< 0)
+ */
+BEAGLE_DLLEXPORT int beagleCloneInstance(int instance,
+                                         BeagleInstanceDetails* returnInfo);
+
 /**
  * @brief Set number of threads for native CPU implementation
  *
@@ -428,6 +545,13 @@ BEAGLE_DLLEXPORT int beagleFinalize(void);
  * If BEAGLE_FLAG_THREADING_CPP is set and this function is not called BEAGLE will use 
  * a heuristic to set an appropriate number of threads.
  *
+ * With BEAGLE_FLAG_THREADING_CPP, the first instance of a given combination of state count,
+ * pattern count (to the nearest power of two), category count, implementation and CPU model
+ * briefly times candidate thread counts when it is created and stores the fastest in the file
+ * ~/.beagle-cpu-autotune; later instances of that shape, and this function, use the stored
+ * value, never exceeding threadCount. The environment variable BEAGLE_CPU_AUTOTUNE sets another
+ * file, or switches measuring off and restores the fixed heuristic if set to "off".
+ *
  * @param instance             Instance number (input)
  * @param threadCount          Number of threads (input)
  *
@@ -506,6 +630,62 @@ BEAGLE_DLLEXPORT int beagleGetPartials(int instance,
                       int scaleIndex,
                       double* outPartials);
 
+/**
+ * @brief Get the memory layout of instance buffers
+ *
+ * This function describes the native precision, padding and alignment of the partials and tip
+ * states buffers of an instance, so that callers can prepare buffers for
+ * beagleSetPartialsBuffer and beagleSetTipStatesBuffer.
+ *
+ * @param instance      Instance number (input)
+ * @param returnLayout  Pointer to return buffer layout (output)
+ *
+ * @return error code
+ */
+BEAGLE_DLLEXPORT int beagleGetBufferLayout(int instance,
+                                           BeagleBufferLayout* returnLayout);
+
+/**
+ * @brief Use a caller-owned array as an instance partials buffer
+ *
+ * This function makes an instance use the array inPartials as a partials buffer without copying
+ * it. The array must follow the layout returned by beagleGetBufferLayout, including zeroed
+ * padding, and must stay valid until the instance is finalized or the buffer is replaced. The
+ * caller keeps ownership and the instance never frees it. For a tip, the array is only read; for
+ * an internal node, beagleUpdatePartials writes its results directly into the array. Calling
+ * beagleSetPartials or beagleSetTipPartials on the buffer, setting pattern partitions that reorder
+ * patterns, or loading a checkpoint replaces the array with an instance-owned copy.
+ *
+ * @param instance      Instance number (input)
+ * @param bufferIndex   Index of partialsBuffer (input)
+ * @param inPartials    Pointer to caller-owned partials array, in native precision (input)
+ *
+ * @return error code
+ */
+BEAGLE_DLLEXPORT int beagleSetPartialsBuffer(int instance,
+                                             int bufferIndex,
+                                             void* inPartials);
+
+/**
+ * @brief Use a caller-owned array as tip states
+ *
+ * This function makes an instance use the array inStates as the compact states of a tip without
+ * copying it. The array must be tipStatesLength in length (see beagleGetBufferLayout), hold
+ * states from 0 to stateCount - 1 with missing data and padding set to stateCount, and stay valid
+ * until the instance is finalized or the states are replaced. The array is only read by the
+ * instance, which never frees it. Calling beagleSetTipStates, setting pattern partitions that
+ * reorder patterns, or loading a checkpoint replaces the array with an instance-owned copy.
+ *
+ * @param instance      Instance number (input)
+ * @param tipIndex      Index of destination compactBuffer (input)
+ * @param inStates      Pointer to caller-owned compact states array (input)
+ *
+ * @return error code
+ */
+BEAGLE_DLLEXPORT int beagleSetTipStatesBuffer(int instance,
+                                              int tipIndex,
+                                              int* inStates);
+
 /**
  * @brief Set an eigen-decomposition buffer
  *
@@ -864,6 +1044,79 @@ BEAGLE_DLLEXPORT int beagleUpdatePartialsByPartition(const int instance,
                                                      const BeagleOperationByPartition* operations,
                                                      int operationCount);
 
+/**
+ * @brief Set the tree topology for incremental partials updates
+ *
+ * This function gives an instance the complete list of operations, in post-order, that computes
+ * the partials of a tree from its tips to its root. The instance then tracks which partials buffers
+ * and transition matrices have changed, and beagleUpdateTree recomputes only the operations on the
+ * paths from them to the root. Buffers written through beagleSetTipStates, beagleSetTipPartials,
+ * beagleSetPartials, beagleSetTransitionMatrix, beagleSetTransitionMatrices,
+ * beagleConvolveTransitionMatrices and the beagleUpdateTransitionMatrices functions are marked as
+ * changed automatically. Calling this function again replaces the tree and marks all operations
+ * for recomputation. Passing no operations removes the tree.
+ *
+ * @param instance              Instance number (input)
+ * @param operations            BeagleOperation list of the whole tree in post-order (input)
+ * @param operationCount        Number of operations (input)
+ * @param cumulativeScaleIndex  Index of the scaleBuffer that accumulates the scale factors of
+ *                               all operations, or BEAGLE_OP_NONE (input)
+ *
+ * @return error code
+ */
+BEAGLE_DLLEXPORT int beagleSetTree(int instance,
+                                   const BeagleOperation* operations,
+                                   int operationCount,
+                                   int cumulativeScaleIndex);
+
+/**
+ * @brief Mark partials buffers as changed
+ *
+ * This function marks partials buffers as changed for the tree set with beagleSetTree. It is only
+ * needed when a buffer changes in a way the instance cannot see, such as writing to a caller-owned
+ * buffer registered with beagleSetPartialsBuffer or beagleSetTipStatesBuffer.
+ *
+ * @param instance       Instance number (input)
+ * @param bufferIndices  List of indices of partialsBuffers or compactBuffers (input)
+ * @param count          Number of indices (input)
+ *
+ * @return error code
+ */
+BEAGLE_DLLEXPORT int beagleInvalidatePartials(int instance,
+                                              const int* bufferIndices,
+                                              int count);
+
+/**
+ * @brief Mark transition matrices as changed
+ *
+ * This function marks transition matrices as changed for the tree set with beagleSetTree, for
+ * changes the instance cannot see.
+ *
+ * @param instance       Instance number (input)
+ * @param matrixIndices  List of indices of transition matrices (input)
+ * @param count          Number of indices (input)
+ *
+ * @return error code
+ */
+BEAGLE_DLLEXPORT int beagleInvalidateTransitionMatrices(int instance,
+                                                        const int* matrixIndices,
+                                                        int count);
+
+/**
+ * @brief Recompute the partials that depend on changed buffers
+ *
+ * This function recomputes, in a single beagleUpdatePartials call, the operations of the tree
+ * set with beagleSetTree whose children have changed since the last update, and all their
+ * ancestors. If the tree has a cumulative scale buffer, the old scale factors of the recomputed
+ * operations are removed from it and the new ones added, so the cached scale factors of unchanged
+ * nodes are reused. The first update after beagleSetTree recomputes every operation.
+ *
+ * @param instance  Instance number (input)
+ *
+ * @return the number of operations recomputed (>= 0), or an error code (< 0)
+ */
+BEAGLE_DLLEXPORT int beagleUpdateTree(int instance);
+
 /**
  * @brief Block until all calculations that write to the specified partials have completed.
  *
@@ -1236,6 +1489,101 @@ BEAGLE_DLLEXPORT int beagleGetSiteLogLikelihoods(int instance,
 BEAGLE_DLLEXPORT int beagleGetSiteDerivatives(int instance,
                                     double* outFirstDerivatives,
                                     double* outSecondDerivatives);    
+
+/**
+ * @brief Set caller arrays to receive site log likelihoods and derivatives
+ *
+ * This function registers arrays, each patternCount in length, into which subsequent
+ * beagleCalculateRootLogLikelihoods and beagleCalculateEdgeLogLikelihoods calls (and their
+ * ByPartition variants) write site log likelihoods and derivatives as they are integrated, in the
+ * original pattern order even if pattern partitions have reordered patterns. No copy is needed
+ * after each call. By-partition calls only write the sites of the partitions they evaluate. Any
+ * array can be NULL, and passing NULL for all three stops the writes. The arrays must stay valid
+ * until they are replaced or the instance is finalized. Cloned instances do not inherit them.
+ *
+ * @param instance               Instance number (input)
+ * @param outLogLikelihoods      Pointer to destination for site log likelihoods, or NULL (output)
+ * @param outFirstDerivatives    Pointer to destination for site first derivatives, or NULL (output)
+ * @param outSecondDerivatives   Pointer to destination for site second derivatives, or NULL (output)
+ *
+ * @return error code
+ */
+BEAGLE_DLLEXPORT int beagleSetSiteLogLikelihoodsOutput(int instance,
+                                                       double* outLogLikelihoods,
+                                                       double* outFirstDerivatives,
+                                                       double* outSecondDerivatives);
+
+/**
+ * @brief Enable or disable runtime profiling counters
+ *
+ * This function starts or stops collection of the counters returned by
+ * beagleGetInstanceStatistics. Counters are disabled when an instance is created, and
+ * disabling them keeps the values collected so far.
+ *
+ * @param instance      Instance number (input)
+ * @param enabled       Non-zero to collect counters, zero to stop (input)
+ *
+ * @return error code
+ */
+BEAGLE_DLLEXPORT int beagleSetInstanceStatisticsEnabled(int instance,
+                                                        int enabled);
+
+/**
+ * @brief Get runtime profiling counters
+ *
+ * This function returns the number of calls, wall-clock time, patterns processed and estimated
+ * bytes touched for each kernel family, and the time spent idle or waiting in the thread pool,
+ * collected since the instance was created or the counters were last reset.
+ *
+ * @param instance          Instance number (input)
+ * @param outStatistics     Pointer to destination for the counters (output)
+ *
+ * @return error code
+ */
+BEAGLE_DLLEXPORT int beagleGetInstanceStatistics(int instance,
+                                                 BeagleInstanceStatistics* outStatistics);
+
+/**
+ * @brief Reset runtime profiling counters to zero
+ *
+ * @param instance      Instance number (input)
+ *
+ * @return error code
+ */
+BEAGLE_DLLEXPORT int beagleResetInstanceStatistics(int instance);
+
+/**
+ * @brief Save the state of an instance to a checkpoint file
+ *
+ * This function writes all partials, tip states, scale buffers, transition matrices, eigen
+ * decompositions, category rates, category weights, state frequencies and pattern weights of
+ * an instance to a versioned binary file. Buffers are stored in the native precision and padded
+ * layout of the instance, so that the file can be memory-mapped and copied back by
+ * beagleLoadInstance without any conversion.
+ *
+ * @param instance      Instance number (input)
+ * @param fileName      Path of the checkpoint file to create or overwrite (input)
+ *
+ * @return error code
+ */
+BEAGLE_DLLEXPORT int beagleSaveInstance(int instance,
+                                        const char* fileName);
+
+/**
+ * @brief Restore the state of an instance from a checkpoint file
+ *
+ * This function restores the state saved by beagleSaveInstance into an instance that was
+ * created with the same dimensions, flags and implementation, and that has the same pattern
+ * partitions set. Files that do not match the instance are rejected with BEAGLE_ERROR_GENERAL
+ * and leave the instance unchanged.
+ *
+ * @param instance      Instance number (input)
+ * @param fileName      Path of the checkpoint file to read (input)
+ *
+ * @return error code
+ */
+BEAGLE_DLLEXPORT int beagleLoadInstance(int instance,
+                                        const char* fileName);
     
 /* using C calling conventions so that C programs can successfully link the beagle library
  * (closing brace)
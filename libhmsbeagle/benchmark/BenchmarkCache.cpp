@@ -0,0 +1,385 @@
+/*
+ *  BenchmarkCache.cpp
+ *  Persistent cache of resource benchmark results
+ *
+ * Copyright 2009 Phylogenetic Likelihood Working Group
+ *
+ * This file is part of BEAGLE.
+ *
+ * BEAGLE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * BEAGLE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BEAGLE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <string>
+#include <vector>
+
+#include "libhmsbeagle/beagle.h"
+#include "libhmsbeagle/benchmark/BeagleBenchmark.h"
+#include "libhmsbeagle/benchmark/BenchmarkCache.h"
+
+#define BENCHMARK_CACHE_FIELD_COUNT 22
+
+namespace beagle {
+namespace benchmark {
+
+struct BenchmarkCacheEntry {
+    std::string version;
+    std::string resourceName;
+    std::string implName;
+    long preferenceFlags;
+    long requirementFlags;
+    int stateCount;
+    int ntaxa;
+    int nsites;
+    int rateCategoryCount;
+    int nreps;
+    int compactTipCount;
+    int rescaleFrequency;
+    int unrooted;
+    int calcderivs;
+    int eigenCount;
+    int partitionCount;
+    int manualScaling;
+    int instOnly;
+    int returnCode;
+    int resourceNumber;
+    long benchedFlags;
+    double benchmarkResult;
+};
+
+static std::vector<BenchmarkCacheEntry> cacheEntries;
+static std::list<std::string> cacheImplNames; // stable storage for returned implementation names
+static bool cacheLoaded = false;
+
+static bool getCachePath(std::string& path) {
+    const char* env = getenv(BENCHMARK_CACHE_ENV);
+    if (env != NULL) {
+        if (*env == '\0' || strcmp(env, "off") == 0)
+            return false;
+        path = env;
+        return true;
+    }
+
+    const char* home = getenv("HOME");
+#ifdef _WIN32
+    if (home == NULL)
+        home = getenv("USERPROFILE");
+#endif
+    if (home == NULL)
+        return false;
+    path = std::string(home) + "/" + BENCHMARK_CACHE_FILENAME;
+    return true;
+}
+
+static void writeCacheHeader(FILE* file) {
+    fprintf(file, "BEAGLE benchmark cache version %d\n", BENCHMARK_CACHE_VERSION);
+}
+
+static bool parseCacheEntry(char* line,
+                            BenchmarkCacheEntry& entry) {
+    char* fields[BENCHMARK_CACHE_FIELD_COUNT];
+    int fieldCount = 0;
+    char* field = line;
+    while (fieldCount < BENCHMARK_CACHE_FIELD_COUNT) {
+        fields[fieldCount++] = field;
+        char* tab = strchr(field, '\t');
+        if (tab == NULL)
+            break;
+        *tab = '\0';
+        field = tab + 1;
+    }
+    if (fieldCount != BENCHMARK_CACHE_FIELD_COUNT)
+        return false;
+
+    char* newline = strchr(fields[BENCHMARK_CACHE_FIELD_COUNT - 1], '\n');
+    if (newline != NULL)
+        *newline = '\0';
+
+    entry.version           = fields[0];
+    entry.resourceName      = fields[1];
+    entry.implName          = fields[2];
+    entry.preferenceFlags   = atol(fields[3]);
+    entry.requirementFlags  = atol(fields[4]);
+    entry.stateCount        = atoi(fields[5]);
+    entry.ntaxa             = atoi(fields[6]);
+    entry.nsites            = atoi(fields[7]);
+    entry.rateCategoryCount = atoi(fields[8]);
+    entry.nreps             = atoi(fields[9]);
+    entry.compactTipCount   = atoi(fields[10]);
+    entry.rescaleFrequency  = atoi(fields[11]);
+    entry.unrooted          = atoi(fields[12]);
+    entry.calcderivs        = atoi(fields[13]);
+    entry.eigenCount        = atoi(fields[14]);
+    entry.partitionCount    = atoi(fields[15]);
+    entry.manualScaling     = atoi(fields[16]);
+    entry.instOnly          = atoi(fields[17]);
+    entry.returnCode        = atoi(fields[18]);
+    entry.resourceNumber    = atoi(fields[19]);
+    entry.benchedFlags      = atol(fields[20]);
+    entry.benchmarkResult   = atof(fields[21]);
+
+    return (entry.ntaxa > 0 && entry.nsites > 0);
+}
+
+static void loadCache() {
+    cacheLoaded = true;
+    cacheEntries.clear();
+
+    std::string path;
+    if (!getCachePath(path))
+        return;
+
+    if (getenv(BENCHMARK_CACHE_CLEAR_ENV) != NULL) {
+        remove(path.c_str());
+        return;
+    }
+
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == NULL)
+        return;
+
+    char line[4096];
+    char header[128];
+    snprintf(header, sizeof(header), "BEAGLE benchmark cache version %d\n", BENCHMARK_CACHE_VERSION);
+    if (fgets(line, sizeof(line), file) != NULL && strcmp(line, header) == 0) {
+        while (fgets(line, sizeof(line), file) != NULL) {
+            BenchmarkCacheEntry entry;
+            if (parseCacheEntry(line, entry))
+                cacheEntries.push_back(entry);
+        }
+    }
+
+    fclose(file);
+}
+
+static void storeCacheEntry(const BenchmarkCacheEntry& entry) {
+    cacheEntries.push_back(entry);
+
+    std::string path;
+    if (!getCachePath(path))
+        return;
+
+    // files of another format version are replaced
+    bool validHeader = false;
+    FILE* file = fopen(path.c_str(), "r");
+    if (file != NULL) {
+        char line[128];
+        char header[128];
+        snprintf(header, sizeof(header), "BEAGLE benchmark cache version %d\n", BENCHMARK_CACHE_VERSION);
+        validHeader = (fgets(line, sizeof(line), file) != NULL && strcmp(line, header) == 0);
+        fclose(file);
+    }
+
+    file = fopen(path.c_str(), (validHeader ? "a" : "w"));
+    if (file == NULL)
+        return;
+    if (!validHeader)
+        writeCacheHeader(file);
+
+    // a single write per entry, so that concurrent processes appending to the file do not interleave
+    char line[4096];
+    int length = snprintf(line, sizeof(line),
+                          "%s\t%s\t%s\t%ld\t%ld\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%ld\t%.17g\n",
+                          entry.version.c_str(), entry.resourceName.c_str(), entry.implName.c_str(),
+                          entry.preferenceFlags, entry.requirementFlags, entry.stateCount,
+                          entry.ntaxa, entry.nsites, entry.rateCategoryCount, entry.nreps,
+                          entry.compactTipCount, entry.rescaleFrequency, entry.unrooted,
+                          entry.calcderivs, entry.eigenCount, entry.partitionCount,
+                          entry.manualScaling, entry.instOnly, entry.returnCode,
+                          entry.resourceNumber, entry.benchedFlags, entry.benchmarkResult);
+    if (length > 0 && length < (int) sizeof(line))
+        fputs(line, file);
+    fclose(file);
+}
+
+static int sizeBucket(int n) {
+    int bucket = 0;
+    while (n > 1) {
+        n >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+static int compactBucket(int compactTipCount,
+                         int ntaxa) {
+    if (compactTipCount == 0)
+        return 0;
+    return (compactTipCount >= ntaxa ? 2 : 1);
+}
+
+// all key fields except problem size
+static bool sameConfiguration(const BenchmarkCacheEntry& a,
+                              const BenchmarkCacheEntry& b) {
+    return (a.version == b.version &&
+            a.resourceName == b.resourceName &&
+            a.preferenceFlags == b.preferenceFlags &&
+            a.requirementFlags == b.requirementFlags &&
+            a.stateCount == b.stateCount &&
+            a.rateCategoryCount == b.rateCategoryCount &&
+            a.nreps == b.nreps &&
+            a.rescaleFrequency == b.rescaleFrequency &&
+            a.unrooted == b.unrooted &&
+            a.calcderivs == b.calcderivs &&
+            a.eigenCount == b.eigenCount &&
+            a.partitionCount == b.partitionCount &&
+            a.manualScaling == b.manualScaling &&
+            a.instOnly == b.instOnly);
+}
+
+/*
+ * Finds an entry for the same configuration and problem size, or estimates one
+ * from successful entries in the same tip, pattern and compact-tip buckets by
+ * interpolating linearly on tipCount * patternCount.
+ */
+static bool lookupCacheEntry(const BenchmarkCacheEntry& query,
+                             BenchmarkCacheEntry& result) {
+    const BenchmarkCacheEntry* below = NULL;
+    const BenchmarkCacheEntry* above = NULL;
+    double queryWork = (double) query.ntaxa * query.nsites;
+
+    for (size_t i = 0; i < cacheEntries.size(); i++) {
+        const BenchmarkCacheEntry& entry = cacheEntries[i];
+        if (!sameConfiguration(entry, query))
+            continue;
+        if (entry.ntaxa == query.ntaxa && entry.nsites == query.nsites &&
+            entry.compactTipCount == query.compactTipCount) {
+            result = entry;
+            return true;
+        }
+        if (entry.returnCode != BEAGLE_SUCCESS ||
+            sizeBucket(entry.ntaxa) != sizeBucket(query.ntaxa) ||
+            sizeBucket(entry.nsites) != sizeBucket(query.nsites) ||
+            compactBucket(entry.compactTipCount, entry.ntaxa) != compactBucket(query.compactTipCount, query.ntaxa))
+            continue;
+        double work = (double) entry.ntaxa * entry.nsites;
+        if (work <= queryWork && (below == NULL || work > (double) below->ntaxa * below->nsites))
+            below = &entry;
+        if (work >= queryWork && (above == NULL || work < (double) above->ntaxa * above->nsites))
+            above = &entry;
+    }
+
+    if (below == NULL && above == NULL)
+        return false;
+
+    if (below != NULL && above != NULL) {
+        double belowWork = (double) below->ntaxa * below->nsites;
+        double aboveWork = (double) above->ntaxa * above->nsites;
+        result = *below;
+        if (aboveWork > belowWork)
+            result.benchmarkResult = below->benchmarkResult +
+                (above->benchmarkResult - below->benchmarkResult) * (queryWork - belowWork) / (aboveWork - belowWork);
+    } else {
+        const BenchmarkCacheEntry* nearest = (below != NULL ? below : above);
+        result = *nearest;
+        result.benchmarkResult = nearest->benchmarkResult * queryWork / ((double) nearest->ntaxa * nearest->nsites);
+    }
+
+    return true;
+}
+
+int benchmarkResourceCached(int resource,
+                            int stateCount,
+                            int ntaxa,
+                            int nsites,
+                            bool manualScaling,
+                            int rateCategoryCount,
+                            int nreps,
+                            int compactTipCount,
+                            int rescaleFrequency,
+                            bool unrooted,
+                            bool calcderivs,
+                            int eigenCount,
+                            int partitionCount,
+                            long preferenceFlags,
+                            long requirementFlags,
+                            int* resourceNumber,
+                            char** implName,
+                            long* benchedFlags,
+                            double* benchmarkResult,
+                            bool instOnly) {
+    if (!cacheLoaded)
+        loadCache();
+
+    BeagleResourceList* resourceList = beagleGetResourceList();
+    if (resourceList == NULL || resource < 0 || resource >= resourceList->length)
+        return BEAGLE_ERROR_OUT_OF_RANGE;
+
+    BenchmarkCacheEntry query;
+    query.version           = beagleGetVersion();
+    query.resourceName      = resourceList->list[resource].name;
+    query.preferenceFlags   = preferenceFlags;
+    query.requirementFlags  = requirementFlags;
+    query.stateCount        = stateCount;
+    query.ntaxa             = ntaxa;
+    query.nsites            = nsites;
+    query.rateCategoryCount = rateCategoryCount;
+    query.nreps             = nreps;
+    query.compactTipCount   = compactTipCount;
+    query.rescaleFrequency  = rescaleFrequency;
+    query.unrooted          = unrooted;
+    query.calcderivs        = calcderivs;
+    query.eigenCount        = eigenCount;
+    query.partitionCount    = partitionCount;
+    query.manualScaling     = manualScaling;
+    query.instOnly          = instOnly;
+
+    BenchmarkCacheEntry cached;
+    if (lookupCacheEntry(query, cached)) {
+        cacheImplNames.push_back(cached.implName);
+        *resourceNumber  = cached.resourceNumber;
+        *implName        = (char*) cacheImplNames.back().c_str();
+        *benchedFlags    = cached.benchedFlags;
+        *benchmarkResult = cached.benchmarkResult;
+        return cached.returnCode;
+    }
+
+    *implName = NULL;
+    *benchmarkResult = 0.0;
+    int returnCode = benchmarkResource(resource, stateCount, ntaxa, nsites, manualScaling,
+                                       rateCategoryCount, nreps, compactTipCount, rescaleFrequency,
+                                       unrooted, calcderivs, eigenCount, partitionCount,
+                                       preferenceFlags, requirementFlags, resourceNumber,
+                                       implName, benchedFlags, benchmarkResult, instOnly);
+
+    // failures to create an instance depend on the problem size, so only successes are shared
+    if (returnCode == BEAGLE_SUCCESS) {
+        query.implName       = (*implName != NULL ? *implName : "");
+        query.returnCode     = returnCode;
+        query.resourceNumber = *resourceNumber;
+        query.benchedFlags   = *benchedFlags;
+        query.benchmarkResult = *benchmarkResult;
+        storeCacheEntry(query);
+    }
+
+    return returnCode;
+}
+
+int clearBenchmarkCache() {
+    cacheLoaded = true;
+    cacheEntries.clear();
+
+    std::string path;
+    if (getCachePath(path))
+        remove(path.c_str());
+
+    return BEAGLE_SUCCESS;
+}
+
+}   // namespace benchmark
+}   // namespace beagle
@@ -0,0 +1,67 @@
+/*
+ *  BenchmarkCache.h
+ *  Persistent cache of resource benchmark results
+ *
+ * Copyright 2009 Phylogenetic Likelihood Working Group
+ *
+ * This file is part of BEAGLE.
+ *
+ * BEAGLE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * BEAGLE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BEAGLE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __beagle_benchmark_cache__
+#define __beagle_benchmark_cache__
+
+#define BENCHMARK_CACHE_VERSION     1                           // increment whenever the file format changes
+#define BENCHMARK_CACHE_FILENAME    ".beagle-benchmark-cache"   // in the home directory
+#define BENCHMARK_CACHE_ENV         "BEAGLE_BENCHMARK_CACHE"    // cache file path, or "off" to disable
+#define BENCHMARK_CACHE_CLEAR_ENV   "BEAGLE_BENCHMARK_CACHE_CLEAR"  // if set, discard the cache on first use
+
+namespace beagle {
+namespace benchmark {
+
+/*
+ * Same as benchmarkResource, but results are looked up in and added to a cache
+ * file shared by all processes. Entries are keyed by library version, resource
+ * name and all benchmark parameters; tip and pattern counts only have to fall in
+ * the same power-of-two bucket, with results interpolated on tipCount * patternCount.
+ */
+int benchmarkResourceCached(int resource,
+                            int stateCount,
+                            int ntaxa,
+                            int nsites,
+                            bool manualScaling,
+                            int rateCategoryCount,
+                            int nreps,
+                            int compactTipCount,
+                            int rescaleFrequency,
+                            bool unrooted,
+                            bool calcderivs,
+                            int eigenCount,
+                            int partitionCount,
+                            long preferenceFlags,
+                            long requirementFlags,
+                            int* resourceNumber,
+                            char** implName,
+                            long* benchedFlags,
+                            double* benchmarkResult,
+                            bool instOnly);
+
+int clearBenchmarkCache();
+
+}   // namespace benchmark
+}   // namespace beagle
+
+#endif // __beagle_benchmark_cache__
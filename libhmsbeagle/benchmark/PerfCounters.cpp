@@ -0,0 +1,153 @@
+/*
+ *  PerfCounters.cpp
+ *  Hardware performance counters and roofline position of benchmark runs
+ *
+ * Copyright 2009 Phylogenetic Likelihood Working Group
+ *
+ * This file is part of BEAGLE.
+ *
+ * BEAGLE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * BEAGLE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BEAGLE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "libhmsbeagle/config.h"
+#endif
+
+#include <cstring>
+
+#ifdef HAVE_LINUX_PERF_EVENT_H
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "libhmsbeagle/benchmark/PerfCounters.h"
+
+namespace beagle {
+namespace benchmark {
+
+#ifdef HAVE_LINUX_PERF_EVENT_H
+static int openCounter(unsigned int type,
+                       unsigned long long config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;    // allowed without privileges at the default paranoia level
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+PerfCounters::PerfCounters() {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        fds[i] = -1;
+#ifdef HAVE_LINUX_PERF_EVENT_H
+    fds[PERF_COUNTER_CYCLES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    fds[PERF_COUNTER_INSTRUCTIONS] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    fds[PERF_COUNTER_L1D_MISSES] = openCounter(PERF_TYPE_HW_CACHE,
+                                               PERF_COUNT_HW_CACHE_L1D |
+                                               (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                               (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    fds[PERF_COUNTER_LLC_MISSES] = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef HAVE_LINUX_PERF_EVENT_H
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        if (fds[i] >= 0)
+            close(fds[i]);
+#endif
+}
+
+bool PerfCounters::isAvailable() const {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        if (fds[i] >= 0)
+            return true;
+    return false;
+}
+
+void PerfCounters::start() {
+#ifdef HAVE_LINUX_PERF_EVENT_H
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (fds[i] >= 0) {
+            ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+}
+
+void PerfCounters::stop(PerfCounterValues* outValues) {
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        outValues->counts[i] = 0;
+        outValues->valid[i] = false;
+    }
+#ifdef HAVE_LINUX_PERF_EVENT_H
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++)
+        if (fds[i] >= 0)
+            ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (fds[i] < 0)
+            continue;
+        // {value, time enabled, time running}
+        unsigned long long buffer[3];
+        if (read(fds[i], buffer, sizeof(buffer)) != (ssize_t) sizeof(buffer) || buffer[2] == 0)
+            continue;
+        double scale = (double) buffer[1] / buffer[2];
+        outValues->counts[i] = (long long) (buffer[0] * scale);
+        outValues->valid[i] = true;
+    }
+#endif
+}
+
+const char* getPerfCounterName(int event) {
+    static const char* names[PERF_COUNTER_COUNT] = {
+        "cycles", "instructions", "l1d_misses", "llc_misses"
+    };
+    return names[event];
+}
+
+RooflinePosition getRooflinePosition(double flops,
+                                     double bytes,
+                                     double seconds,
+                                     double peakGflops,
+                                     double peakBandwidth) {
+    RooflinePosition position;
+    position.intensity = (bytes > 0.0 ? flops / bytes : 0.0);
+    position.gflops = (seconds > 0.0 ? flops / seconds / 1e9 : 0.0);
+    position.attainableGflops = 0.0;
+    position.fractionOfRoof = 0.0;
+    position.memoryBound = false;
+
+    if (peakGflops > 0.0 && peakBandwidth > 0.0) {
+        double memoryRoof = position.intensity * peakBandwidth;
+        position.memoryBound = (memoryRoof < peakGflops);
+        position.attainableGflops = (position.memoryBound ? memoryRoof : peakGflops);
+        if (position.attainableGflops > 0.0)
+            position.fractionOfRoof = position.gflops / position.attainableGflops;
+    }
+
+    return position;
+}
+
+}   // namespace benchmark
+}   // namespace beagle
@@ -0,0 +1,93 @@
+/*
+ *  PerfCounters.h
+ *  Hardware performance counters and roofline position of benchmark runs
+ *
+ * Copyright 2009 Phylogenetic Likelihood Working Group
+ *
+ * This file is part of BEAGLE.
+ *
+ * BEAGLE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * BEAGLE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BEAGLE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __beagle_perf_counters__
+#define __beagle_perf_counters__
+
+#define PERF_COUNTERS_CACHE_LINE    64  // bytes moved from memory per last level cache miss
+
+namespace beagle {
+namespace benchmark {
+
+enum PerfCounterEvent {
+    PERF_COUNTER_CYCLES       = 0,
+    PERF_COUNTER_INSTRUCTIONS = 1,
+    PERF_COUNTER_L1D_MISSES   = 2,
+    PERF_COUNTER_LLC_MISSES   = 3,
+    PERF_COUNTER_COUNT        = 4
+};
+
+struct PerfCounterValues {
+    long long counts[PERF_COUNTER_COUNT];
+    bool valid[PERF_COUNTER_COUNT];     // false if the event could not be counted
+};
+
+/*
+ * User-space hardware counters of the calling thread, read through
+ * perf_event_open on Linux. Events the kernel or processor does not support are
+ * left invalid, as are all events on other systems; counts are scaled up if the
+ * kernel had to multiplex the counters.
+ */
+class PerfCounters {
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    // true if at least one event can be counted
+    bool isAvailable() const;
+
+    // zeroes and starts all counters
+    void start();
+
+    // stops all counters and returns their counts since start()
+    void stop(PerfCounterValues* outValues);
+
+private:
+    int fds[PERF_COUNTER_COUNT];
+};
+
+const char* getPerfCounterName(int event);
+
+struct RooflinePosition {
+    double intensity;           // FLOP per byte of compulsory memory traffic
+    double gflops;              // achieved
+    double attainableGflops;    // min(peak compute, intensity * peak bandwidth), 0 if peaks unknown
+    double fractionOfRoof;      // gflops / attainableGflops
+    bool memoryBound;           // intensity is left of the ridge point
+};
+
+/*
+ * Places a kernel run on the roofline of a machine from its known FLOP and byte
+ * counts. Peaks of zero mean unknown, in which case only intensity and
+ * achieved GFLOP/s are set.
+ */
+RooflinePosition getRooflinePosition(double flops,
+                                     double bytes,
+                                     double seconds,
+                                     double peakGflops,
+                                     double peakBandwidth);
+
+}   // namespace benchmark
+}   // namespace beagle
+
+#endif // __beagle_perf_counters__
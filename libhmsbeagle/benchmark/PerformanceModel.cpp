@@ -0,0 +1,220 @@
+/*
+ *  PerformanceModel.cpp
+ *  Analytical run-time estimates used to rank implementations at instance creation
+ *
+ * Copyright 2009 Phylogenetic Likelihood Working Group
+ *
+ * This file is part of BEAGLE.
+ *
+ * BEAGLE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * BEAGLE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BEAGLE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "libhmsbeagle/beagle.h"
+#include "libhmsbeagle/CPU/CPUAutotuner.h"
+#include "libhmsbeagle/benchmark/PerformanceModel.h"
+
+#define CALIBRATION_FLOP_ITERATIONS 2000000     // of 8 independent multiply-adds
+#define CALIBRATION_BANDWIDTH_BYTES (32 << 20)  // larger than the last level cache of most CPUs
+
+namespace beagle {
+namespace benchmark {
+
+static double getTime() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool getCalibrationPath(std::string& path) {
+    const char* env = getenv(PERFORMANCE_MODEL_ENV);
+    if (env != NULL) {
+        if (*env == '\0' || strcmp(env, "off") == 0)
+            return false;
+        path = env;
+        return true;
+    }
+
+    const char* home = getenv("HOME");
+#ifdef _WIN32
+    if (home == NULL)
+        home = getenv("USERPROFILE");
+#endif
+    if (home == NULL)
+        return false;
+    path = std::string(home) + "/" + PERFORMANCE_MODEL_FILENAME;
+    return true;
+}
+
+static double measureGflops() {
+    volatile double seed = 1.0;
+    double a[8];
+    for (int i = 0; i < 8; i++)
+        a[i] = seed + i * 1e-3;
+    const double b = 0.999999;
+    const double c = 1e-7;
+    double startTime = getTime();
+    for (int i = 0; i < CALIBRATION_FLOP_ITERATIONS; i++) {
+        for (int j = 0; j < 8; j++)
+            a[j] = a[j] * b + c;
+    }
+    double seconds = getTime() - startTime;
+    seed = a[0] + a[1] + a[2] + a[3] + a[4] + a[5] + a[6] + a[7];
+    return (seconds > 0.0 ? 2.0 * 8 * CALIBRATION_FLOP_ITERATIONS / seconds / 1e9 : 1.0);
+}
+
+static double measureBandwidth() {
+    std::vector<double> data(CALIBRATION_BANDWIDTH_BYTES / sizeof(double), 1.0);
+    volatile double sink = 0.0;
+    double best = 0.0;
+    for (int pass = 0; pass < 3; pass++) {
+        double sum = 0.0;
+        double startTime = getTime();
+        for (size_t i = 0; i < data.size(); i++)
+            sum += data[i];
+        double seconds = getTime() - startTime;
+        sink = sink + sum;
+        if (seconds > 0.0 && CALIBRATION_BANDWIDTH_BYTES / seconds / 1e9 > best)
+            best = CALIBRATION_BANDWIDTH_BYTES / seconds / 1e9;
+    }
+    return (best > 0.0 ? best : 1.0);
+}
+
+bool isPerformanceModelEnabled() {
+    const char* env = getenv(PERFORMANCE_MODEL_ENV);
+    return (env == NULL || strcmp(env, "off") != 0);
+}
+
+const MachineCalibration& getMachineCalibration() {
+    static MachineCalibration calibration;
+    static bool calibrated = false;
+    static std::mutex mutex;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (calibrated)
+        return calibration;
+
+    calibration.hardwareThreads = std::thread::hardware_concurrency();
+    if (calibration.hardwareThreads < 1)
+        calibration.hardwareThreads = 1;
+    std::string cpuModel = beagle::cpu::CPUAutotuner::getCPUModel();
+
+    // {version, CPU model, GFLOP/s, GB/s}
+    std::string path;
+    bool havePath = getCalibrationPath(path);
+    if (havePath) {
+        FILE* file = fopen(path.c_str(), "r");
+        if (file != NULL) {
+            char line[512];
+            int version = 0;
+            if (fgets(line, sizeof(line), file) != NULL && sscanf(line, "BEAGLE performance model version %d", &version) == 1 &&
+                version == PERFORMANCE_MODEL_VERSION && fgets(line, sizeof(line), file) != NULL &&
+                cpuModel == std::string(line, strcspn(line, "\r\n")) && fgets(line, sizeof(line), file) != NULL &&
+                sscanf(line, "%lf %lf", &calibration.gflops, &calibration.bandwidth) == 2 &&
+                calibration.gflops > 0.0 && calibration.bandwidth > 0.0) {
+                calibrated = true;
+            }
+            fclose(file);
+        }
+    }
+
+    if (!calibrated) {
+        calibration.gflops = measureGflops();
+        calibration.bandwidth = measureBandwidth();
+        calibrated = true;
+        if (havePath) {
+            FILE* file = fopen(path.c_str(), "w");
+            if (file != NULL) {
+                fprintf(file, "BEAGLE performance model version %d\n%s\n%.6f %.6f\n", PERFORMANCE_MODEL_VERSION,
+                        cpuModel.c_str(), calibration.gflops, calibration.bandwidth);
+                fclose(file);
+            }
+        }
+    }
+
+    return calibration;
+}
+
+double estimateEvaluationSeconds(long resourceFlags,
+                                 long implementationFlags,
+                                 bool threaded,
+                                 int tipCount,
+                                 int stateCount,
+                                 int patternCount,
+                                 int categoryCount) {
+    const MachineCalibration& calibration = getMachineCalibration();
+
+    // per partials update: two matrix-vector products and their product for
+    // every pattern, category and state; two child buffers read and one written
+    double elements = (double) patternCount * categoryCount * stateCount;
+    double flops = elements * (4.0 * stateCount + 1.0);
+    double bytes = elements * 3.0 * sizeof(double);
+    int operationCount = (tipCount > 2 ? tipCount - 1 : 1);
+
+    double gflops = calibration.gflops;
+    double bandwidth = calibration.bandwidth;
+    double latency = 0.0;
+    double evaluationLatency = 0.0;
+
+    if (implementationFlags & (BEAGLE_FLAG_FRAMEWORK_CUDA | BEAGLE_FLAG_FRAMEWORK_OPENCL)) {
+        if (resourceFlags & BEAGLE_FLAG_PROCESSOR_GPU) {
+            gflops *= PERFORMANCE_MODEL_GPU_COMPUTE;
+            bandwidth *= PERFORMANCE_MODEL_GPU_BANDWIDTH;
+        } else {
+            // OpenCL on the host processor uses all of its cores
+            gflops *= calibration.hardwareThreads;
+            bandwidth *= (calibration.hardwareThreads < PERFORMANCE_MODEL_BANDWIDTH_THREADS ?
+                          calibration.hardwareThreads : PERFORMANCE_MODEL_BANDWIDTH_THREADS);
+        }
+        latency = (implementationFlags & BEAGLE_FLAG_FRAMEWORK_CUDA ?
+                   PERFORMANCE_MODEL_CUDA_LAUNCH : PERFORMANCE_MODEL_OPENCL_LAUNCH);
+        evaluationLatency = PERFORMANCE_MODEL_DEVICE_SYNC;
+    } else {
+        if (implementationFlags & BEAGLE_FLAG_VECTOR_AVX)
+            gflops *= 4.0;
+        else if (implementationFlags & BEAGLE_FLAG_VECTOR_SSE)
+            gflops *= 2.0;
+
+        if (threaded) {
+            int threads = patternCount / PERFORMANCE_MODEL_THREAD_PATTERNS;
+            if (threads > calibration.hardwareThreads)
+                threads = calibration.hardwareThreads;
+            if (threads > 1) {
+                gflops *= threads;
+                bandwidth *= (threads < PERFORMANCE_MODEL_BANDWIDTH_THREADS ?
+                              threads : PERFORMANCE_MODEL_BANDWIDTH_THREADS);
+            }
+            latency = PERFORMANCE_MODEL_THREAD_SYNC;
+        }
+    }
+
+    double computeSeconds = flops / (gflops * 1e9);
+    double memorySeconds = bytes / (bandwidth * 1e9);
+    double operationSeconds = (computeSeconds > memorySeconds ? computeSeconds : memorySeconds) + latency;
+
+    // root integration reads one buffer once more
+    double rootSeconds = elements * sizeof(double) / (bandwidth * 1e9) + latency;
+
+    return operationCount * operationSeconds + rootSeconds + evaluationLatency;
+}
+
+}   // namespace benchmark
+}   // namespace beagle
@@ -0,0 +1,76 @@
+/*
+ *  PerformanceModel.h
+ *  Analytical run-time estimates used to rank implementations at instance creation
+ *
+ * Copyright 2009 Phylogenetic Likelihood Working Group
+ *
+ * This file is part of BEAGLE.
+ *
+ * BEAGLE is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * BEAGLE is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with BEAGLE.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __beagle_performance_model__
+#define __beagle_performance_model__
+
+#define PERFORMANCE_MODEL_VERSION           1                               // increment whenever the calibration file format changes
+#define PERFORMANCE_MODEL_FILENAME          ".beagle-performance-model"     // in the home directory
+#define PERFORMANCE_MODEL_ENV               "BEAGLE_PERFORMANCE_MODEL"      // calibration file path, or "off" to rank by flags only
+#define PERFORMANCE_MODEL_DEMOTION          4.0     // implementations estimated this much slower than the fastest lose their flag rank
+#define PERFORMANCE_MODEL_THREAD_PATTERNS   128     // fewest patterns worth a thread of their own
+#define PERFORMANCE_MODEL_THREAD_SYNC       5e-6    // seconds to hand an operation to the worker threads and wait for them
+#define PERFORMANCE_MODEL_BANDWIDTH_THREADS 4       // threads beyond this do not add memory bandwidth
+#define PERFORMANCE_MODEL_GPU_COMPUTE       32.0    // assumed GPU peak relative to one calibrated CPU core
+#define PERFORMANCE_MODEL_GPU_BANDWIDTH     16.0    // assumed GPU memory bandwidth relative to the calibrated CPU bandwidth
+#define PERFORMANCE_MODEL_CUDA_LAUNCH       8e-6    // seconds per CUDA kernel launch
+#define PERFORMANCE_MODEL_OPENCL_LAUNCH     15e-6   // seconds per OpenCL kernel launch
+#define PERFORMANCE_MODEL_DEVICE_SYNC       20e-6   // seconds to return a likelihood from a device
+
+namespace beagle {
+namespace benchmark {
+
+struct MachineCalibration {
+    double gflops;          // one core, scalar double precision multiply-adds
+    double bandwidth;       // GB/s read from memory by one core
+    int hardwareThreads;
+};
+
+// false if switched off through the environment
+bool isPerformanceModelEnabled();
+
+/*
+ * Measured by a microbenchmark of a few tens of milliseconds on first use and
+ * kept in a file, keyed by CPU model, for later processes.
+ */
+const MachineCalibration& getMachineCalibration();
+
+/*
+ * Estimated seconds for one likelihood evaluation of a tree with tipCount tips:
+ * a partials update per internal node and a root integration, each limited by
+ * either FLOP rate or memory bandwidth, plus per-operation launch and
+ * synchronisation latencies. Estimates are for double precision whatever the
+ * implementation flags say, since precision is never chosen by the model.
+ */
+double estimateEvaluationSeconds(long resourceFlags,
+                                 long implementationFlags,
+                                 bool threaded,
+                                 int tipCount,
+                                 int stateCount,
+                                 int patternCount,
+                                 int categoryCount);
+
+}   // namespace benchmark
+}   // namespace beagle
+
+#endif // __beagle_performance_model__
@@ -7,6 +7,9 @@
 // Plugin.cxx
 
 #include "libhmsbeagle/plugin/Plugin.h"
+#include "libhmsbeagle/beagle.h"
+#include <cstdlib>
+#include <cstring>
 #include <string>
 using namespace std;
 
@@ -41,5 +44,51 @@ Plugin* PluginManager::findPlugin(const char* name) noexcept(false)
     return pi->m_plugin;
 }
 
+const vector<PluginManifest>& PluginManager::manifests()
+{
+    static const PluginManifest known[] = {
+        {"hmsbeagle-cpu",           BEAGLE_FLAG_FRAMEWORK_CPU | BEAGLE_FLAG_PROCESSOR_CPU |
+                                    BEAGLE_FLAG_VECTOR_SSE | BEAGLE_FLAG_VECTOR_AVX},
+        {"hmsbeagle-cuda",          BEAGLE_FLAG_FRAMEWORK_CUDA | BEAGLE_FLAG_PROCESSOR_GPU},
+        {"hmsbeagle-opencl",        BEAGLE_FLAG_FRAMEWORK_OPENCL | BEAGLE_FLAG_PROCESSOR_CPU |
+                                    BEAGLE_FLAG_PROCESSOR_GPU | BEAGLE_FLAG_PROCESSOR_OTHER},
+        {"hmsbeagle-opencl-altera", BEAGLE_FLAG_FRAMEWORK_OPENCL | BEAGLE_FLAG_PROCESSOR_FPGA},
+        {"hmsbeagle-cpu-openmp",    BEAGLE_FLAG_FRAMEWORK_CPU | BEAGLE_FLAG_PROCESSOR_CPU | BEAGLE_FLAG_THREADING_OPENMP |
+                                    BEAGLE_FLAG_VECTOR_SSE | BEAGLE_FLAG_VECTOR_AVX}
+    };
+    static const vector<PluginManifest> list(known, known + sizeof(known) / sizeof(known[0]));
+    return list;
+}
+
+bool PluginManager::isPluginAllowed(const char* name)
+{
+    const char* allowed = getenv(BEAGLE_PLUGINS_ENV);
+    if (allowed == NULL || *allowed == '\0')
+        return true;
+
+    const char* prefix = "hmsbeagle-";
+    const char* shortName = name;
+    if (strncmp(name, prefix, strlen(prefix)) == 0)
+        shortName = name + strlen(prefix);
+
+    string entries(allowed);
+    size_t start = 0;
+    while (start <= entries.size()) {
+        size_t end = entries.find(',', start);
+        if (end == string::npos)
+            end = entries.size();
+        string entry = entries.substr(start, end - start);
+        size_t first = entry.find_first_not_of(" \t");
+        size_t last = entry.find_last_not_of(" \t");
+        if (first != string::npos) {
+            entry = entry.substr(first, last - first + 1);
+            if (entry == name || entry == shortName)
+                return true;
+        }
+        start = end + 1;
+    }
+    return false;
+}
+
 }	// namespace plugin
 }	// namespace beagle
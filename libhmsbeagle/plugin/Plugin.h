@@ -19,6 +19,9 @@
 #include <string>
 #include <map>
 #include <list>
+#include <vector>
+
+#define BEAGLE_PLUGINS_ENV  "BEAGLE_PLUGINS"  // comma-separated plugins that may be loaded; all if unset
 
 namespace beagle {
 namespace plugin {
@@ -50,6 +53,16 @@ protected:
 
 typedef Plugin* (*plugin_init_func)(void);
 
+/**
+ * What a plugin provides, known without opening its shared library
+ * The flags are the framework, processor and other support flags of the
+ * resources and implementations the plugin can contribute
+ */
+struct PluginManifest {
+    const char* name;
+    long flags;
+};
+
 class BEAGLE_DLLEXPORT PluginManager
 {
   public:
@@ -57,6 +70,12 @@ class BEAGLE_DLLEXPORT PluginManager
 
       Plugin* findPlugin(const char* name) noexcept(false);
 
+      /** The known plugins, in the order their resources and implementations are listed */
+      static const std::vector<PluginManifest>& manifests();
+
+      /** Whether BEAGLE_PLUGINS allows a plugin to be loaded, with or without its "hmsbeagle-" prefix */
+      static bool isPluginAllowed(const char* name);
+
     private:
         struct PluginInfo {
         SharedLibrary* m_library;